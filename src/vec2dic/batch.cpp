@@ -0,0 +1,304 @@
+/** @file batch.cpp
+ *
+ *  @brief batch expansion of many seed sets with many settings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/batch.h"
+#include "src/vec2dic/lexicon_io.h"
+
+#include <algorithm>      // std::max(), std::min()
+#include <atomic>         // std::atomic
+#include <chrono>         // std::chrono::steady_clock
+#include <fstream>        // std::ifstream, std::ofstream
+#include <iostream>       // std::cerr
+#include <map>            // std::map
+#include <memory>         // std::unique_ptr
+#include <sstream>        // std::istringstream, std::ostringstream
+#include <stdexcept>      // std::exception, std::invalid_argument
+#include <thread>         // std::thread
+#include <utility>        // std::pair
+#include <vector>         // std::vector
+
+#ifdef _OPENMP
+# include <omp.h>         // omp_set_num_threads()
+#endif
+
+///////////////
+// Constants //
+///////////////
+
+const int DFLT_BATCH_WORKERS = 4;
+
+/** Number of expansion types */
+static const size_t N_TYPES = static_cast<size_t>(ExpansionType::MAX_SENTINEL);
+
+/** Number of distinct expanders (one per type and normalization) */
+static const size_t N_EXPANDERS = N_TYPES * N_NORMALIZATIONS;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Single job of a batch.
+ */
+using batch_job_t = struct BatchJob {
+  /// line of the job in the manifest
+  size_t m_line = 0;
+  /// file with the seed set
+  std::string m_seed_fname {};
+  /// file for the lexicon
+  std::string m_output_fname {};
+  /// algorithm and normalization to use
+  expander_options_t m_options {};
+  /// lexicon size and number of neighbors
+  expansion_params_t m_params {};
+};
+
+/**
+ * Jobs which expand the same seed set with the same expander.
+ */
+using job_group_t = struct JobGroup {
+  /// seed set of the jobs
+  const w2ps_t *m_seeds = nullptr;
+  /// index of the expander of the jobs
+  size_t m_expander = 0;
+  /// indices of the jobs
+  std::vector<size_t> m_jobs {};
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute index of the expander which runs a job
+ *
+ * @param a_options - algorithm and normalization of the job
+ *
+ * @return index in `[0, N_EXPANDERS)`
+ */
+static size_t _expander_index(const expander_options_t &a_options) {
+  return static_cast<size_t>(a_options.m_type) * N_NORMALIZATIONS
+      + a_options.normalization_index();
+}
+
+/**
+ * Read jobs from a manifest file
+ *
+ * @param a_jobs - vector to populate with jobs
+ * @param a_fname - name of the manifest file
+ * @param a_defaults - default options of the jobs
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+static int _read_manifest(std::vector<batch_job_t> *a_jobs,
+                          const char *a_fname,
+                          const expander_options_t &a_defaults) {
+  std::string iline, setting, error;
+  batch_job_t job;
+  size_t line_no = 0;
+
+  std::ifstream is(a_fname);
+  if (!is) {
+    std::cerr << "Cannot open manifest file " << a_fname << std::endl;
+    return 1;
+  }
+  while (std::getline(is, iline)) {
+    ++line_no;
+    std::istringstream fields(iline);
+    job = batch_job_t();
+    job.m_line = line_no;
+    // skip empty lines and comments
+    if (!(fields >> job.m_seed_fname) || job.m_seed_fname[0] == '#')
+      continue;
+
+    if (!(fields >> job.m_output_fname)) {
+      std::cerr << "Missing output file in line " << line_no
+                << " of manifest " << a_fname << std::endl;
+      return 1;
+    }
+    job.m_options = a_defaults;
+    job.m_params.m_n_terms = a_defaults.m_n_terms;
+    job.m_params.m_knn = a_defaults.m_knn;
+    while (fields >> setting) {
+      if (parse_expansion_setting(setting, &job.m_options, &job.m_params,
+                                  &error)) {
+        std::cerr << error << " in line " << line_no << " of manifest "
+                  << a_fname << std::endl;
+        return 1;
+      }
+    }
+    a_jobs->push_back(job);
+  }
+  if (!is.eof() && is.fail()) {
+    std::cerr << "Failed to read manifest file " << a_fname << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Run jobs of a group and write their lexicons
+ *
+ * @param a_expander - expander of the group's algorithm (\c nullptr if
+ *                     it could not be built)
+ * @param a_group - group of jobs to run
+ * @param a_jobs - all jobs of the batch
+ *
+ * @return number of failed jobs
+ */
+static size_t _run_group(const Expander *a_expander,
+                         const job_group_t *a_group,
+                         const std::vector<batch_job_t> *a_jobs) {
+  const size_t n_jobs = a_group->m_jobs.size();
+  if (a_expander == nullptr)
+    return n_jobs;
+
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<expansion_params_t> params;
+  params.reserve(n_jobs);
+  for (size_t j : a_group->m_jobs)
+    params.push_back((*a_jobs)[j].m_params);
+
+  std::vector<lexicon_t> lexicons;
+  try {
+    if (a_expander->expand_many(a_group->m_seeds, &params, &lexicons))
+      return n_jobs;
+  } catch (const std::exception &e) {
+    // report the failure instead of terminating the whole batch
+    std::ostringstream log;
+    for (size_t j : a_group->m_jobs)
+      log << "Job in line " << (*a_jobs)[j].m_line << " ("
+          << (*a_jobs)[j].m_seed_fname << ") failed: " << e.what() << '\n';
+    std::cerr << log.str();
+    return n_jobs;
+  }
+
+  const long long msecs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start).count();
+  size_t n_failed = 0;
+  const batch_job_t *job;
+  std::ostringstream log;
+  for (size_t i = 0; i < n_jobs; ++i) {
+    job = &(*a_jobs)[a_group->m_jobs[i]];
+    std::ofstream os(job->m_output_fname);
+    if (os)
+      output_terms(os, &lexicons[i]);
+    if (!os) {
+      log << "Cannot write file " << job->m_output_fname << '\n';
+      ++n_failed;
+      continue;
+    }
+    log << "Job in line " << job->m_line << " (" << job->m_seed_fname
+        << ", type " << static_cast<int>(job->m_options.m_type)
+        << ", length-normalize " << !job->m_options.m_no_length_normalize
+        << ", mean-normalize " << !job->m_options.m_no_mean_normalize
+        << ", k " << job->m_params.m_knn << ", n-terms "
+        << job->m_params.m_n_terms << "): " << lexicons[i].size()
+        << " terms written to "
+        << job->m_output_fname << " (group of " << n_jobs << " jobs in "
+        << msecs << " ms)\n";
+  }
+  std::cerr << log.str();
+  return n_failed;
+}
+
+int run_batch(const EmbeddingStore *a_store,
+              const expander_options_t &a_defaults,
+              const batch_options_t &a_options) {
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<batch_job_t> jobs;
+  if (_read_manifest(&jobs, a_options.m_manifest.c_str(), a_defaults))
+    return 1;
+
+  // read every seed set once and group jobs by seed set, algorithm,
+  // and normalization
+  std::map<std::string, w2ps_t> fname2seeds;
+  std::map<std::pair<std::string, size_t>, size_t> key2group;
+  std::vector<job_group_t> groups;
+  std::pair<std::string, size_t> key;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    auto seeds = fname2seeds.find(jobs[i].m_seed_fname);
+    if (seeds == fname2seeds.end()) {
+      seeds = fname2seeds.emplace(jobs[i].m_seed_fname, w2ps_t()).first;
+      if (read_seed_set(jobs[i].m_seed_fname.c_str(), &seeds->second))
+        return 1;
+    }
+    key.first = jobs[i].m_seed_fname;
+    key.second = _expander_index(jobs[i].m_options);
+    auto group = key2group.find(key);
+    if (group == key2group.end()) {
+      group = key2group.emplace(key, groups.size()).first;
+      groups.push_back(job_group_t());
+      groups.back().m_seeds = &seeds->second;
+      groups.back().m_expander = key.second;
+    }
+    groups[group->second].m_jobs.push_back(i);
+  }
+
+  // build one expander per algorithm and normalization, so that all
+  // groups share its auxiliary data (e.g., the principal components
+  // of the vectors)
+  std::unique_ptr<Expander> expanders[N_EXPANDERS];
+  const expander_options_t *options;
+  for (auto &group : groups) {
+    std::unique_ptr<Expander> &expander = expanders[group.m_expander];
+    if (expander)
+      continue;
+
+    options = &jobs[group.m_jobs.front()].m_options;
+    try {
+      expander.reset(new Expander(a_store, *options));
+    } catch (const std::invalid_argument &e) {
+      std::cerr << "Skipping jobs of type "
+                << static_cast<int>(options->m_type)
+                << " (length-normalize " << !options->m_no_length_normalize
+                << ", mean-normalize " << !options->m_no_mean_normalize
+                << "): " << e.what() << std::endl;
+    }
+  }
+
+  const int n_workers = std::max(1, std::min<int>(a_options.m_n_workers,
+                                                  groups.size()));
+  int n_threads = a_options.m_n_threads;
+#ifdef _OPENMP
+  if (n_threads <= 0)
+    n_threads = std::max(1, omp_get_num_procs() / n_workers);
+#else
+  n_threads = 1;
+#endif
+  std::cerr << "Running " << jobs.size() << " jobs in " << groups.size()
+            << " groups (" << n_workers << " workers with " << n_threads
+            << " threads each)" << std::endl;
+
+  std::atomic<size_t> next_group(0), n_failed(0);
+  auto worker = [&]() {
+#ifdef _OPENMP
+    omp_set_num_threads(n_threads);
+#endif
+    size_t g;
+    while ((g = next_group++) < groups.size()) {
+      n_failed += _run_group(expanders[groups[g].m_expander].get(),
+                             &groups[g], &jobs);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i = 0; i < n_workers; ++i)
+    workers.emplace_back(worker);
+  for (auto &w : workers)
+    w.join();
+
+  std::cerr << "Finished " << jobs.size() - n_failed << " of "
+            << jobs.size() << " jobs in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count()
+            << " ms" << std::endl;
+  return n_failed > 0;
+}
@@ -0,0 +1,72 @@
+/** @file batch.h
+ *
+ *  @brief batch expansion of many seed sets with many settings.
+ *
+ *  A batch is described by a manifest file with one job per line:
+ *
+ *      SEED_FILE OUTPUT_FILE [type=T] [k=K] [n-terms=N]
+ *
+ *  Fields are separated by whitespace; empty lines and lines starting
+ *  with `#` are ignored.  Omitted settings take the values given on
+ *  the command line.  The word vectors are loaded once, every seed
+ *  file is read once, and jobs with the same seed file and algorithm
+ *  are run together, so that they share one expansion (see
+ *  `Expander::expand_many()`).  Such groups of jobs are processed
+ *  concurrently by a pool of worker threads, and each job writes its
+ *  lexicon to its own output file.
+ */
+
+#ifndef VEC2DIC_BATCH_H_
+# define VEC2DIC_BATCH_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/expander.h"
+
+#include <string>         // std::string
+
+///////////////
+// Constants //
+///////////////
+
+/** Default number of job groups processed concurrently */
+extern const int DFLT_BATCH_WORKERS;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Options of a batch run.
+ */
+using batch_options_t = struct BatchOptions {
+  /// path of the manifest file
+  std::string m_manifest {};
+  /// number of job groups processed concurrently
+  int m_n_workers = DFLT_BATCH_WORKERS;
+  /// number of OpenMP threads used by each group (0 means share all
+  /// available cores among the workers)
+  int m_n_threads = 0;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Run all jobs of a manifest
+ *
+ * @param a_store - loaded word vectors
+ * @param a_defaults - default options of the jobs (compression and
+ *                     index options cannot be changed by jobs)
+ * @param a_options - options of the batch run
+ *
+ * @return \c 0 if all jobs succeeded, non-\c 0 otherwise
+ */
+int run_batch(const EmbeddingStore *a_store,
+              const expander_options_t &a_defaults,
+              const batch_options_t &a_options);
+
+#endif    // VEC2DIC_BATCH_H_
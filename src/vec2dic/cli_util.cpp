@@ -0,0 +1,40 @@
+/** @file cli_util.cpp
+ *
+ *  @brief helpers for parsing command line arguments.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/cli_util.h"
+
+#include <cerrno>         // errno, ERANGE
+#include <cstdlib>        // std::strtol()
+
+#include <algorithm>      // std::sort(), std::unique()
+
+/////////////
+// Methods //
+/////////////
+
+int parse_int_list(std::vector<int> *a_list, const char *a_arg,
+                   const int a_min, const int a_max) {
+  char *end;
+  long value;
+  a_list->clear();
+  do {
+    errno = 0;
+    value = std::strtol(a_arg, &end, 10);
+    if (end == a_arg || errno == ERANGE || value < a_min || value > a_max
+        || (*end != ',' && *end != '\0'))
+      return 1;
+
+    a_list->push_back(static_cast<int>(value));
+    a_arg = end + 1;
+  } while (*end == ',');
+
+  std::sort(a_list->begin(), a_list->end());
+  a_list->erase(std::unique(a_list->begin(), a_list->end()),
+                a_list->end());
+  return 0;
+}
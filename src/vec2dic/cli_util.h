@@ -0,0 +1,34 @@
+/** @file cli_util.h
+ *
+ *  @brief helpers for parsing command line arguments.
+ */
+
+#ifndef VEC2DIC_CLI_UTIL_H_
+# define VEC2DIC_CLI_UTIL_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include <vector>         // std::vector
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Parse comma-separated list of integers
+ *
+ * The values are sorted and duplicates are removed.
+ *
+ * @param a_list - vector to populate
+ * @param a_arg - list to parse
+ * @param a_min - minimum allowed value
+ * @param a_max - maximum allowed value
+ *
+ * @return \c 0 on success, non-\c 0 if the list is malformed or a value
+ *   is out of range
+ */
+int parse_int_list(std::vector<int> *a_list, const char *a_arg,
+                   const int a_min, const int a_max);
+
+#endif    // VEC2DIC_CLI_UTIL_H_
@@ -0,0 +1,454 @@
+/** @file embedding_store.cpp
+ *
+ *  @brief read-only store of neural word embeddings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/phase_profile.h"
+#include "src/vec2dic/text_parser.h"
+
+#include <unistd.h>       // unlink()
+
+#include <algorithm>      // std::copy()
+#include <iostream>       // std::cerr
+#include <vector>         // std::vector
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compose name of the cached binary copy of a textual vector file
+ *
+ * @param a_cache - cache of the vector file
+ * @param a_elem_size - size of a matrix element in bytes
+ *
+ * @return path of the cache entry
+ */
+static std::string _raw_copy_fname(const nwe_cache_t *a_cache,
+                                   const size_t a_elem_size) {
+  // the copy has the precision of the parsed values, since parsing
+  // in double precision and converting to single precision may round
+  // differently than parsing in single precision
+  return nwe_cache_fname(a_cache, nwe_norm_key(a_elem_size, false, false,
+                                               1.) + ".nwe");
+}
+
+/**
+ * Determine precision of a binary vector file
+ *
+ * @param a_fname - name of the file
+ *
+ * @return size of a matrix element in bytes (\c 0 if the file is not a
+ *   valid binary vector file)
+ */
+static size_t _nwe_elem_size(const char *a_fname) {
+  nwe_map_t map;
+  size_t elem_size = 0;
+  if (is_nwe_file(a_fname) && map_nwe_file(a_fname, &map) == 0) {
+    elem_size = map.m_header->m_elem_size;
+    unmap_nwe_file(&map);
+  }
+  return elem_size;
+}
+
+EmbeddingStore::~EmbeddingStore() {
+  clear();
+}
+
+template <>
+std::unique_ptr<arma::mat> *EmbeddingStore::nwe<double>() {
+  return &m_nwe;
+}
+
+template <>
+std::unique_ptr<arma::fmat> *EmbeddingStore::nwe<float>() {
+  return &m_nwe32;
+}
+
+template <>
+const arma::mat *EmbeddingStore::matrix<double>() const {
+  return m_nwe.get();
+}
+
+template <>
+const arma::fmat *EmbeddingStore::matrix<float>() const {
+  return m_nwe32.get();
+}
+
+template <>
+nwe_norm_t<double> *EmbeddingStore::nwe_norm<double>() {
+  return &m_norm;
+}
+
+template <>
+nwe_norm_t<float> *EmbeddingStore::nwe_norm<float>() {
+  return &m_norm32;
+}
+
+template <>
+const nwe_norm_t<double> *EmbeddingStore::norm<double>() const {
+  return &m_norm;
+}
+
+template <>
+const nwe_norm_t<float> *EmbeddingStore::norm<float>() const {
+  return &m_norm32;
+}
+
+int EmbeddingStore::load(const char *a_fname,
+                         const store_options_t &a_options) {
+  clear();
+  m_fname = a_fname;
+  m_options = a_options;
+  if (m_options.m_coefficient != 1.)
+    m_options.m_no_length_normalize = true;
+
+  m_cache = nwe_cache_t();
+  if (!m_options.m_cache_dir.empty()
+      && open_nwe_cache(&m_cache, m_options.m_cache_dir.c_str(), a_fname)) {
+    std::cerr << "Continuing without cache" << std::endl;
+    m_cache = nwe_cache_t();
+  }
+
+  if (m_options.m_single_precision)
+    return m_options.m_shared_memory? load_shared<float>(a_fname):
+        load_vectors<float>(a_fname);
+  return m_options.m_shared_memory? load_shared<double>(a_fname):
+      load_vectors<double>(a_fname);
+}
+
+int EmbeddingStore::save(const char *a_fname) const {
+  if (m_options.m_single_precision) {
+    const NWEView<float> nwe = view<float>();
+    return write_nwe_file(a_fname, &nwe, &m_vocabulary,
+                          m_options.flags(), m_options.m_coefficient);
+  }
+  const NWEView<double> nwe = view<double>();
+  return write_nwe_file(a_fname, &nwe, &m_vocabulary,
+                        m_options.flags(), m_options.m_coefficient);
+}
+
+template <typename eT>
+int EmbeddingStore::normalize(nwe_norm_t<eT> *a_norm,
+                              const bool a_no_length_normalize,
+                              const bool a_no_mean_normalize) const {
+  const arma::Mat<eT> *nwe = matrix<eT>();
+  if (nwe == nullptr) {
+    std::cerr << "Word vectors are not loaded" << std::endl;
+    return 1;
+  }
+  // elongated vectors are never length-normalized
+  const bool no_length_normalize = a_no_length_normalize
+      || m_options.m_coefficient != 1.;
+  if (no_length_normalize == m_options.m_no_length_normalize
+      && a_no_mean_normalize == m_options.m_no_mean_normalize) {
+    *a_norm = *norm<eT>();
+    return 0;
+  }
+  if (!m_is_raw) {
+    std::cerr << "Vectors in file " << m_fname << " were normalized"
+        " when converting them (re-convert the file with -L -M to"
+        " change their normalization)" << std::endl;
+    return 1;
+  }
+  compute_norm(a_norm, !no_length_normalize, !a_no_mean_normalize);
+  return 0;
+}
+
+/**
+ * Compute normalization of the loaded vectors or read it from the cache
+ *
+ * @param a_norm - normalization to populate
+ * @param a_length_normalize - normalize lengths of the vectors
+ * @param a_mean_normalize - center and scale the coordinates
+ *
+ * @return \c void
+ */
+template <typename eT>
+void EmbeddingStore::compute_norm(nwe_norm_t<eT> *a_norm,
+                                  const bool a_length_normalize,
+                                  const bool a_mean_normalize) const {
+  const arma::Mat<eT> *nwe = matrix<eT>();
+  // the elongation alone is not worth caching
+  std::string fname;
+  if (cache() != nullptr && (a_length_normalize || a_mean_normalize)) {
+    fname = nwe_cache_fname(&m_cache,
+                            nwe_norm_key(sizeof(eT), a_length_normalize,
+                                         a_mean_normalize,
+                                         m_options.m_coefficient)
+                            + ".norm");
+    if (load_nwe_norm(fname, a_norm, nwe->n_rows, nwe->n_cols) == 0)
+      return;
+  }
+
+  compute_nwe_norm(a_norm, nwe, m_options.m_coefficient,
+                   a_length_normalize, a_mean_normalize);
+  if (!fname.empty())
+    save_nwe_norm(fname, a_norm, nwe->n_rows, nwe->n_cols);
+}
+
+void EmbeddingStore::release_matrix() {
+  // the matrix has to be released before the memory it wraps
+  m_nwe.reset();
+  m_nwe32.reset();
+  unmap_nwe_file(&m_map);
+  close_nwe_shm(&m_shm);
+  m_norm = nwe_norm_t<double>();
+  m_norm32 = nwe_norm_t<float>();
+}
+
+void EmbeddingStore::clear() {
+  m_vocabulary.clear();
+  release_matrix();
+  m_is_raw = false;
+}
+
+/**
+ * Read vectors from shared memory or publish them there.
+ *
+ * Vectors which are mapped from a binary file in the requested
+ * precision share its pages already and are loaded as usual.
+ * Otherwise, the first process loads the vectors and publishes them as
+ * they were read in a shared memory segment named after the version of
+ * the vector file and the precision, from which all further processes
+ * map them.  The words and the normalization are kept by every process.
+ *
+ * @param a_fname - name of the vector file
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int EmbeddingStore::load_shared(const char *a_fname) {
+  std::unique_ptr<arma::Mat<eT>> *nwe_ptr = nwe<eT>();
+  std::string file_id, version_id;
+  nwe_map_t shm_map;
+  if (_nwe_elem_size(a_fname) == sizeof(eT)
+      || (cache() != nullptr
+          && _nwe_elem_size(_raw_copy_fname(&m_cache, sizeof(eT)).c_str())
+          == sizeof(eT))
+      || nwe_file_id(a_fname, &file_id, &version_id))
+    return load_vectors<eT>(a_fname);
+
+  const std::string name = "/vec2dic-" + version_id
+      + (sizeof(eT) == sizeof(float)? "-f32": "-f64");
+  switch (open_nwe_shm(&m_shm, name.c_str())) {
+    case 0:
+      if (load_binary<eT>(name.c_str(), m_shm.m_fd) == 0)
+        return 0;
+      break;
+    case 1:
+      if (load_vectors<eT>(a_fname)) {
+        // let other processes load the vectors themselves
+        close_nwe_shm(&m_shm);
+        return 1;
+      }
+      break;
+    default:
+      break;
+  }
+  if (m_shm.m_fd < 0) {
+    std::cerr << "Continuing without shared memory" << std::endl;
+    return load_vectors<eT>(a_fname);
+  }
+
+  // publish the vectors as they were read (vectors which were
+  // normalized when converting them keep their preprocessing)
+  const NWEView<eT> nwe(matrix<eT>());
+  std::cerr << "Sharing word vectors ... ";
+  if (publish_nwe_shm(&m_shm, &nwe, &m_vocabulary,
+                      m_is_raw? NWE_RAW: m_options.flags(),
+                      m_is_raw? 1.: m_options.m_coefficient)
+      || map_nwe_fd(m_shm.m_fd, name.c_str(), &shm_map)) {
+    close_nwe_shm(&m_shm);
+    std::cerr << "Continuing without shared memory" << std::endl;
+    return 0;
+  }
+  // replace the private copy of the vectors with the shared one
+  nwe_ptr->reset(new arma::Mat<eT>(
+      const_cast<eT *>(static_cast<const eT *>(shm_map.m_matrix)),
+      shm_map.m_header->m_n_rows, shm_map.m_header->m_n_cols,
+      false, true));
+  unmap_nwe_file(&m_map);
+  m_map = shm_map;
+  std::cerr << "done" << std::endl;
+  return 0;
+}
+
+/**
+ * Read vectors from a binary or textual file.
+ *
+ * Textual files are read from their binary copy in the cache if there
+ * is one, otherwise, the copy is written after parsing the file.
+ *
+ * @param a_fname - name of the vector file
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int EmbeddingStore::load_vectors(const char *a_fname) {
+  if (is_nwe_file(a_fname))
+    return load_binary<eT>(a_fname);
+  if (cache() == nullptr)
+    return load_text<eT>(a_fname);
+
+  const std::string fname = _raw_copy_fname(&m_cache, sizeof(eT));
+  if (is_nwe_file(fname.c_str())) {
+    if (load_binary<eT>(fname.c_str()) == 0)
+      return 0;
+
+    std::cerr << "Cached vectors " << fname << " will be rebuilt"
+              << std::endl;
+  }
+  if (load_text<eT>(a_fname))
+    return 1;
+
+  // write the vectors as they were read
+  const NWEView<eT> nwe(matrix<eT>());
+  const std::string tmp_fname = nwe_cache_tmp_fname(fname);
+  std::cerr << "Caching binary word vectors ... ";
+  if (write_nwe_file(tmp_fname.c_str(), &nwe, &m_vocabulary, NWE_RAW, 1.)
+      || commit_nwe_cache_file(tmp_fname, fname)) {
+    unlink(tmp_fname.c_str());
+    std::cerr << "Vectors will be parsed again on the next run"
+              << std::endl;
+  } else {
+    std::cerr << "done" << std::endl;
+  }
+  return 0;
+}
+
+/**
+ * Read vectors from a memory-mapped binary file.
+ *
+ * The matrix is used in place if it was stored with the requested
+ * precision and gets converted otherwise.  For vectors which were
+ * stored without preprocessing, only their normalization is computed,
+ * otherwise, the normalization options stored in the file have to
+ * match the requested ones.
+ *
+ * @param a_fname - name of the binary vector file
+ * @param a_fd - descriptor of the file if it is already open (the
+ *               descriptor stays open)
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int EmbeddingStore::load_binary(const char *a_fname, const int a_fd) {
+  std::unique_ptr<arma::Mat<eT>> *nwe_ptr = nwe<eT>();
+  const nwe_header_t *header;
+  const uint64_t *index;
+  const char *strings;
+  bool is_raw;
+  PhaseTimer timer("map_binary");
+  std::cerr << "Reading binary word vectors ... ";
+
+  if (a_fd < 0? map_nwe_file(a_fname, &m_map):
+      map_nwe_fd(a_fd, a_fname, &m_map))
+    goto error_exit;
+
+  header = m_map.m_header;
+  is_raw = header->m_flags == NWE_RAW && header->m_coefficient == 1.;
+  if (!is_raw && (header->m_flags != m_options.flags()
+                  || header->m_coefficient != m_options.m_coefficient)) {
+    std::cerr << "Vectors in file " << a_fname << " were normalized"
+        " with different options (re-convert the file or adjust -L, -M,"
+        " and -c)" << std::endl;
+    goto error_exit;
+  }
+
+  if (header->m_elem_size == sizeof(eT)) {
+    // wrap the mapped matrix without copying it (it is never written)
+    nwe_ptr->reset(new arma::Mat<eT>(
+        const_cast<eT *>(static_cast<const eT *>(m_map.m_matrix)),
+        header->m_n_rows, header->m_n_cols, false, true));
+  } else {
+    // convert the matrix to the requested precision
+    nwe_ptr->reset(new arma::Mat<eT>(header->m_n_rows, header->m_n_cols));
+    eT *dst = (*nwe_ptr)->memptr();
+    const size_t n_elem = (*nwe_ptr)->n_elem;
+    if (header->m_elem_size == sizeof(float)) {
+      const float *src = static_cast<const float *>(m_map.m_matrix);
+      std::copy(src, src + n_elem, dst);
+    } else {
+      const double *src = static_cast<const double *>(m_map.m_matrix);
+      std::copy(src, src + n_elem, dst);
+    }
+  }
+  // populate word mappings from the string table
+  index = m_map.m_index;
+  strings = m_map.m_strings;
+  m_vocabulary.reserve(header->m_n_cols, header->m_strings_size);
+  for (vid_t i = 0; i < header->m_n_cols; ++i)
+    m_vocabulary.add(strings + index[i], index[i + 1] - index[i]);
+  timer.stop();
+  m_is_raw = is_raw;
+  if (is_raw)
+    compute_norm(nwe_norm<eT>(), !m_options.m_no_length_normalize,
+                 !m_options.m_no_mean_normalize);
+
+  std::cerr << "done (read " << header->m_n_rows << " rows with "
+            << header->m_n_cols << " columns)" << std::endl;
+  return 0;
+
+ error_exit:
+  clear();
+  return 1;
+}
+
+/**
+ * Read vectors from a textual word2vec file.
+ *
+ * @param a_fname - name of the vector file
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int EmbeddingStore::load_text(const char *a_fname) {
+  std::unique_ptr<arma::Mat<eT>> *nwe_ptr = nwe<eT>();
+  std::vector<text_word_t> words;
+  text_map_t text_map;
+  size_t n_bytes;
+  PhaseTimer timer("parse_text");
+  std::cerr << "Reading word vectors ... ";
+
+  if (map_text_file(a_fname, &text_map)
+      || parse_text_vectors(&text_map, nwe_ptr, &words))
+    goto error_exit;
+
+  // populate word mappings from the positions of the words
+  n_bytes = 0;
+  for (auto &word : words)
+    n_bytes += word.m_length;
+  m_vocabulary.reserve(words.size(), n_bytes);
+  for (auto &word : words)
+    m_vocabulary.add(text_map.m_data + word.m_offset, word.m_length);
+  unmap_text_file(&text_map);
+  timer.stop();
+  m_is_raw = true;
+  compute_norm(nwe_norm<eT>(), !m_options.m_no_length_normalize,
+               !m_options.m_no_mean_normalize);
+
+  std::cerr << "done (read " << (*nwe_ptr)->n_rows << " rows with "
+            << (*nwe_ptr)->n_cols << " columns)" << std::endl;
+  return 0;
+
+ error_exit:
+  unmap_text_file(&text_map);            // basic guarantee
+  clear();
+  return 1;
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template int EmbeddingStore::normalize<float>(nwe_norm_t<float> *,
+                                              const bool,
+                                              const bool) const;
+template int EmbeddingStore::normalize<double>(nwe_norm_t<double> *,
+                                               const bool,
+                                               const bool) const;
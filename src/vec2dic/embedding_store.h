@@ -0,0 +1,262 @@
+/** @file embedding_store.h
+ *
+ *  @brief read-only store of neural word embeddings.
+ *
+ *  This file declares a class which loads neural word embeddings from
+ *  a textual word2vec file or a binary vector file, computes their
+ *  normalization, and provides the embedding matrix together with the
+ *  mappings between words and vector id's.  Normalization is applied
+ *  whenever the vectors are read (see nwe_view.h), so that the matrix
+ *  holds the vectors as they were read and is never modified.  Once
+ *  loaded, the store is never modified by the expansion algorithms, so
+ *  that a single instance can be shared by any number of concurrently
+ *  running `Expander`s, which may even use different normalizations
+ *  of the same vectors.
+ */
+
+#ifndef VEC2DIC_EMBEDDING_STORE_H_
+# define VEC2DIC_EMBEDDING_STORE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/nwe_cache.h"
+#include "src/vec2dic/nwe_file.h"
+#include "src/vec2dic/nwe_shm.h"
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/vocabulary.h"
+
+#include <armadillo>      // arma::mat
+#include <cstdint>        // uint32_t
+#include <memory>         // std::unique_ptr
+#include <string>         // std::string
+
+///////////
+// Types //
+///////////
+
+/**
+ * Options determining how word vectors are loaded and normalized.
+ */
+using store_options_t = struct StoreOptions {
+  /// elongation coefficient for vector lengths
+  double m_coefficient = 1.;
+  /// do not normalize length of the vectors
+  bool m_no_length_normalize = false;
+  /// do not center means of the vectors
+  bool m_no_mean_normalize = false;
+  /// store vectors in single precision
+  bool m_single_precision = false;
+  /// share the loaded vectors with concurrent processes
+  bool m_shared_memory = false;
+  /// directory of the cache of preprocessed vectors (empty means no
+  /// cache)
+  std::string m_cache_dir {};
+
+  /// preprocessing steps as a combination of `NWEFlags`
+  uint32_t flags() const {
+    uint32_t flags = NWE_RAW;
+    if (!m_no_length_normalize)
+      flags |= NWE_LENGTH_NORMALIZED;
+    if (!m_no_mean_normalize)
+      flags |= NWE_MEAN_NORMALIZED;
+    return flags;
+  }
+};
+
+/////////////
+// Classes //
+/////////////
+
+/**
+ * Normalized word vectors and their words.
+ *
+ * All const methods are safe to call from multiple threads.
+ */
+class EmbeddingStore {
+ public:
+  EmbeddingStore() {}
+  EmbeddingStore(const EmbeddingStore &) = delete;
+  EmbeddingStore &operator=(const EmbeddingStore &) = delete;
+  ~EmbeddingStore();
+
+  /**
+   * Read word vectors and compute their normalization
+   *
+   * Binary vector files are mapped into memory read-only and used in
+   * place if possible.  If a cache directory is given, textual files
+   * are parsed only once and then mapped from their binary copy in the
+   * cache, and normalizations are read from the cache as well.  With
+   * shared memory, vectors which would otherwise be held in private
+   * memory are loaded once and then mapped by all processes.
+   * Previously loaded vectors are released.
+   *
+   * @param a_fname - name of a textual or binary vector file
+   * @param a_options - loading and normalization options
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   */
+  int load(const char *a_fname, const store_options_t &a_options);
+
+  /**
+   * Store normalized word vectors in a binary file
+   *
+   * @param a_fname - name of the output file
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   */
+  int save(const char *a_fname) const;
+
+  /**
+   * Release matrix of word vectors but keep the mappings of words
+   *
+   * @return \c void
+   */
+  void release_matrix();
+
+  /**
+   * Release word vectors and their mappings
+   *
+   * @return \c void
+   */
+  void clear();
+
+  /// name of the file from which the vectors were loaded
+  const std::string &fname() const {
+    return m_fname;
+  }
+
+  /// options with which the vectors were loaded
+  const store_options_t &options() const {
+    return m_options;
+  }
+
+  /// cache of the preprocessed vectors (\c nullptr if not used)
+  const nwe_cache_t *cache() const {
+    return m_cache.m_prefix.empty()? nullptr: &m_cache;
+  }
+
+  /// number of stored words
+  vid_t size() const {
+    return m_vocabulary.size();
+  }
+
+  /// words of the stored vectors
+  const Vocabulary &vocabulary() const {
+    return m_vocabulary;
+  }
+
+  /// matrix of word vectors as they were read (\c nullptr if not
+  /// loaded in the given precision or released)
+  template <typename eT>
+  const arma::Mat<eT> *matrix() const;
+
+  /// normalization requested when loading the vectors
+  template <typename eT>
+  const nwe_norm_t<eT> *norm() const;
+
+  /// word vectors normalized as requested when loading them (the
+  /// matrix must not have been released)
+  template <typename eT>
+  NWEView<eT> view() const {
+    return NWEView<eT>(matrix<eT>(), norm<eT>());
+  }
+
+  /**
+   * Compute another normalization of the word vectors
+   *
+   * Only vectors which were read without preprocessing (i.e., from a
+   * textual file or a binary file converted with `-L -M`) can be
+   * normalized differently than requested when loading them.  The
+   * elongation coefficient of the store is kept.
+   *
+   * @param a_norm - normalization to populate
+   * @param a_no_length_normalize - do not normalize length of the
+   *                                vectors
+   * @param a_no_mean_normalize - do not center means of the vectors
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   */
+  template <typename eT>
+  int normalize(nwe_norm_t<eT> *a_norm, const bool a_no_length_normalize,
+                const bool a_no_mean_normalize) const;
+
+  /**
+   * Look up vector id of a word
+   *
+   * @param a_word - word to look up
+   * @param a_vecid - pointer to a variable in which the id should be
+   *                  stored
+   *
+   * @return \c true if the word is known, \c false otherwise
+   */
+  bool find(const std::string &a_word, vid_t *a_vecid) const {
+    return m_vocabulary.find(a_word.data(), a_word.size(), a_vecid);
+  }
+
+  /// word of the given vector
+  std::string word(const vid_t a_vecid) const {
+    return m_vocabulary.word(a_vecid);
+  }
+
+ private:
+  template <typename eT>
+  std::unique_ptr<arma::Mat<eT>> *nwe();
+
+  template <typename eT>
+  nwe_norm_t<eT> *nwe_norm();
+
+  template <typename eT>
+  void compute_norm(nwe_norm_t<eT> *a_norm, const bool a_length_normalize,
+                    const bool a_mean_normalize) const;
+
+  template <typename eT>
+  int load_shared(const char *a_fname);
+
+  template <typename eT>
+  int load_vectors(const char *a_fname);
+
+  template <typename eT>
+  int load_text(const char *a_fname);
+
+  template <typename eT>
+  int load_binary(const char *a_fname, const int a_fd = -1);
+
+  /// name of the vector file
+  std::string m_fname {};
+  /// options with which the vectors were loaded
+  store_options_t m_options {};
+  /// words of the vectors and their indices
+  Vocabulary m_vocabulary {};
+  /// matrix of word vectors (double precision)
+  std::unique_ptr<arma::mat> m_nwe {};
+  /// matrix of word vectors (single precision)
+  std::unique_ptr<arma::fmat> m_nwe32 {};
+  /// normalization requested when loading (double precision)
+  nwe_norm_t<double> m_norm {};
+  /// normalization requested when loading (single precision)
+  nwe_norm_t<float> m_norm32 {};
+  /// whether the matrix holds the vectors without any preprocessing
+  bool m_is_raw = false;
+  /// memory-mapped binary vector file (if any)
+  nwe_map_t m_map {};
+  /// cache of the preprocessed vectors
+  nwe_cache_t m_cache {};
+  /// shared memory segment holding the vectors (if any)
+  nwe_shm_t m_shm {};
+};
+
+template <>
+const arma::mat *EmbeddingStore::matrix<double>() const;
+
+template <>
+const arma::fmat *EmbeddingStore::matrix<float>() const;
+
+template <>
+const nwe_norm_t<double> *EmbeddingStore::norm<double>() const;
+
+template <>
+const nwe_norm_t<float> *EmbeddingStore::norm<float>() const;
+
+#endif    // VEC2DIC_EMBEDDING_STORE_H_
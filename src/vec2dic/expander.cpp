@@ -0,0 +1,538 @@
+/** @file expander.cpp
+ *
+ *  @brief expansion of seed sets over a shared embedding store.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expander.h"
+
+#include <cmath>          // fabs()
+
+#include <algorithm>      // std::sort(), std::nth_element()
+#include <cstdlib>        // std::atoi()
+#include <iostream>       // std::cerr
+#include <map>            // std::map
+#include <stdexcept>      // std::invalid_argument
+#include <string>         // std::to_string()
+#include <utility>        // std::pair
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compare terms found on 8-bit integer vectors with uncompressed ones
+ *
+ * @param a_seeds - vector id's of the seed terms
+ * @param a_i8 - seed terms expanded on 8-bit integer vectors
+ * @param a_exact - seed terms expanded on uncompressed vectors
+ *
+ * @return \c void
+ */
+static void _report_i8_validation(const v2ps_t *a_seeds,
+                                  const v2ps_t *a_i8,
+                                  const v2ps_t *a_exact) {
+  size_t n_exact = 0, n_shared = 0, n_agree = 0;
+  v2ps_t::const_iterator it, end = a_i8->end();
+  for (auto &v2p : *a_exact) {
+    if (a_seeds->count(v2p.first))
+      continue;
+
+    ++n_exact;
+    if ((it = a_i8->find(v2p.first)) == end)
+      continue;
+
+    ++n_shared;
+    if (it->second.first == v2p.second.first)
+      ++n_agree;
+  }
+  std::cerr << "Validation of 8-bit integer vectors: " << n_shared
+            << " of " << n_exact << " new terms shared with the"
+      " uncompressed run (" << (n_exact? 100. * n_shared / n_exact: 100.)
+            << "%), " << n_agree << " with the same polarity"
+            << std::endl;
+}
+
+/**
+ * Combine numbers of new terms requested by two expansions
+ *
+ * @param a_n1 - first number of new terms (negative means unlimited)
+ * @param a_n2 - second number of new terms (negative means unlimited)
+ *
+ * @return number of new terms which covers both requests
+ */
+static int _max_terms(const int a_n1, const int a_n2) {
+  return (a_n1 < 0 || a_n2 < 0)? -1: std::max(a_n1, a_n2);
+}
+
+/**
+ * Build lexicon from seeds and the best new terms of an expansion
+ *
+ * New terms are ranked in the same way as by the expansion algorithms
+ * (by ascending distance, ties broken by vector id's), so that keeping
+ * the first `a_n_new` of them yields the result of an expansion
+ * limited to that number.
+ *
+ * @param a_lexicon - lexicon to populate
+ * @param a_store - word vectors
+ * @param a_seeds - seed terms and their polarities
+ * @param a_known - vector id's of the seed terms
+ * @param a_expanded - vector id's of the seeds and all new terms
+ * @param a_n_new - maximum number of new terms (negative means
+ *                  unlimited)
+ *
+ * @return \c void
+ */
+static void _make_lexicon(lexicon_t *a_lexicon,
+                          const EmbeddingStore *a_store,
+                          const w2ps_t *a_seeds, const v2ps_t *a_known,
+                          const v2ps_t *a_expanded, const int a_n_new) {
+  using vps_t = std::pair<vid_t, ps_t>;
+  std::vector<vps_t> new_terms;
+  for (auto &v2ps : *a_expanded) {
+    if (!a_known->count(v2ps.first))
+      new_terms.push_back(v2ps);
+  }
+  if (a_n_new >= 0 && new_terms.size() > static_cast<size_t>(a_n_new)) {
+    std::nth_element(new_terms.begin(), new_terms.begin() + a_n_new,
+                     new_terms.end(),
+                     [](const vps_t &a_t1, const vps_t &a_t2) {
+                       return a_t1.second.second < a_t2.second.second
+                           || (a_t1.second.second == a_t2.second.second
+                               && a_t1.first < a_t2.first);});
+    new_terms.resize(a_n_new);
+  }
+
+  // add new words to the seeds (known polarities are never overridden)
+  w2ps_t word2polscore(*a_seeds);
+  for (auto &v2ps : new_terms)
+    word2polscore.emplace(a_store->word(v2ps.first), v2ps.second);
+
+  a_lexicon->clear();
+  a_lexicon->reserve(word2polscore.size());
+  for (auto &w2p : word2polscore) {
+    if (w2p.second.first == Polarity::NEUTRAL)
+      continue;
+
+    a_lexicon->push_back(LexEntry {w2p.first, w2p.second.first,
+          fabs(w2p.second.second)});
+  }
+  // sort words (ties are broken alphabetically, so that the result
+  // does not depend on the order in which terms were added)
+  std::sort(a_lexicon->begin(), a_lexicon->end(),
+            [](const lex_entry_t &a_e1, const lex_entry_t &a_e2) {
+              return a_e1.m_score < a_e2.m_score
+                  || (a_e1.m_score == a_e2.m_score
+                      && a_e1.m_word < a_e2.m_word);});
+}
+
+int parse_expansion_setting(const std::string &a_setting,
+                            expander_options_t *a_options,
+                            expansion_params_t *a_params,
+                            std::string *a_error) {
+  const size_t eq_pos = a_setting.find('=');
+  if (eq_pos == std::string::npos) {
+    *a_error = "Invalid setting '" + a_setting + "'";
+    return 1;
+  }
+  const std::string key = a_setting.substr(0, eq_pos);
+  const int value = std::atoi(a_setting.c_str() + eq_pos + 1);
+  if (key == "type") {
+    if (value < 0 || value >= static_cast<int>(ExpansionType::MAX_SENTINEL)) {
+      *a_error = "Invalid type of expansion algorithm";
+      return 1;
+    }
+    a_options->m_type = static_cast<ExpansionType>(value);
+  } else if (key == "length-normalize") {
+    a_options->m_no_length_normalize = !value;
+  } else if (key == "mean-normalize") {
+    a_options->m_no_mean_normalize = !value;
+  } else if (key == "k") {
+    if (value < 1) {
+      *a_error = "k should be >= 1";
+      return 1;
+    }
+    a_params->m_knn = value;
+  } else if (key == "n-terms") {
+    a_params->m_n_terms = value;
+  } else {
+    *a_error = "Unknown setting '" + key + "'";
+    return 1;
+  }
+  return 0;
+}
+
+Expander::Expander(const EmbeddingStore *a_store,
+                   const expander_options_t &a_options):
+  m_store{a_store}, m_options(a_options)
+{
+  const bool nc_or_knn = m_options.m_type == ExpansionType::NC_CLUSTERING
+      || m_options.m_type == ExpansionType::KNN_CLUSTERING;
+  if (m_options.m_pq_subspaces > 0 && (!nc_or_knn || m_options.m_ivf))
+    throw std::invalid_argument("Product quantization is only supported"
+                                " by the nearest centroids and the exact"
+                                " KNN algorithms.");
+  if (m_options.m_int8 && (!nc_or_knn || m_options.m_ivf
+                           || m_options.m_pq_subspaces > 0))
+    throw std::invalid_argument("8-bit integer vectors are only supported"
+                                " by the nearest centroids and the exact"
+                                " KNN algorithms without product"
+                                " quantization.");
+  if (m_options.m_type < ExpansionType::NC_CLUSTERING
+      || m_options.m_type >= ExpansionType::MAX_SENTINEL)
+    throw std::invalid_argument("Invalid type of seed set"
+                                " expansion algorithm.");
+  if (m_options.m_knn < 1)
+    throw std::invalid_argument("Number of nearest neighbors should be"
+                                " >= 1.");
+
+  if (m_store->options().m_single_precision)
+    prepare<float>();
+  else
+    prepare<double>();
+}
+
+template <>
+nwe_norm_t<double> *Expander::own_norm<double>() {
+  return &m_norm;
+}
+
+template <>
+nwe_norm_t<float> *Expander::own_norm<float>() {
+  return &m_norm32;
+}
+
+template <>
+NWEView<double> Expander::view<double>() const {
+  return NWEView<double>(m_store->matrix<double>(),
+                         m_own_norm? &m_norm: m_store->norm<double>());
+}
+
+template <>
+NWEView<float> Expander::view<float>() const {
+  return NWEView<float>(m_store->matrix<float>(),
+                        m_own_norm? &m_norm32: m_store->norm<float>());
+}
+
+/**
+ * Build auxiliary data requested by the options
+ *
+ * @return \c void
+ */
+template <typename eT>
+void Expander::prepare() {
+  if (m_store->matrix<eT>() == nullptr)
+    throw std::invalid_argument("Word vectors are not loaded.");
+
+  // elongated vectors are never length-normalized
+  const store_options_t &store_options = m_store->options();
+  m_options.m_no_length_normalize |= store_options.m_coefficient != 1.;
+  if (m_options.m_no_length_normalize
+      != store_options.m_no_length_normalize
+      || m_options.m_no_mean_normalize
+      != store_options.m_no_mean_normalize) {
+    if (m_store->normalize(own_norm<eT>(),
+                           m_options.m_no_length_normalize,
+                           m_options.m_no_mean_normalize))
+      throw std::invalid_argument("Word vectors cannot be normalized"
+                                  " as requested.");
+    m_own_norm = true;
+  }
+  const NWEView<eT> nwe = view<eT>();
+
+  if (m_options.m_ivf
+      && m_options.m_type == ExpansionType::KNN_CLUSTERING) {
+    // indices of differently normalized vectors are kept apart
+    std::string ivf_fname = m_store->fname();
+    if (m_own_norm)
+      ivf_fname += "." + std::to_string(m_options.normalization_index());
+    ivf_fname += ".ivf";
+    open_ivf_index(&m_ivf_index, ivf_fname.c_str(), &nwe,
+                   m_options.m_ivf_lists, m_options.m_ivf_probes);
+  }
+
+  // the principal components only depend on the vectors
+  if (m_options.m_type == ExpansionType::PCA_CLUSTERING)
+    prepare_pca(&nwe);
+
+  const double n_mbytes = nwe.n_rows * nwe.n_cols * sizeof(eT)
+      / 1048576.;
+  if (m_options.m_pq_subspaces > 0) {
+    std::cerr << "Compressing word vectors ... ";
+    train_pq_store(&m_pq, &nwe, m_options.m_pq_subspaces);
+    std::cerr << "done (" << m_pq.m_n_subspaces << " bytes per vector, "
+              << pq_memory(&m_pq) / 1048576. << " MB instead of "
+              << n_mbytes << " MB)" << std::endl;
+  }
+
+  if (m_options.m_int8) {
+    std::cerr << "Quantizing word vectors ... ";
+    quantize_i8_store(&m_i8, &nwe);
+    std::cerr << "done (" << i8_memory(&m_i8) / 1048576.
+              << " MB instead of " << n_mbytes << " MB)" << std::endl;
+  }
+}
+
+/**
+ * Compute principal components of the vectors or read them from the
+ * cache
+ *
+ * Cached components come with the projections of all vectors on them,
+ * so that PCA expansions do not need to project the vectors.
+ *
+ * @param a_nwe - vectors normalized as requested by the options
+ *
+ * @return \c void
+ */
+template <typename eT>
+void Expander::prepare_pca(const NWEView<eT> *a_nwe) {
+  const nwe_cache_t *cache = m_store->cache();
+  if (cache == nullptr) {
+    compute_pca_basis(&m_pca_basis, a_nwe, m_options.m_pca_components);
+    return;
+  }
+
+  const std::string fname = nwe_cache_fname(
+      cache, nwe_norm_key(sizeof(eT), !m_options.m_no_length_normalize,
+                          !m_options.m_no_mean_normalize,
+                          m_store->options().m_coefficient)
+      + ".pca" + std::to_string(m_options.m_pca_components));
+  if (load_pca_basis(fname, &m_pca_basis, a_nwe->n_rows,
+                     a_nwe->n_cols) == 0) {
+    std::cerr << "Using cached principal components " << fname
+              << std::endl;
+    return;
+  }
+  compute_pca_basis(&m_pca_basis, a_nwe, m_options.m_pca_components);
+  project_pca_basis(&m_pca_basis, a_nwe);
+  save_pca_basis(fname, &m_pca_basis);
+}
+
+bool Expander::needs_matrix() const {
+  // uncompressed vectors are only needed for reranking or validation
+  if (m_options.m_pq_subspaces > 0)
+    return m_options.m_pq_rerank > 0;
+  if (m_options.m_int8)
+    return m_options.m_int8_validate;
+  return true;
+}
+
+/**
+ * Run the requested expansion algorithm
+ *
+ * @param a_vecid2pol - map of vector id's with known polarities
+ *                      (modified in place)
+ * @param a_n_terms - number of new terms to extract
+ * @param a_knn - number of nearest neighbors to consider
+ *
+ * @return \c void
+ */
+template <typename eT>
+void Expander::run(v2ps_t *a_vecid2pol, const int a_n_terms,
+                   const int a_knn) const {
+  // the view is empty if the matrix has been released, which only
+  // happens if it is not needed
+  const NWEView<eT> vecs = view<eT>();
+  const NWEView<eT> *nwe = &vecs;
+  const expander_options_t &opt = m_options;
+  const bool is_nc = opt.m_type == ExpansionType::NC_CLUSTERING;
+
+  // run the algorithms on compressed vectors (uncompressed ones are
+  // only used for reranking, so that the result does not depend on
+  // whether the matrix of the store has been released)
+  if (opt.m_pq_subspaces > 0) {
+    const NWEView<eT> *exact = opt.m_pq_rerank > 0? nwe: nullptr;
+    if (is_nc)
+      expand_nearest_centroids_pq(a_vecid2pol, &m_pq, exact, a_n_terms,
+                                  false, opt.m_tolerance, opt.m_pq_rerank);
+    else
+      expand_knn_pq(a_vecid2pol, &m_pq, exact, a_n_terms, a_knn,
+                    opt.m_pq_rerank);
+    return;
+  }
+
+  if (opt.m_int8) {
+    const v2ps_t seeds = *a_vecid2pol;
+    if (is_nc)
+      expand_nearest_centroids_i8(a_vecid2pol, &m_i8, a_n_terms, false,
+                                  opt.m_tolerance);
+    else
+      expand_knn_i8(a_vecid2pol, &m_i8, a_n_terms, a_knn);
+
+    if (opt.m_int8_validate) {
+      v2ps_t exact = seeds;
+      if (is_nc)
+        expand_nearest_centroids(&exact, nwe, a_n_terms, false,
+                                 opt.m_tolerance);
+      else
+        expand_knn(&exact, nwe, a_n_terms, a_knn);
+      _report_i8_validation(&seeds, a_vecid2pol, &exact);
+    }
+    return;
+  }
+
+  // apply the requested expansion algorithm
+  switch (opt.m_type) {
+  case ExpansionType::NC_CLUSTERING:
+    expand_nearest_centroids(a_vecid2pol, nwe, a_n_terms, false,
+                             opt.m_tolerance);
+    break;
+  case ExpansionType::KNN_CLUSTERING:
+    expand_knn(a_vecid2pol, nwe, a_n_terms, a_knn,
+               opt.m_ivf? &m_ivf_index: nullptr, opt.m_ivf_probes);
+    break;
+  case ExpansionType::PCA_CLUSTERING:
+    expand_pca(a_vecid2pol, nwe, a_n_terms, &m_pca_basis);
+    break;
+  case ExpansionType::PRJ_CLUSTERING:
+    expand_projection(a_vecid2pol, nwe, a_n_terms, opt.m_alpha,
+                      opt.m_delta, opt.m_max_iters);
+    break;
+  default:
+    throw std::invalid_argument("Invalid type of seed set"
+                                " expansion algorithm.");
+  }
+}
+
+/**
+ * Run the requested expansion algorithm for several numbers of
+ * neighbors
+ *
+ * @param a_vecid2pols - maps of vector id's with known polarities (one
+ *                       per element of `a_knns`, modified in place)
+ * @param a_n_terms - number of new terms to extract
+ * @param a_knns - numbers of nearest neighbors to consider
+ *
+ * @return \c void
+ */
+template <typename eT>
+void Expander::run_many(std::vector<v2ps_t> *a_vecid2pols,
+                        const int a_n_terms,
+                        const std::vector<int> *a_knns) const {
+  // the neighbors of uncompressed vectors are searched only once
+  if (m_options.m_type == ExpansionType::KNN_CLUSTERING
+      && m_options.m_pq_subspaces == 0 && !m_options.m_int8) {
+    const NWEView<eT> nwe = view<eT>();
+    expand_knn_multi(a_vecid2pols, &nwe, a_n_terms, a_knns,
+                     m_options.m_ivf? &m_ivf_index: nullptr,
+                     m_options.m_ivf_probes);
+    return;
+  }
+  for (size_t i = 0; i < a_knns->size(); ++i)
+    run<eT>(&(*a_vecid2pols)[i], a_n_terms, (*a_knns)[i]);
+}
+
+int Expander::expand(const w2ps_t *a_seeds, lexicon_t *a_lexicon) const {
+  return expand(a_seeds, a_lexicon, m_options.m_n_terms, m_options.m_knn);
+}
+
+int Expander::expand(const w2ps_t *a_seeds, lexicon_t *a_lexicon,
+                     const int a_n_terms, const int a_knn) const {
+  std::vector<expansion_params_t> params(1);
+  params[0].m_n_terms = a_n_terms;
+  params[0].m_knn = a_knn;
+  std::vector<lexicon_t> lexicons;
+  int ret = expand_many(a_seeds, &params, &lexicons);
+  if (ret == 0)
+    a_lexicon->swap(lexicons.front());
+  else
+    a_lexicon->clear();
+  return ret;
+}
+
+int Expander::expand_many(const w2ps_t *a_seeds,
+                          const std::vector<expansion_params_t> *a_params,
+                          std::vector<lexicon_t> *a_lexicons) const {
+  const size_t n_params = a_params->size();
+  // the KNN algorithms size their neighbor heaps by K
+  for (auto &params : *a_params) {
+    if (params.m_knn < 1)
+      throw std::invalid_argument("Number of nearest neighbors should be"
+                                  " >= 1.");
+  }
+  a_lexicons->assign(n_params, lexicon_t());
+  const bool single_precision = m_store->options().m_single_precision;
+  if (needs_matrix() && (single_precision?
+                         m_store->matrix<float>() == nullptr:
+                         m_store->matrix<double>() == nullptr)) {
+    std::cerr << "Word vectors have been released" << std::endl;
+    return 1;
+  }
+
+  // generate mapping from vector ids to the polarities of respective
+  // words
+  v2ps_t vecid2polscore;
+  int seed_cnt = 0;
+  vid_t vecid;
+  for (auto &w2p : *a_seeds) {
+    if (w2p.second.first != Polarity::NEUTRAL)
+      ++seed_cnt;
+
+    if (m_store->find(w2p.first, &vecid))
+      vecid2polscore.emplace(vecid, w2p.second);
+  }
+
+  // determine the number of new terms of each expansion (the lexicon
+  // size includes the seeds)
+  std::vector<int> n_new(n_params);
+  int n_terms;
+  for (size_t i = 0; i < n_params; ++i) {
+    n_terms = (*a_params)[i].m_n_terms;
+    n_new[i] = n_terms < 0? -1: std::max(0, n_terms - seed_cnt);
+  }
+
+  // group the expansions by the number of neighbors (which only
+  // matters for KNN) and run the algorithm once for the largest
+  // number of new terms; reranking of product-quantized candidates
+  // depends on this number, so that expansions cannot share a run then
+  const bool is_knn = m_options.m_type == ExpansionType::KNN_CLUSTERING;
+  const bool shared = !(m_options.m_pq_subspaces > 0
+                        && m_options.m_pq_rerank > 0);
+  std::map<std::pair<int, size_t>, size_t> key2run;
+  std::vector<size_t> runs(n_params);
+  std::vector<int> run_knns, run_n_new;
+  std::pair<int, size_t> key;
+  for (size_t i = 0; i < n_params; ++i) {
+    key.first = is_knn? (*a_params)[i].m_knn: 0;
+    key.second = shared? 0: i;
+    auto it = key2run.find(key);
+    if (it == key2run.end()) {
+      it = key2run.emplace(key, run_knns.size()).first;
+      run_knns.push_back((*a_params)[i].m_knn);
+      run_n_new.push_back(n_new[i]);
+    }
+    runs[i] = it->second;
+    run_n_new[it->second] = _max_terms(run_n_new[it->second], n_new[i]);
+  }
+
+  std::vector<v2ps_t> expanded(run_knns.size(), vecid2polscore);
+  if (shared) {
+    // all groups share the largest number of new terms
+    int max_new = 0;
+    for (int n : run_n_new)
+      max_new = _max_terms(max_new, n);
+    if (max_new != 0) {
+      if (single_precision)
+        run_many<float>(&expanded, max_new, &run_knns);
+      else
+        run_many<double>(&expanded, max_new, &run_knns);
+    }
+  } else {
+    for (size_t r = 0; r < expanded.size(); ++r) {
+      if (run_n_new[r] == 0)
+        continue;
+
+      if (single_precision)
+        run<float>(&expanded[r], run_n_new[r], run_knns[r]);
+      else
+        run<double>(&expanded[r], run_n_new[r], run_knns[r]);
+    }
+  }
+
+  for (size_t i = 0; i < n_params; ++i)
+    _make_lexicon(&(*a_lexicons)[i], m_store, a_seeds, &vecid2polscore,
+                  &expanded[runs[i]], n_new[i]);
+  return 0;
+}
@@ -0,0 +1,280 @@
+/** @file expander.h
+ *
+ *  @brief expansion of seed sets over a shared embedding store.
+ *
+ *  This file declares a class which runs one of the expansion
+ *  algorithms from expansion.h over the vectors of an
+ *  `EmbeddingStore` and returns the resulting lexicon ranked by score.
+ *  All auxiliary data (normalization, compressed vectors, and search
+ *  indices) are built when the expander is constructed; afterwards,
+ *  `expand()` does not modify the expander or the store, so that any
+ *  number of expansions can run concurrently over one loaded matrix.
+ */
+
+#ifndef VEC2DIC_EXPANDER_H_
+# define VEC2DIC_EXPANDER_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/i8_store.h"
+#include "src/vec2dic/ivf_index.h"
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/pq_store.h"
+
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Type of algorithm to use for lexicon expansion.
+ */
+enum class ExpansionType: int {
+  NC_CLUSTERING = 0,          // Nearest centroids algorithm
+    KNN_CLUSTERING,           // K-nearest neighbors
+    PCA_CLUSTERING,           // Proincipal component analysis
+    PRJ_CLUSTERING,           // Projection-based clustering
+    MAX_SENTINEL              // Unused type that serves as a sentinel
+    };
+
+/** Number of distinct normalizations of word vectors */
+const int N_NORMALIZATIONS = 4;
+
+/**
+ * Options of an expander.
+ */
+using expander_options_t = struct ExpanderOptions {
+  /// algorithm to use for expansion
+  ExpansionType m_type = ExpansionType::NC_CLUSTERING;
+  /// maximum size of the lexicon including the seeds (-1 means all
+  /// new terms)
+  int m_n_terms = -1;
+  /// number of nearest neighbors to consider by the KNN algorithm
+  int m_knn = 5;
+  /// number of principal components considered by the PCA method
+  int m_pca_components = DFLT_PCA_COMPONENTS;
+  /// learning rate for gradient methods
+  double m_alpha = DFLT_ALPHA;
+  /// minimum required improvement for gradient methods
+  double m_delta = DFLT_DELTA;
+  /// maximum number of gradient updates
+  unsigned long m_max_iters = MAX_ITERS;
+  /// convergence tolerance of the nearest centroids algorithm
+  double m_tolerance = 0.;
+  /// use approximate KNN search with an IVF index
+  bool m_ivf = false;
+  /// number of cells of the IVF index (0 means choose automatically)
+  int m_ivf_lists = DFLT_IVF_LISTS;
+  /// number of IVF cells probed per term
+  int m_ivf_probes = DFLT_IVF_PROBES;
+  /// number of product quantization subspaces (0 means no compression)
+  int m_pq_subspaces = 0;
+  /// factor of approximate candidates rescored exactly (0 means none)
+  int m_pq_rerank = 0;
+  /// store vectors as 8-bit integers
+  bool m_int8 = false;
+  /// compare the results on 8-bit integers with the uncompressed ones
+  bool m_int8_validate = false;
+  /// do not normalize length of the vectors
+  bool m_no_length_normalize = false;
+  /// do not center means of the vectors
+  bool m_no_mean_normalize = false;
+
+  /// index of the normalization in `[0, N_NORMALIZATIONS)`
+  int normalization_index() const {
+    return (m_no_length_normalize? 1: 0) | (m_no_mean_normalize? 2: 0);
+  }
+};
+
+/**
+ * Parameters which may differ between expansions of one expander.
+ */
+using expansion_params_t = struct ExpansionParams {
+  /// maximum size of the lexicon including the seeds (-1 means all
+  /// new terms)
+  int m_n_terms = -1;
+  /// number of nearest neighbors to consider by the KNN algorithm
+  int m_knn = 5;
+};
+
+/**
+ * Entry of a generated lexicon.
+ */
+using lex_entry_t = struct LexEntry {
+  /// polar term
+  std::string m_word;
+  /// polarity class of the term
+  Polarity m_polarity;
+  /// (absolute) polarity score of the term
+  dist_t m_score;
+};
+
+/** Lexicon ranked by ascending scores */
+using lexicon_t = std::vector<lex_entry_t>;
+
+/////////////
+// Classes //
+/////////////
+
+/**
+ * Expander of seed sets.
+ *
+ * The store has to outlive the expander and must not be modified while
+ * the expander is in use.
+ */
+class Expander {
+ public:
+  /**
+   * Prepare expansion with the given options
+   *
+   * The normalization of the vectors (if it differs from the one of
+   * the store), compressed vectors, and the IVF index (if requested)
+   * are built here.
+   *
+   * @param a_store - loaded word vectors
+   * @param a_options - algorithm and its parameters
+   *
+   * @throws std::invalid_argument if the options are not supported
+   */
+  Expander(const EmbeddingStore *a_store,
+           const expander_options_t &a_options);
+  Expander(const Expander &) = delete;
+  Expander &operator=(const Expander &) = delete;
+
+  /// options of the expander
+  const expander_options_t &options() const {
+    return m_options;
+  }
+
+  /// check whether expansion accesses the uncompressed vectors of the
+  /// store (otherwise, the matrix of the store may be released)
+  bool needs_matrix() const;
+
+  /**
+   * Expand seed set
+   *
+   * Seeds which do not occur in the store are kept in the lexicon but
+   * do not take part in the expansion.  Neutral terms are omitted from
+   * the result.
+   *
+   * @param a_seeds - seed terms and their polarities
+   * @param a_lexicon - lexicon to populate (seeds and new terms
+   *                    ranked by ascending absolute scores, ties are
+   *                    broken alphabetically)
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   */
+  int expand(const w2ps_t *a_seeds, lexicon_t *a_lexicon) const;
+
+  /**
+   * Expand seed set with the given lexicon size and number of neighbors
+   *
+   * @param a_seeds - seed terms and their polarities
+   * @param a_lexicon - lexicon to populate
+   * @param a_n_terms - maximum size of the lexicon including the seeds
+   *                    (-1 means all new terms)
+   * @param a_knn - number of nearest neighbors to consider by the KNN
+   *                    algorithm
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   *
+   * @throws std::invalid_argument if the number of neighbors is < 1
+   */
+  int expand(const w2ps_t *a_seeds, lexicon_t *a_lexicon,
+             const int a_n_terms, const int a_knn) const;
+
+  /**
+   * Expand one seed set with several parameter settings at once
+   *
+   * Settings which only differ in the lexicon size share a single run
+   * of the algorithm whose result is truncated, and the neighbors of
+   * the KNN algorithm are searched only once for all values of K.  The
+   * lexicons are the same as those returned by separate calls of
+   * `expand()`.
+   *
+   * @param a_seeds - seed terms and their polarities
+   * @param a_params - lexicon sizes and numbers of neighbors
+   * @param a_lexicons - lexicons to populate (one per element of
+   *                     `a_params`)
+   *
+   * @return \c 0 on success, non-\c 0 otherwise
+   *
+   * @throws std::invalid_argument if a number of neighbors is < 1
+   */
+  int expand_many(const w2ps_t *a_seeds,
+                  const std::vector<expansion_params_t> *a_params,
+                  std::vector<lexicon_t> *a_lexicons) const;
+
+ private:
+  template <typename eT>
+  void prepare();
+
+  template <typename eT>
+  void prepare_pca(const NWEView<eT> *a_nwe);
+
+  template <typename eT>
+  void run(v2ps_t *a_vecid2pol, const int a_n_terms,
+           const int a_knn) const;
+
+  template <typename eT>
+  void run_many(std::vector<v2ps_t> *a_vecid2pols, const int a_n_terms,
+                const std::vector<int> *a_knns) const;
+
+  template <typename eT>
+  nwe_norm_t<eT> *own_norm();
+
+  /// word vectors normalized as requested by the options
+  template <typename eT>
+  NWEView<eT> view() const;
+
+  /// word vectors
+  const EmbeddingStore *m_store;
+  /// algorithm and its parameters
+  expander_options_t m_options;
+  /// normalization of the vectors if it differs from the one of the
+  /// store (double precision)
+  nwe_norm_t<double> m_norm {};
+  /// normalization of the vectors if it differs from the one of the
+  /// store (single precision)
+  nwe_norm_t<float> m_norm32 {};
+  /// whether `m_norm` or `m_norm32` is used instead of the store's
+  bool m_own_norm = false;
+  /// inverted-file index (only built if `m_ivf` is set)
+  ivf_index_t m_ivf_index {};
+  /// product-quantized vectors (only built if `m_pq_subspaces` is set)
+  pq_store_t m_pq {};
+  /// 8-bit integer vectors (only built if `m_int8` is set)
+  i8_store_t m_i8 {};
+  /// principal components of the vectors (only computed for PCA)
+  pca_basis_t m_pca_basis {};
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Parse a single `KEY=VALUE` setting of an expansion
+ *
+ * Recognized keys are `type`, `length-normalize`, `mean-normalize`,
+ * `k`, and `n-terms`.
+ *
+ * @param a_setting - setting to parse
+ * @param a_options - algorithm and normalization to set
+ * @param a_params - parameters to set
+ * @param a_error - description of the problem if the setting is
+ *                  invalid
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int parse_expansion_setting(const std::string &a_setting,
+                            expander_options_t *a_options,
+                            expansion_params_t *a_params,
+                            std::string *a_error);
+
+#endif    // VEC2DIC_EXPANDER_H_
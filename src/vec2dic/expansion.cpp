@@ -2,15 +2,25 @@
 // Includes //
 //////////////
 #include "src/vec2dic/expansion.h"
-
-#include <cassert>                      // assert
-
-#include <algorithm>                    // std::swap(), std::sort()
+#include "src/vec2dic/i8_store.h"
+#include "src/vec2dic/ivf_index.h"
+#include "src/vec2dic/kernels.h"
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/phase_profile.h"
+#include "src/vec2dic/pq_store.h"
+
+#include <algorithm>                    // std::sort(), std::push_heap()
+#include <cstdint>                      // uint8_t
 #include <cstdlib>                      // size_t
 #include <iostream>                     // std::cerr
 #include <cmath>			// fabs(), sqrt()
-#include <unordered_set>                // std::unordered_set
-#include <queue>                        // std::priority_queue
+#include <random>                       // std::mt19937_64
+#include <stdexcept>                    // std::invalid_argument
+#include <vector>                       // std::vector
+
+#ifdef _OPENMP
+# include <omp.h>                       // omp_get_max_threads()
+#endif
 
 ///////////
 // Types //
@@ -19,14 +29,27 @@
 /** Integral type for polarity id */
 using pol_t = size_t;
 
-/** Set of NWE id's */
-using vids_t = std::unordered_set<vid_t>;
-
-/** Map from polarity id to a set of respective NWE id's */
-using pi2v_t = std::unordered_map<size_t, vids_t>;
+/** Dense cluster assignments of the nearest centroids algorithm */
+using nc_clusters_t = struct NCClusters {
+  /// cluster index of each vector (`NC_NO_LABEL` if unassigned)
+  std::vector<uint8_t> m_labels;
+  /// sums of the vectors of each cluster (one column per cluster)
+  arma::mat m_sums;
+  /// number of vectors in each cluster
+  std::vector<size_t> m_counts;
+};
 
-/** Map from NWE id to polarity id */
-using v2pi_t = std::unordered_map<vid_t, size_t>;
+/** Code histograms of the nearest centroids algorithm over
+    product-quantized vectors */
+using nc_pq_clusters_t = struct NCPQClusters {
+  /// cluster index of each vector (`NC_NO_LABEL` if unassigned)
+  std::vector<uint8_t> m_labels;
+  /// number of vectors of each cluster having each code in each
+  /// subspace (`N_POLARITIES x n_subspaces x PQ_N_CODES`)
+  std::vector<long long> m_hists;
+  /// number of vectors in each cluster
+  std::vector<long long> m_counts;
+};
 
 /** 3-tuple of vector id, vector polarity, and its distance to the
     nearest centroid */
@@ -64,15 +87,65 @@ using vpd_t = struct VPD {
     to the centroid */
 using vpd_v_t = std::vector<vpd_t>;
 
+/**
+ * Bounded selector of the candidates with the smallest distances.
+ *
+ * Candidates are kept in a max-heap of at most `m_N` elements, so that
+ * selecting the best N out of V candidates takes O(V log N) time and
+ * O(N) memory.  Neutral candidates are never selected.  Each thread
+ * feeds its own selector; the selectors are merged at the end.
+ */
+using top_n_t = struct TopN {
+  /// maximum number of candidates to keep (negative means unlimited)
+  int m_N = -1;
+  /// kept candidates (a max-heap unless the number is unlimited)
+  vpd_v_t m_vpds {};
+
+  TopN(void) {}
+
+  explicit TopN(const int a_N):
+    m_N{a_N}
+  {}
+
+  /// order candidates by their distances (ties are broken by vector
+  /// id's, so that the selection does not depend on the feeding order)
+  static bool less(const VPD &a_vpd1, const VPD &a_vpd2) {
+    return a_vpd1.m_distance < a_vpd2.m_distance
+        || (a_vpd1.m_distance == a_vpd2.m_distance
+            && a_vpd1.m_vecid < a_vpd2.m_vecid);
+  }
+
+  /// offer a candidate to the selector
+  void push(const VPD &a_vpd) {
+    if (a_vpd.m_polarity == NEUTRAL)
+      return;
+
+    if (m_N < 0) {
+      m_vpds.push_back(a_vpd);
+    } else if (m_vpds.size() < static_cast<size_t>(m_N)) {
+      m_vpds.push_back(a_vpd);
+      std::push_heap(m_vpds.begin(), m_vpds.end(), less);
+    } else if (m_N > 0 && less(a_vpd, m_vpds.front())) {
+      std::pop_heap(m_vpds.begin(), m_vpds.end(), less);
+      m_vpds.back() = a_vpd;
+      std::push_heap(m_vpds.begin(), m_vpds.end(), less);
+    }
+  }
+
+  /// move all candidates of another selector into this one
+  void merge(TopN *a_other) {
+    for (auto &vpd : a_other->m_vpds)
+      push(vpd);
+
+    vpd_v_t().swap(a_other->m_vpds);
+  }
+};
+
 /** set of 3-tuples of vector id, vector polarity, and distctance
     to the centroid */
 using pd_t = std::pair<pol_t, dist_t>;
 using vpd_m_t = std::unordered_map<vid_t, pd_t>;
 
-/** priority queue of 3-tuples of vector id, vector polarity, and
-    distctance to the centroid */
-using vpd_pq_t = std::priority_queue<vpd_t>;
-
 /** struct comprising means and variances of polarity vectors  */
 using pol_stat_t = struct {
   // dimension with the biggest distance between subjective and
@@ -114,6 +187,7 @@ using pol_stat_t = struct {
 const double DFLT_ALPHA = 1e-5;
 const double DFLT_DELTA = 1e-10;
 const int MAX_ITERS = 1e6;
+const int DFLT_PCA_COMPONENTS = 20;
 
 const vid_t POS_VID = static_cast<vid_t>(POSITIVE);
 const vid_t NEG_VID = static_cast<vid_t>(NEGATIVE);
@@ -121,6 +195,40 @@ const vid_t NEUT_VID = static_cast<vid_t>(NEUTRAL);
 
 const bool debug = false;
 
+/** Label of vectors which are not assigned to any cluster */
+const uint8_t NC_NO_LABEL = std::numeric_limits<uint8_t>::max();
+/** Number of vectors whose coordinates are summed up at once when
+    computing centroids */
+const size_t NC_BLOCK = 4096;
+
+/** Number of candidate vectors processed at once by the KNN search */
+const size_t KNN_CAND_BLOCK = 512;
+/** Number of seed vectors multiplied at once by the KNN search */
+const size_t KNN_SEED_BLOCK = 2048;
+/** Number of candidate blocks on which the recall of the approximate
+    KNN search is estimated */
+const size_t KNN_RECALL_BLOCKS = 8;
+
+/** Number of product-quantized candidates processed at once */
+const size_t PQ_CAND_BLOCK = 4096;
+/** Number of seeds whose distance tables are scanned at once */
+const size_t PQ_SEED_TILE = 32;
+/** Number of vectors multiplied at once when computing principal
+    components */
+const size_t PCA_BLOCK = 65536;
+/** Number of normalized vectors multiplied at once when computing
+    principal components */
+const size_t PCA_LAZY_BLOCK = 2048;
+/** Number of additional directions used by the randomized PCA */
+const size_t PCA_OVERSAMPLING = 10;
+/** Number of power iterations of the randomized PCA */
+const size_t PCA_POWER_ITERS = 2;
+/** Seed of the random generator of the randomized PCA */
+const unsigned long PCA_SEED = 42;
+/** Number of seed vectors contributing to one partial gradient of the
+    projection line */
+const size_t PRJ_BATCH = 256;
+
 const size_t POS_IDX = 0, NEG_IDX = 1, NEUT_IDX = 2, SUBJ_IDX = 3;
 const size_t POLID2IDX[] = {10, POS_IDX, NEG_IDX, SUBJ_IDX, NEUT_IDX};
 const pol_t IDX2POLID[] = {1, 2, 4, 10, 10};
@@ -130,81 +238,56 @@ const pol_t IDX2POLID[] = {1, 2, 4, 10, 10};
 /////////////
 
 /**
- * Check whether two matrices are equal.
- *
- * @param a_mat1 - 1-st matrix to compare
- * @param a_mat2 - 2-nd matrix to compare
+ * Return the number of threads available to parallel regions
  *
- * @return \c true if both matrices are equal, \c false otherwise
+ * @return maximum number of OpenMP threads (1 without OpenMP)
  */
-static bool _cmp_mat(const arma::mat *a_mat1, const arma::mat *a_mat2) {
-  bool ret = ((a_mat1->n_rows == a_mat2->n_rows) \
-              && (a_mat1->n_cols == a_mat2->n_cols));
-  if (!ret)
-    return ret;
-
-  size_t i, j;
-  for (i = 0; i < a_mat1->n_cols; ++i) {
-    for (j = 0; j < a_mat1->n_rows; ++j) {
-      if (!(ret = ((*a_mat1)(j, i) == (*a_mat2)(j, i))))
-    return ret;
-    }
-  }
-  return ret;
+static inline int _n_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
 }
 
 /**
- * Compute unnormaized Euclidean distance between two vectors
- *
- * @param a_vec1 - 1-st vector
- * @param a_vec2 - 2-nd vector
- * @param a_N - number of elements in each vector
+ * Return the id of the calling thread within a parallel region
  *
- * @return unnormaized Euclidean distance between vectors
+ * @return OpenMP thread number (0 without OpenMP)
  */
-static inline dist_t _unnorm_eucl_distance(const dist_t *a_vec1,
-                                           const dist_t *a_vec2,
-                                           size_t a_N) {
-  dist_t tmp_i = 0., idistance = 0;
-
-  for (size_t i = 0; i < a_N; ++i) {
-    tmp_i = a_vec1[i] - a_vec2[i];
-    idistance += tmp_i * tmp_i;
-  }
-  return idistance;
+static inline int _thread_id() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
 }
 
 /**
  * Add newly extracted terms to the polarity lexicon.
  *
  * @param a_vecid2pol - target dictionary mapping vector id's to polarities
- * @param a_vpds - source vector of NWE ids, their polarities, and distances
- * @param a_j - actual number of new terms
- * @param a_N - maximum number of terms to extract (-1 means unlimited)
+ * @param a_thread_tops - thread-local selectors of the best candidates
+ *                        (cleared afterwards)
  *
  * @return \c void
  */
-static inline void _add_terms(v2ps_t *a_vecid2pol,
-                              vpd_v_t *a_vpds,
-                              const int a_j, const int a_N) {
-  // sort vpds according to their distances to the centroids
-  std::sort(a_vpds->begin(), a_vpds->end());
-  // add new terms to the dictionary
-  vpd_t *ivpd;
-  // `i' is the actual number of added terms and `j' is the total
-  // counter
-  for (int i = 0, j = 0; (a_N < 0 || i < a_N) && j < a_j; ++j) {
-    ivpd = &(*a_vpds)[j];
+static void _add_terms(v2ps_t *a_vecid2pol,
+                       std::vector<top_n_t> *a_thread_tops) {
+  PhaseTimer timer("top_n");
+  // merge thread-local selections
+  top_n_t *top = &a_thread_tops->front();
+  for (size_t i = 1; i < a_thread_tops->size(); ++i)
+    top->merge(&(*a_thread_tops)[i]);
 
-    if (ivpd->m_polarity == NEUTRAL)
-      continue;
-
-    a_vecid2pol->emplace(ivpd->m_vecid,
+  // add new terms to the dictionary
+  for (auto &vpd : top->m_vpds) {
+    a_vecid2pol->emplace(vpd.m_vecid,
 			 std::make_pair(
-					static_cast<Polarity>(ivpd->m_polarity),
-					ivpd->m_distance));
-    ++i;
+					static_cast<Polarity>(vpd.m_polarity),
+					vpd.m_distance));
   }
+  vpd_v_t().swap(top->m_vpds);
 }
 
 /**
@@ -216,16 +299,17 @@ static inline void _add_terms(v2ps_t *a_vecid2pol,
  *                  Euclidean distance to the vector should be stored
  * @return id of the cluster with the nearest centroid
  */
-static pol_t _nc_find_cluster(const arma::mat *a_centroids,
-                              const double *a_vec,
+template <typename eT>
+static pol_t _nc_find_cluster(const arma::Mat<eT> *a_centroids,
+                              const eT *a_vec,
                               dist_t *a_dist = nullptr) {
   pol_t ret = 0;
-  const double *centroid;
+  const eT *centroid;
   dist_t idistance = 1., mindistance = std::numeric_limits<double>::max();
   for (size_t i = 0; i < a_centroids->n_cols; ++i) {
     centroid = a_centroids->colptr(i);
     // compute Euclidean distance from vector to centroid
-    idistance = _unnorm_eucl_distance(a_vec, centroid, a_centroids->n_rows);
+    idistance = sq_l2_distance(a_vec, centroid, a_centroids->n_rows);
     // compare distance with
     if (idistance < mindistance) {
       mindistance = idistance;
@@ -233,112 +317,193 @@ static pol_t _nc_find_cluster(const arma::mat *a_centroids,
     }
   }
   if (a_dist != nullptr)
-    *a_dist = sqrt(idistance);
+    *a_dist = sqrt(mindistance);
 
   return ret;
 }
 
 /**
- * Assign word vectors to the newly computed centroids
+ * Sum up vectors of each cluster from scratch
  *
- * @param a_polid2vecids - map from polarity id's to vector id's
- * @param a_vecid2polid - map from vector id's to polarity id's
- * @param a_centroids - newly computed centroids
+ * Sums are computed in a single sequential pass over the embedding
+ * matrix, in which fixed-size blocks of columns are processed in
+ * parallel and merged in a fixed order.  Coordinates are summed up in
+ * double precision regardless of the element type of the embeddings.
+ *
+ * @param a_clusters - cluster assignments whose sums should be computed
  * @param a_nwe - matrix containing neural word embeddings
  *
- * @return \c true if clusters changed, \c false otherwise
- */
-static bool _nc_assign(pi2v_t *a_polid2vecids, v2pi_t *a_vecid2polid, \
-               const arma::mat *a_centroids, const arma::mat *a_nwe) {
-  bool ret = false;
-  bool is_absent = false, differs = false;
-  pol_t polid;
-  vid_t N = a_nwe->n_cols;
-  vids_t::iterator v_id_pos;
-  v2pi_t::iterator it, it_end = a_vecid2polid->end();
-  // iterate over each word, find its new cluster, and reassign if
-  // necessary
-  for (vid_t vecid = 0; vecid < N; ++vecid) {
-    polid = _nc_find_cluster(a_centroids, a_nwe->colptr(vecid));
-    // obtain previous polarity of this vector
-    it = a_vecid2polid->find(vecid);
-    // assign vecid to new cluster if necessary
-    if ((is_absent = (it == it_end)) || (differs = (it->second != polid))) {
-      // remove word vector from the previous polarity class
-      if (differs) {
-    v_id_pos = (*a_polid2vecids)[it->second].find(vecid);
-    // obtain position of the vector id in its previous class set
-    if (v_id_pos != (*a_polid2vecids)[it->second].end())
-      (*a_polid2vecids)[it->second].erase(v_id_pos);
-
-    differs = false;
-      }
-      (*a_vecid2polid)[vecid] = polid;
-      (*a_polid2vecids)[polid].insert(vecid);
-      ret = true;
+ * @return \c void
+ */
+template <typename eT>
+static void _nc_compute_sums(nc_clusters_t *a_clusters,
+                             const NWEView<eT> *a_nwe) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  const size_t n_blocks = (n_cols + NC_BLOCK - 1) / NC_BLOCK;
+  const uint8_t *labels = a_clusters->m_labels.data();
+  // partial sums and counts of each block
+  arma::mat block_sums(n_rows, N_POLARITIES * n_blocks);
+  std::vector<size_t> block_counts(N_POLARITIES * n_blocks, 0);
+
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_blocks; ++b) {
+    uint8_t label;
+    const eT *ivec;
+    dist_t *isum;
+    std::vector<eT> buf(a_nwe->n_rows);
+    double *sums = block_sums.colptr(b * N_POLARITIES);
+    std::fill(sums, sums + n_rows * N_POLARITIES, 0.);
+    size_t *counts = &block_counts[b * N_POLARITIES];
+    const vid_t end = std::min<vid_t>(n_cols, (b + 1) * NC_BLOCK);
+    for (vid_t vecid = b * NC_BLOCK; vecid < end; ++vecid) {
+      if ((label = labels[vecid]) == NC_NO_LABEL)
+        continue;
+
+      ivec = a_nwe->col(vecid, buf.data());
+      isum = sums + label * n_rows;
+      for (size_t i = 0; i < n_rows; ++i)
+        isum[i] += ivec[i];
+      ++counts[label];
+    }
+  }
+
+  a_clusters->m_sums.zeros(n_rows, N_POLARITIES);
+  a_clusters->m_counts.assign(N_POLARITIES, 0);
+  for (size_t b = 0; b < n_blocks; ++b) {
+    for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+      a_clusters->m_sums.col(c_id) += block_sums.col(b * N_POLARITIES + c_id);
+      a_clusters->m_counts[c_id] += block_counts[b * N_POLARITIES + c_id];
     }
   }
-  return ret;
 }
 
 /**
- * Compute centroids of previously populated clusters
+ * Assign word vectors to their nearest centroids and update cluster
+ * sums for the vectors whose assignment changed
  *
- * @param a_new_centroids - container for storing new centroid coordinates
- * @param a_old_centroids - container storing previously computed centroids
- * @param a_pol2vecids - previously populated clusters
+ * Changes of the sums are accumulated per block of columns in
+ * parallel and merged in a fixed order, so that the result does not
+ * depend on the number of threads.
+ *
+ * @param a_clusters - cluster assignments to update
+ * @param a_centroids - current centroids
  * @param a_nwe - matrix containing neural word embeddings
  *
- * @return \c true if centroids changed, \c false otherwise
+ * @return number of vectors whose assignment changed
  */
-static bool _nc_compute_centroids(arma::mat *a_new_centroids,
-                                  const arma::mat *a_old_centroids,
-                                  const pi2v_t *a_pol2vecids,
-                                  const arma::mat *a_nwe) {
-  // zero-out new centroids
-  a_new_centroids->zeros();
-  // compute new centroids
-  pol_t c_id;
-  for (auto& p2v : *a_pol2vecids) {
-    c_id = p2v.first;
-    // sum-up coordinates of all the vectors pertaining to the given
-    // polarity
-    for (auto& vecid : p2v.second) {
-      a_new_centroids->col(c_id) += a_nwe->col(vecid);
+template <typename eT>
+static vid_t _nc_assign(nc_clusters_t *a_clusters,
+                        const arma::Mat<eT> *a_centroids,
+                        const NWEView<eT> *a_nwe) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  const size_t n_blocks = (n_cols + NC_BLOCK - 1) / NC_BLOCK;
+  uint8_t *labels = a_clusters->m_labels.data();
+  // changes of the sums and counts caused by each block (only blocks
+  // in which some vector changed its cluster are merged)
+  arma::mat block_deltas(n_rows, N_POLARITIES * n_blocks);
+  std::vector<long long> block_counts(N_POLARITIES * n_blocks, 0);
+  std::vector<vid_t> block_moved(n_blocks, 0);
+
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_blocks; ++b) {
+    uint8_t old_label, new_label;
+    const eT *ivec;
+    dist_t *isum;
+    std::vector<eT> buf(a_nwe->n_rows);
+    double *deltas = block_deltas.colptr(b * N_POLARITIES);
+    long long *counts = &block_counts[b * N_POLARITIES];
+    const vid_t end = std::min<vid_t>(n_cols, (b + 1) * NC_BLOCK);
+    for (vid_t vecid = b * NC_BLOCK; vecid < end; ++vecid) {
+      ivec = a_nwe->col(vecid, buf.data());
+      new_label = static_cast<uint8_t>(_nc_find_cluster(a_centroids, ivec));
+      if ((old_label = labels[vecid]) == new_label)
+        continue;
+
+      if (block_moved[b]++ == 0)
+        std::fill(deltas, deltas + n_rows * N_POLARITIES, 0.);
+
+      labels[vecid] = new_label;
+      if (old_label != NC_NO_LABEL) {
+        isum = deltas + old_label * n_rows;
+        for (size_t i = 0; i < n_rows; ++i)
+          isum[i] -= ivec[i];
+        --counts[old_label];
+      }
+      isum = deltas + new_label * n_rows;
+      for (size_t i = 0; i < n_rows; ++i)
+        isum[i] += ivec[i];
+      ++counts[new_label];
     }
-    // take the mean of the new centroid
-    if (p2v.second.size())
-      a_new_centroids->col(c_id) /= static_cast<float>(p2v.second.size());
   }
 
-  return !_cmp_mat(a_new_centroids, a_old_centroids);
+  vid_t n_moved = 0;
+  for (size_t b = 0; b < n_blocks; ++b) {
+    if (block_moved[b] == 0)
+      continue;
+
+    n_moved += block_moved[b];
+    for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+      a_clusters->m_sums.col(c_id) +=
+          block_deltas.col(b * N_POLARITIES + c_id);
+      a_clusters->m_counts[c_id] += block_counts[b * N_POLARITIES + c_id];
+    }
+  }
+  return n_moved;
+}
+
+/**
+ * Compute centroids from the sums of the clusters
+ *
+ * @param a_centroids - centroids to update
+ * @param a_clusters - clusters whose centroids should be computed
+ *
+ * @return maximum Euclidean distance between old and new centroids
+ */
+template <typename eT>
+static dist_t _nc_update_centroids(arma::Mat<eT> *a_centroids,
+                                   const nc_clusters_t *a_clusters) {
+  const size_t n_rows = a_centroids->n_rows;
+  eT old_coord, new_coord;
+  size_t count;
+  dist_t shift, max_shift = 0.;
+  for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+    shift = 0.;
+    count = a_clusters->m_counts[c_id];
+    for (size_t i = 0; i < n_rows; ++i) {
+      old_coord = (*a_centroids)(i, c_id);
+      new_coord = count == 0 ? 0 : static_cast<eT>(
+          a_clusters->m_sums(i, c_id) / count);
+      shift += (new_coord - old_coord) * (new_coord - old_coord);
+      (*a_centroids)(i, c_id) = new_coord;
+    }
+    max_shift = std::max(max_shift, sqrt(shift));
+  }
+  return max_shift;
 }
 
 /**
  * Perform a single iteration of the nearest centroids algorithm
  *
- * @param a_new_centroids - container for storing new centroid coordinates
- * @param a_old_centroids - container storing previously computed centroids
- * @param a_pol2vecids - previously populated clusters
+ * @param a_centroids - current centroids (updated in place)
+ * @param a_clusters - previously populated clusters
  * @param a_nwe - matrix containing neural word embeddings of single terms
+ * @param a_shift - pointer to a variable in which the maximum shift of
+ *                  the centroids should be stored
  *
- * @return \c true if clusters changes, \c false otherwise
- */
-static inline bool _nc_run(arma::mat *a_new_centroids,
-                           arma::mat *a_old_centroids,
-                           pi2v_t *a_polid2vecids,
-                           v2pi_t *a_vecid2polid,
-                           const arma::mat *a_nwe) {
-  bool ret = false;
-  // calculate centroids
-  if ((ret = _nc_compute_centroids(a_new_centroids,
-                                   a_old_centroids,
-                                   a_polid2vecids, a_nwe)))
-    // assign new items to their new nearest centroids (can return
-    // `ret =` here, but then remove assert from )
-    _nc_assign(a_polid2vecids, a_vecid2polid, a_new_centroids, a_nwe);
-
-  return ret;
+ * @return number of vectors which changed their clusters
+ */
+template <typename eT>
+static inline vid_t _nc_run(arma::Mat<eT> *a_centroids,
+                            nc_clusters_t *a_clusters,
+                            const NWEView<eT> *a_nwe,
+                            dist_t *a_shift) {
+  // assign vectors to their nearest centroids
+  const vid_t n_moved = _nc_assign(a_clusters, a_centroids, a_nwe);
+  // move centroids
+  *a_shift = n_moved ? _nc_update_centroids(a_centroids, a_clusters) : 0.;
+  return n_moved;
 }
 
 /**
@@ -349,159 +514,413 @@ static inline bool _nc_run(arma::mat *a_new_centroids,
  *
  * @return id of the cluster with the nearest centroid
  */
-static void _nc_expand(v2ps_t *a_vecid2pol, const arma::mat *const a_centroids,
-                       const arma::mat *a_nwe, const int a_N) {
+template <typename eT>
+static void _nc_expand(v2ps_t *a_vecid2pol,
+                       const arma::Mat<eT> *const a_centroids,
+                       const NWEView<eT> *a_nwe, const int a_N) {
   // vector of word vector ids, their respective polarities (aka
   // nearest centroids), and distances to the nearest centroids
-  vpd_v_t vpds;
-  vpds.reserve(a_vecid2pol->size());
-
-  dist_t idist;
-  size_t pol_idx;
-  pol_t pol_i;
-  int j = 0;
-  v2ps_t::const_iterator v2p_end = a_vecid2pol->end();
-  // populate
-  for (vid_t i = 0; i < a_nwe->n_cols; ++i) {
-    if (a_vecid2pol->find(i) != v2p_end)
-      continue;
-
-    // obtain polarity class and minimum distance to the nearest
-    // centroid
-    pol_idx = _nc_find_cluster(a_centroids, a_nwe->colptr(i), &idist);
-    pol_i = IDX2POLID[pol_idx];
-
-    // by default, all polarities are shifted by one
-    if (pol_i == NEUTRAL)
-      continue;
-
-    // add new element to the vector
-    vpds.push_back(VPD {i, pol_i, idist});
-    ++j;
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
+
+  PhaseTimer timer("nc_assign");
+  const vid_t n_cols = a_nwe->n_cols;
+  std::vector<bool> is_known(n_cols, false);
+  for (auto& v2p : *a_vecid2pol)
+    is_known[v2p.first] = true;
+
+#pragma omp parallel
+  {
+    dist_t idist;
+    size_t pol_idx;
+    pol_t pol_i;
+    std::vector<eT> buf(a_nwe->n_rows);
+    top_n_t *itop = &thread_tops[_thread_id()];
+    // populate
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n_cols; ++i) {
+      if (is_known[i])
+        continue;
+
+      // obtain polarity class and minimum distance to the nearest
+      // centroid
+      pol_idx = _nc_find_cluster(a_centroids, a_nwe->col(i, buf.data()),
+                                 &idist);
+      pol_i = IDX2POLID[pol_idx];
+
+      // by default, all polarities are shifted by one
+      if (pol_i == NEUTRAL)
+        continue;
+
+      // add new element to the thread-local vector
+      itop->push(VPD {i, pol_i, idist});
+    }
   }
-  _add_terms(a_vecid2pol, &vpds, j, a_N);
+  timer.stop();
+  _add_terms(a_vecid2pol, &thread_tops);
 }
 
+template <typename eT>
 void expand_nearest_centroids(v2ps_t *a_vecid2pol,
-                              const arma::mat *a_nwe,
+                              const NWEView<eT> *a_nwe,
                               const int a_N,
-                              const bool a_early_break) {
-  // create two matrices for storing centroids
-  arma::mat *centroids = new arma::mat(a_nwe->n_rows, N_POLARITIES);
-  arma::mat *new_centroids = new arma::mat(a_nwe->n_rows, N_POLARITIES);
-
-  // populate intial clusters
-  pol_t polid;
-  size_t pol_idx;
-  pi2v_t pol_idx2vecids;
-  pol_idx2vecids.reserve(N_POLARITIES);
-  v2pi_t vecid2pol_idx;
-  vecid2pol_idx.reserve(a_nwe->n_cols);
-
-  for (auto &v2p : *a_vecid2pol) {
-    polid = static_cast<pol_t>(v2p.second.first);
-    pol_idx = POLID2IDX[polid];
-
-    pol_idx2vecids[pol_idx].insert(v2p.first);
-    vecid2pol_idx[v2p.first] = pol_idx;
-  }
-  int i = 0;
-  // run the algorithm until convergence
-  while (_nc_run(centroids, new_centroids,
-                 &pol_idx2vecids, &vecid2pol_idx, a_nwe)) {
-    std::cerr << "Run #" << i++ << '\r';
-    // early break
-    if (a_early_break) {
-      *centroids = *new_centroids;
+                              const bool a_early_break,
+                              const double a_tolerance) {
+  PhaseTimer timer("nc_iterations");
+  // populate intial clusters and compute their centroids
+  nc_clusters_t clusters;
+  clusters.m_labels.assign(a_nwe->n_cols, NC_NO_LABEL);
+  for (auto &v2p : *a_vecid2pol)
+    clusters.m_labels[v2p.first] = static_cast<uint8_t>(
+        POLID2IDX[static_cast<pol_t>(v2p.second.first)]);
+
+  arma::Mat<eT> centroids(a_nwe->n_rows, N_POLARITIES, arma::fill::zeros);
+  _nc_compute_sums(&clusters, a_nwe);
+  _nc_update_centroids(&centroids, &clusters);
+
+  // run the algorithm until convergence (or only assign words to the
+  // centroids of the seed sets in case of an early break)
+  vid_t n_moved;
+  dist_t shift;
+  const vid_t max_moved = a_tolerance * a_nwe->n_cols;
+  for (int i = 0; !a_early_break; ++i) {
+    n_moved = _nc_run(&centroids, &clusters, a_nwe, &shift);
+    std::cerr << "Run #" << i << ": " << n_moved
+              << " vectors moved, maximum centroid shift "
+              << shift << std::endl;
+    if (n_moved <= max_moved || shift <= a_tolerance)
       break;
-    }
-    // swap the centroids
-    std::swap(centroids, new_centroids);
   }
-  std::cerr << std::endl;
+
+  timer.stop();
 
   // add new terms to the polarity sets based on their distance to the
-  // centroids (centroids and new centroids should contain identical
-  // values here)
-  assert(_cmp_mat(centroids, new_centroids));
-  _nc_expand(a_vecid2pol, new_centroids, a_nwe, a_N);
+  // centroids
+  _nc_expand(a_vecid2pol, &centroids, a_nwe, a_N);
+}
 
-  delete new_centroids;
-  delete centroids;
+/**
+ * Copy vectors of known polarity into a dense contiguous matrix
+ *
+ * If an inverted-file index is given, the seeds are grouped by their
+ * nearest cells, so that the inverted list of cell `c` occupies the
+ * columns `[a_offsets[c], a_offsets[c + 1])` of `a_seeds`.
+ *
+ * @param a_seeds - matrix for storing seed vectors (one per column)
+ * @param a_seed_norms - squared lengths of the seed vectors
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_is_seed - dense flags marking seed columns of `a_nwe`
+ * @param a_vecid2pol - map of vector id's with known polarities
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_index - inverted-file index over `a_nwe` (can be \c nullptr)
+ * @param a_offsets - offsets of the inverted lists (only populated if
+ *                    `a_index` is given)
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _knn_gather_seeds(arma::Mat<eT> *a_seeds,
+                              std::vector<dist_t> *a_seed_norms,
+                              std::vector<pol_t> *a_seed_pols,
+                              std::vector<bool> *a_is_seed,
+                              const v2ps_t *a_vecid2pol,
+                              const NWEView<eT> *a_nwe,
+                              const ivf_index_t *a_index = nullptr,
+                              std::vector<size_t> *a_offsets = nullptr) {
+  const size_t n_rows = a_nwe->n_rows;
+  const size_t n_seeds = a_vecid2pol->size();
+  a_seeds->set_size(n_rows, n_seeds);
+  a_seed_norms->resize(n_seeds);
+  a_seed_pols->resize(n_seeds);
+  a_is_seed->assign(a_nwe->n_cols, false);
+
+  // count seeds in each cell and reserve consecutive columns for them
+  std::vector<size_t> next;
+  if (a_index != nullptr) {
+    const size_t n_lists = a_index->m_centroids.n_cols;
+    a_offsets->assign(n_lists + 1, 0);
+    for (auto& v2p : *a_vecid2pol)
+      ++(*a_offsets)[a_index->m_cells[v2p.first * a_index->m_n_probes] + 1];
+    for (size_t c = 0; c < n_lists; ++c)
+      (*a_offsets)[c + 1] += (*a_offsets)[c];
+    next.assign(a_offsets->begin(), a_offsets->end() - 1);
+  }
+
+  size_t i = 0;
+  const eT *iseed;
+  for (auto& v2p : *a_vecid2pol) {
+    if (a_index != nullptr)
+      i = next[a_index->m_cells[v2p.first * a_index->m_n_probes]]++;
+
+    a_nwe->normalize(v2p.first, 1, a_seeds->colptr(i));
+    iseed = a_seeds->colptr(i);
+    (*a_seed_norms)[i] = dot_product(iseed, iseed, n_rows);
+    (*a_seed_pols)[i] = POLID2IDX[v2p.second.first];
+    (*a_is_seed)[v2p.first] = true;
+    ++i;
+  }
 }
 
 /**
- * Find K known neighbors nearest to the vector `a_vid`
+ * Offer a seed to a bounded max-heap of K nearest neighbors
+ *
+ * @param a_heap - K-element heap
+ * @param a_heap_size - actual number of elements in the heap
+ * @param a_K - number of nearest neighbors to keep
+ * @param a_vpd - seed index, polarity index, and distance of the seed
  *
- * @param a_vid - id of the vector whose neighbors should be found
+ * @return \c void
+ */
+static inline void _knn_push(vpd_t *a_heap, size_t *a_heap_size,
+                             const size_t a_K, const VPD &a_vpd) {
+  if (*a_heap_size < a_K) {
+    a_heap[(*a_heap_size)++] = a_vpd;
+    std::push_heap(a_heap, a_heap + *a_heap_size);
+  } else if (a_vpd.m_distance < a_heap[0].m_distance) {
+    std::pop_heap(a_heap, a_heap + a_K);
+    a_heap[a_K - 1] = a_vpd;
+    std::push_heap(a_heap, a_heap + a_K);
+  }
+}
+
+/**
+ * Find K known neighbors nearest to a block of consecutive vectors
+ *
+ * Distances are computed tile-wise as \f$\|a\|^2 + \|b\|^2 - 2a\cdot
+ * b\f$, where the dot products of a tile of seed vectors with the
+ * whole block of candidates are obtained with a single matrix
+ * product.  Each resulting column is then fed into a bounded max-heap
+ * that keeps K nearest seeds of the respective candidate.
+ *
+ * @param a_heaps - storage for K-element heaps (one per block column)
+ * @param a_heap_sizes - actual number of elements in each heap
+ * @param a_start - id of the first vector in the block
+ * @param a_n - number of vectors in the block
  * @param a_nwe - matrix of neural word embeddings
- * @param a_vecid2pol - map of vector id's with known polarities
- * @param a_knn - vector for storing K earest neighbors
+ * @param a_buf - buffer for `a_n` normalized vectors
+ * @param a_seeds - dense matrix of seed vectors
+ * @param a_seed_norms - squared lengths of the seed vectors
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_is_seed - dense flags marking seed columns of `a_nwe`
  * @param a_K - number of nearest neighbors to use
  *
  * @return \c void
  */
-static void _knn_find_nearest(vid_t a_vid,
-                              const arma::mat *a_nwe,
-                              const v2ps_t * const a_vecid2pol,
-                              vpd_pq_t *a_knn, const int a_K) {
-  int added = 0;
-  bool filled = false;
+template <typename eT>
+static void _knn_find_nearest(vpd_v_t *a_heaps,
+                              std::vector<size_t> *a_heap_sizes,
+                              const vid_t a_start, const size_t a_n,
+                              const NWEView<eT> *a_nwe, eT *a_buf,
+                              const arma::Mat<eT> *a_seeds,
+                              const std::vector<dist_t> *a_seed_norms,
+                              const std::vector<pol_t> *a_seed_pols,
+                              const std::vector<bool> *a_is_seed,
+                              const size_t a_K) {
+  const size_t n_rows = a_nwe->n_rows;
+  const size_t n_seeds = a_seeds->n_cols;
+  // wrap the block of candidates without copying it (unless it has to
+  // be normalized)
+  const arma::Mat<eT> cands(
+      const_cast<eT *>(a_nwe->cols(a_start, a_n, a_buf)),
+      n_rows, a_n, false, true);
+  std::vector<dist_t> cand_norms(a_n);
+  const eT *icand;
+  for (size_t j = 0; j < a_n; ++j) {
+    icand = cands.colptr(j);
+    cand_norms[j] = dot_product(icand, icand, n_rows);
+  }
 
-  // reset KNN vector
-  while (!a_knn->empty()) {
-    a_knn->pop();
+  a_heap_sizes->assign(a_n, 0);
+
+  arma::Mat<eT> dots;
+  const eT *idots;
+  vpd_t *iheap;
+  size_t *iheap_size;
+  size_t seed_end, n_tile;
+  dist_t idistance;
+  for (size_t seed_start = 0; seed_start < n_seeds;
+       seed_start += KNN_SEED_BLOCK) {
+    seed_end = std::min(seed_start + KNN_SEED_BLOCK, n_seeds);
+    n_tile = seed_end - seed_start;
+    const arma::Mat<eT> seed_tile(
+        const_cast<eT *>(a_seeds->colptr(seed_start)),
+        n_rows, n_tile, false, true);
+    // (n_tile x a_n) matrix of dot products
+    dots = seed_tile.t() * cands;
+
+    for (size_t j = 0; j < a_n; ++j) {
+      if ((*a_is_seed)[a_start + j])
+        continue;
+
+      idots = dots.colptr(j);
+      iheap = &(*a_heaps)[j * a_K];
+      iheap_size = &(*a_heap_sizes)[j];
+      for (size_t i = 0; i < n_tile; ++i) {
+        idistance = (*a_seed_norms)[seed_start + i] + cand_norms[j]
+            - 2. * idots[i];
+        // guard against negative values caused by rounding errors
+        if (idistance < 0.)
+          idistance = 0.;
+
+        _knn_push(iheap, iheap_size, a_K,
+                  VPD {seed_start + i, (*a_seed_pols)[seed_start + i],
+                       idistance});
+      }
+    }
   }
+}
 
-  const dist_t *ivec = a_nwe->colptr(a_vid);
+/**
+ * Find approximate K nearest known neighbors of consecutive vectors
+ *
+ * In contrast to `_knn_find_nearest()`, only the seeds lying in the
+ * `a_n_probes` cells nearest to each candidate are considered.  The
+ * distances and the contents of the heaps are defined in the same way.
+ *
+ * @param a_heaps - storage for K-element heaps (one per block column)
+ * @param a_heap_sizes - actual number of elements in each heap
+ * @param a_start - id of the first vector in the block
+ * @param a_n - number of vectors in the block
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_buf - buffer for a normalized vector
+ * @param a_seeds - dense matrix of seed vectors grouped by cells
+ * @param a_seed_norms - squared lengths of the seed vectors
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_is_seed - dense flags marking seed columns of `a_nwe`
+ * @param a_K - number of nearest neighbors to use
+ * @param a_index - inverted-file index over `a_nwe`
+ * @param a_offsets - offsets of the inverted lists in `a_seeds`
+ * @param a_n_probes - number of cells to probe
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _knn_find_nearest_ivf(vpd_v_t *a_heaps,
+                                  std::vector<size_t> *a_heap_sizes,
+                                  const vid_t a_start, const size_t a_n,
+                                  const NWEView<eT> *a_nwe, eT *a_buf,
+                                  const arma::Mat<eT> *a_seeds,
+                                  const std::vector<dist_t> *a_seed_norms,
+                                  const std::vector<pol_t> *a_seed_pols,
+                                  const std::vector<bool> *a_is_seed,
+                                  const size_t a_K,
+                                  const ivf_index_t *a_index,
+                                  const std::vector<size_t> *a_offsets,
+                                  const size_t a_n_probes) {
   const size_t n_rows = a_nwe->n_rows;
-  dist_t idistance, mindistance = std::numeric_limits<dist_t>::max();
-  // iterate over each known vector and find K nearest ones
-  for (auto& v2p : *a_vecid2pol) {
-    // compute distance between
-    idistance = _unnorm_eucl_distance(ivec, a_nwe->colptr(v2p.first), n_rows);
-
-    if (idistance >= mindistance && filled)
+  a_heap_sizes->assign(a_n, 0);
+
+  const eT *icand;
+  const uint32_t *icells;
+  vpd_t *iheap;
+  size_t *iheap_size;
+  size_t seed_end;
+  dist_t cand_norm, idistance;
+  for (size_t j = 0; j < a_n; ++j) {
+    if ((*a_is_seed)[a_start + j])
       continue;
 
-    // check if container is full and pop one element if necessary
-    if (filled)
-      a_knn->pop();
-    else
-      filled = (++added == a_K);
+    icand = a_nwe->col(a_start + j, a_buf);
+    cand_norm = dot_product(icand, icand, n_rows);
+    icells = &a_index->m_cells[(a_start + j) * a_index->m_n_probes];
+    iheap = &(*a_heaps)[j * a_K];
+    iheap_size = &(*a_heap_sizes)[j];
+    for (size_t p = 0; p < a_n_probes; ++p) {
+      seed_end = (*a_offsets)[icells[p] + 1];
+      for (size_t i = (*a_offsets)[icells[p]]; i < seed_end; ++i) {
+        idistance = (*a_seed_norms)[i] + cand_norm
+            - 2. * dot_product(a_seeds->colptr(i), icand, n_rows);
+        if (idistance < 0.)
+          idistance = 0.;
+
+        _knn_push(iheap, iheap_size, a_K,
+                  VPD {i, (*a_seed_pols)[i], idistance});
+      }
+    }
+  }
+}
 
-    a_knn->push(VPD {v2p.first, POLID2IDX[v2p.second.first], idistance});
-    mindistance = a_knn->top().m_distance;
+/**
+ * Count exact nearest neighbors found by the approximate search
+ *
+ * @param a_n_hits - number of exact neighbors found (incremented)
+ * @param a_n_relevant - number of exact neighbors (incremented)
+ * @param a_heaps - heaps of the approximate search
+ * @param a_heap_sizes - sizes of the heaps of the approximate search
+ * @param a_exact_heaps - heaps of the exact search
+ * @param a_exact_sizes - sizes of the heaps of the exact search
+ * @param a_start - id of the first vector in the block
+ * @param a_n - number of vectors in the block
+ * @param a_is_seed - dense flags marking seed columns
+ * @param a_K - number of nearest neighbors
+ *
+ * @return \c void
+ */
+static void _knn_count_hits(size_t *a_n_hits, size_t *a_n_relevant,
+                            const vpd_v_t *a_heaps,
+                            const std::vector<size_t> *a_heap_sizes,
+                            const vpd_v_t *a_exact_heaps,
+                            const std::vector<size_t> *a_exact_sizes,
+                            const vid_t a_start, const size_t a_n,
+                            const std::vector<bool> *a_is_seed,
+                            const size_t a_K) {
+  const vpd_t *iheap, *iexact;
+  for (size_t j = 0; j < a_n; ++j) {
+    if ((*a_is_seed)[a_start + j])
+      continue;
+
+    iheap = &(*a_heaps)[j * a_K];
+    iexact = &(*a_exact_heaps)[j * a_K];
+    *a_n_relevant += (*a_exact_sizes)[j];
+    for (size_t e = 0; e < (*a_exact_sizes)[j]; ++e) {
+      for (size_t h = 0; h < (*a_heap_sizes)[j]; ++h) {
+        if (iheap[h].m_vecid == iexact[e].m_vecid) {
+          ++*a_n_hits;
+          break;
+        }
+      }
+    }
   }
 }
 
 /**
- * Compute most probable polarity class from K neighbors.
+ * Reset per-class votes of nearest neighbors
  *
- * @param a_vpd - element in which to store the result
- * @param a_vid - id of the vector in question
- * @param a_knn - priority queue of K nearest neighbors
  * @param a_workbench - workbench for constructing polarities
  *
  * @return \c void
  */
-static void _knn_add(vpd_t *a_vpd, const vid_t a_vid,
-                     vpd_pq_t *a_knn, vpd_v_t *a_workbench) {
-  // reset the workbench
+static inline void _knn_reset(vpd_v_t *a_workbench) {
   for (auto& vpd : *a_workbench) {
     vpd.m_vecid = 0;        // will serve as neighbor counter
     vpd.m_distance = 0.;    // will store the sum of the distances
   }
+}
 
-  const vpd_t *vpd;
-  // iterate over neighbors
-  while (!a_knn->empty()) {
-    vpd = &a_knn->top();
-    ++(*a_workbench)[vpd->m_polarity].m_vecid;
-    (*a_workbench)[vpd->m_polarity].m_distance += vpd->m_distance;
-    a_knn->pop();
-  }
+/**
+ * Add the vote of a neighbor to the votes of its class
+ *
+ * @param a_workbench - workbench for constructing polarities
+ * @param a_vpd - seed index, polarity index, and distance of the
+ *                neighbor
+ *
+ * @return \c void
+ */
+static inline void _knn_vote(vpd_v_t *a_workbench, const vpd_t &a_vpd) {
+  ++(*a_workbench)[a_vpd.m_polarity].m_vecid;
+  (*a_workbench)[a_vpd.m_polarity].m_distance += a_vpd.m_distance;
+}
 
+/**
+ * Compute most probable polarity class from the collected votes.
+ *
+ * @param a_vpd - element in which to store the result
+ * @param a_vid - id of the vector in question
+ * @param a_workbench - votes of the neighbors
+ *
+ * @return \c void
+ */
+static void _knn_score(vpd_t *a_vpd, const vid_t a_vid,
+                       const vpd_v_t *a_workbench) {
   pol_t pol = 0;
   dist_t idistance, mindistance = std::numeric_limits<dist_t>::max();
   for (pol_t ipol = 0; ipol < N_POLARITIES; ++ipol) {
@@ -522,29 +941,873 @@ static void _knn_add(vpd_t *a_vpd, const vid_t a_vid,
   *a_vpd = VPD {a_vid, pol, mindistance};
 }
 
+/**
+ * Compute most probable polarity class from K neighbors.
+ *
+ * @param a_vpd - element in which to store the result
+ * @param a_vid - id of the vector in question
+ * @param a_knn - array of K nearest neighbors
+ * @param a_n_knn - number of elements in `a_knn`
+ * @param a_workbench - workbench for constructing polarities
+ *
+ * @return \c void
+ */
+static void _knn_add(vpd_t *a_vpd, const vid_t a_vid,
+                     const vpd_t *a_knn, const size_t a_n_knn,
+                     vpd_v_t *a_workbench) {
+  _knn_reset(a_workbench);
+  // iterate over neighbors
+  for (size_t i = 0; i < a_n_knn; ++i)
+    _knn_vote(a_workbench, a_knn[i]);
+
+  _knn_score(a_vpd, a_vid, a_workbench);
+}
+
+template <typename eT>
 void expand_knn(v2ps_t *a_vecid2pol,
-                const arma::mat *a_nwe,
-                const int a_N, const int a_K) {
-  vpd_v_t vpds;
-  vpds.reserve(a_nwe->n_cols);
-  vpd_v_t _knn(a_K);
-  vpd_pq_t knn(_knn.begin(), _knn.end());
-  vpd_v_t workbench(N_POLARITIES);
-
-  vpd_t ivpd;
-  size_t i = 0;
-  v2ps_t::const_iterator v2p_end = a_vecid2pol->end();
+                const NWEView<eT> *a_nwe,
+                const int a_N, const int a_K,
+                const ivf_index_t *a_index, const int a_n_probes) {
+  std::vector<v2ps_t> vecid2pols(1);
+  vecid2pols[0].swap(*a_vecid2pol);
+  const std::vector<int> Ks {a_K};
+  expand_knn_multi(&vecid2pols, a_nwe, a_N, &Ks, a_index, a_n_probes);
+  a_vecid2pol->swap(vecid2pols[0]);
+}
 
-  // iterate over each word vector and find k-nearest neigbors for it
-  for (vid_t vid = 0; vid < a_nwe->n_cols; ++vid) {
-    // skip vector if its polarity is already known
-    if (a_vecid2pol->find(vid) != v2p_end)
+template <typename eT>
+void expand_knn_multi(std::vector<v2ps_t> *a_vecid2pols,
+                      const NWEView<eT> *a_nwe, const int a_N,
+                      const std::vector<int> *a_Ks,
+                      const ivf_index_t *a_index, const int a_n_probes) {
+  const size_t n_Ks = a_Ks->size();
+  if (n_Ks == 0)
+    return;
+  if (a_vecid2pols->size() != n_Ks)
+    throw std::invalid_argument("Number of seed sets does not match the"
+                                " number of K values.");
+
+  // neighbors are searched for the largest K, and the scores of the
+  // smaller values are computed in ascending order of K
+  size_t K = 1;
+  for (int k : *a_Ks)
+    K = std::max<size_t>(K, k);
+  std::vector<size_t> k_order(n_Ks);
+  for (size_t k = 0; k < n_Ks; ++k)
+    k_order[k] = k;
+  std::stable_sort(k_order.begin(), k_order.end(),
+                   [a_Ks](const size_t a_k1, const size_t a_k2) {
+                     return (*a_Ks)[a_k1] < (*a_Ks)[a_k2];});
+
+  PhaseTimer timer("knn_search");
+  std::vector<std::vector<top_n_t>> thread_tops(
+      n_Ks, std::vector<top_n_t>(_n_threads(), top_n_t(a_N)));
+
+  const vid_t n_cols = a_nwe->n_cols;
+  const vid_t n_blocks = (n_cols + KNN_CAND_BLOCK - 1) / KNN_CAND_BLOCK;
+  size_t n_probes = 0;
+  if (a_index != nullptr) {
+    if (a_index->m_cells.size() != n_cols * a_index->m_n_probes)
+      throw std::invalid_argument("IVF index does not match the word"
+                                  " embeddings.");
+
+    n_probes = a_index->m_n_probes;
+    if (a_n_probes > 0)
+      n_probes = std::min<size_t>(a_n_probes, n_probes);
+  }
+
+  // copy known vectors into a dense matrix
+  arma::Mat<eT> seeds;
+  std::vector<dist_t> seed_norms;
+  std::vector<pol_t> seed_pols;
+  std::vector<bool> is_seed;
+  std::vector<size_t> offsets;
+  _knn_gather_seeds(&seeds, &seed_norms, &seed_pols, &is_seed,
+                    &a_vecid2pols->front(), a_nwe, a_index, &offsets);
+
+  // the recall of the approximate search is estimated on evenly spaced
+  // blocks of candidates
+  const vid_t recall_stride = std::max<vid_t>(1,
+                                              n_blocks / KNN_RECALL_BLOCKS);
+  size_t n_hits = 0, n_relevant = 0;
+
+#pragma omp parallel reduction(+: n_hits, n_relevant)
+  {
+    vpd_v_t heaps(KNN_CAND_BLOCK * K);
+    std::vector<size_t> heap_sizes(KNN_CAND_BLOCK);
+    vpd_v_t exact_heaps;
+    std::vector<size_t> exact_sizes;
+    vpd_v_t workbench(N_POLARITIES);
+    std::vector<eT> buf(a_nwe->is_lazy()?
+                        a_nwe->n_rows * KNN_CAND_BLOCK: 0);
+    const int tid = _thread_id();
+
+    vpd_t ivpd, *iheap;
+    vid_t start;
+    size_t n, n_knn, o;
+    // find k-nearest neigbors for each block of word vectors
+#pragma omp for schedule(static)
+    for (vid_t b = 0; b < n_blocks; ++b) {
+      start = b * KNN_CAND_BLOCK;
+      n = std::min(static_cast<vid_t>(KNN_CAND_BLOCK), n_cols - start);
+      if (a_index == nullptr) {
+        _knn_find_nearest(&heaps, &heap_sizes, start, n, a_nwe,
+                          buf.data(), &seeds, &seed_norms, &seed_pols,
+                          &is_seed, K);
+      } else {
+        _knn_find_nearest_ivf(&heaps, &heap_sizes, start, n, a_nwe,
+                              buf.data(), &seeds, &seed_norms,
+                              &seed_pols, &is_seed, K, a_index, &offsets,
+                              n_probes);
+        if (b % recall_stride == 0) {
+          exact_heaps.resize(KNN_CAND_BLOCK * K);
+          _knn_find_nearest(&exact_heaps, &exact_sizes, start, n, a_nwe,
+                            buf.data(), &seeds, &seed_norms, &seed_pols,
+                            &is_seed, K);
+          _knn_count_hits(&n_hits, &n_relevant, &heaps, &heap_sizes,
+                          &exact_heaps, &exact_sizes, start, n,
+                          &is_seed, K);
+        }
+      }
+
+      for (size_t j = 0; j < n; ++j) {
+        // skip vector if its polarity is already known or no known
+        // neighbor lies in the probed cells
+        if (is_seed[start + j] || heap_sizes[j] == 0)
+          continue;
+
+        // order the neighbors by distance, so that the votes of the
+        // nearest k of them are prefix sums for every k
+        iheap = &heaps[j * K];
+        n_knn = heap_sizes[j];
+        std::sort_heap(iheap, iheap + n_knn);
+        _knn_reset(&workbench);
+        o = 0;
+        for (size_t i = 0; i < n_knn && o < n_Ks; ++i) {
+          _knn_vote(&workbench, iheap[i]);
+          if (static_cast<size_t>((*a_Ks)[k_order[o]]) > i + 1
+              && i + 1 < n_knn)
+            continue;
+
+          // score all values of k reached with i + 1 neighbors
+          _knn_score(&ivpd, start + j, &workbench);
+          for (; o < n_Ks && (static_cast<size_t>((*a_Ks)[k_order[o]])
+                              <= i + 1 || i + 1 == n_knn); ++o)
+            thread_tops[k_order[o]][tid].push(ivpd);
+        }
+      }
+    }
+  }
+  if (a_index != nullptr && n_relevant > 0)
+    std::cerr << "Recall of approximate " << K << "-NN search: "
+              << static_cast<double>(n_hits) / n_relevant << " ("
+              << n_probes << " of " << a_index->m_centroids.n_cols
+              << " cells probed)" << std::endl;
+  timer.stop();
+
+  for (size_t k = 0; k < n_Ks; ++k)
+    _add_terms(&(*a_vecid2pols)[k], &thread_tops[k]);
+}
+
+/**
+ * Compute code histograms of the clusters from scratch
+ *
+ * @param a_clusters - cluster assignments whose histograms should be
+ *                     computed
+ * @param a_pq - product-quantized word vectors
+ *
+ * @return \c void
+ */
+static void _nc_pq_compute_hists(nc_pq_clusters_t *a_clusters,
+                                 const pq_store_t *a_pq) {
+  const size_t n_subspaces = a_pq->m_n_subspaces;
+  const size_t hist_size = n_subspaces * PQ_N_CODES;
+  a_clusters->m_hists.assign(N_POLARITIES * hist_size, 0);
+  a_clusters->m_counts.assign(N_POLARITIES, 0);
+
+  uint8_t label;
+  const uint8_t *codes;
+  long long *ihist;
+  for (vid_t vecid = 0; vecid < a_pq->m_n_cols; ++vecid) {
+    if ((label = a_clusters->m_labels[vecid]) == NC_NO_LABEL)
       continue;
 
-    _knn_find_nearest(vid, a_nwe, a_vecid2pol, &knn, a_K);
-    _knn_add(&vpds[i++], vid, &knn, &workbench);
+    codes = &a_pq->m_codes[vecid * n_subspaces];
+    ihist = &a_clusters->m_hists[label * hist_size];
+    for (size_t m = 0; m < n_subspaces; ++m, ihist += PQ_N_CODES)
+      ++ihist[codes[m]];
+    ++a_clusters->m_counts[label];
+  }
+}
+
+/**
+ * Compute centroids from the code histograms of the clusters
+ *
+ * @param a_centroids - centroids to update
+ * @param a_tables - distance tables of the centroids to update
+ * @param a_clusters - clusters whose centroids should be computed
+ * @param a_pq - product-quantized word vectors
+ *
+ * @return maximum Euclidean distance between old and new centroids
+ */
+static dist_t _nc_pq_update_centroids(arma::mat *a_centroids,
+                                      std::vector<float> *a_tables,
+                                      const nc_pq_clusters_t *a_clusters,
+                                      const pq_store_t *a_pq) {
+  const size_t n_rows = a_pq->m_n_rows;
+  const size_t n_subspaces = a_pq->m_n_subspaces;
+  const size_t hist_size = n_subspaces * PQ_N_CODES;
+  std::vector<double> centroid(n_rows);
+  const long long *ihist;
+  const float *icodeword;
+  long long count;
+  dist_t shift, max_shift = 0.;
+  for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+    // sum up the codewords weighted by their frequencies
+    std::fill(centroid.begin(), centroid.end(), 0.);
+    ihist = &a_clusters->m_hists[c_id * hist_size];
+    for (size_t m = 0; m < n_subspaces; ++m, ihist += PQ_N_CODES) {
+      for (size_t k = 0; k < PQ_N_CODES; ++k) {
+        if (ihist[k] == 0)
+          continue;
+
+        icodeword = a_pq->m_codebooks.colptr(k);
+        for (size_t r = a_pq->m_offsets[m]; r < a_pq->m_offsets[m + 1]; ++r)
+          centroid[r] += ihist[k] * static_cast<double>(icodeword[r]);
+      }
+    }
+
+    shift = 0.;
+    count = a_clusters->m_counts[c_id];
+    for (size_t i = 0; i < n_rows; ++i) {
+      if (count != 0)
+        centroid[i] /= count;
+      shift += (centroid[i] - (*a_centroids)(i, c_id))
+          * (centroid[i] - (*a_centroids)(i, c_id));
+      (*a_centroids)(i, c_id) = centroid[i];
+    }
+    max_shift = std::max(max_shift, sqrt(shift));
+    pq_adc_table(a_pq, a_centroids->colptr(c_id),
+                 &(*a_tables)[c_id * hist_size]);
   }
-  _add_terms(a_vecid2pol, &vpds, i, a_N);
+  return max_shift;
+}
+
+/**
+ * Find cluster whose centroid is nearest to a product-quantized vector
+ *
+ * @param a_tables - distance tables of the centroids
+ * @param a_pq - product-quantized word vectors
+ * @param a_vecid - id of the vector whose nearest cluster should be found
+ * @param a_dist - (optional) pointer to a variable in which actual
+ *                  Euclidean distance to the vector should be stored
+ *
+ * @return id of the cluster with the nearest centroid
+ */
+static pol_t _nc_pq_find_cluster(const std::vector<float> *a_tables,
+                                 const pq_store_t *a_pq,
+                                 const vid_t a_vecid,
+                                 dist_t *a_dist = nullptr) {
+  const size_t hist_size = a_pq->m_n_subspaces * PQ_N_CODES;
+  pol_t ret = 0;
+  dist_t idistance = 1., mindistance = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < N_POLARITIES; ++i) {
+    idistance = pq_adc_distance(a_pq, &(*a_tables)[i * hist_size],
+                                a_vecid);
+    if (idistance < mindistance) {
+      mindistance = idistance;
+      ret = i;
+    }
+  }
+  if (a_dist != nullptr)
+    *a_dist = sqrt(mindistance);
+
+  return ret;
+}
+
+/**
+ * Assign product-quantized vectors to their nearest centroids and
+ * update code histograms for the vectors whose assignment changed
+ *
+ * Since histograms are integral, thread-local changes can be merged
+ * in any order without affecting the result.
+ *
+ * @param a_clusters - cluster assignments to update
+ * @param a_tables - distance tables of the current centroids
+ * @param a_pq - product-quantized word vectors
+ *
+ * @return number of vectors whose assignment changed
+ */
+static vid_t _nc_pq_assign(nc_pq_clusters_t *a_clusters,
+                           const std::vector<float> *a_tables,
+                           const pq_store_t *a_pq) {
+  const size_t n_subspaces = a_pq->m_n_subspaces;
+  const size_t hist_size = n_subspaces * PQ_N_CODES;
+  const vid_t n_cols = a_pq->m_n_cols;
+  uint8_t *labels = a_clusters->m_labels.data();
+  vid_t n_moved = 0;
+
+#pragma omp parallel reduction(+: n_moved)
+  {
+    std::vector<long long> hist_deltas;
+    std::vector<long long> count_deltas(N_POLARITIES, 0);
+    uint8_t old_label, new_label;
+    const uint8_t *codes;
+    long long *ihist;
+#pragma omp for schedule(static)
+    for (vid_t vecid = 0; vecid < n_cols; ++vecid) {
+      new_label = static_cast<uint8_t>(
+          _nc_pq_find_cluster(a_tables, a_pq, vecid));
+      if ((old_label = labels[vecid]) == new_label)
+        continue;
+
+      if (n_moved++ == 0)
+        hist_deltas.assign(N_POLARITIES * hist_size, 0);
+
+      labels[vecid] = new_label;
+      codes = &a_pq->m_codes[vecid * n_subspaces];
+      if (old_label != NC_NO_LABEL) {
+        ihist = &hist_deltas[old_label * hist_size];
+        for (size_t m = 0; m < n_subspaces; ++m, ihist += PQ_N_CODES)
+          --ihist[codes[m]];
+        --count_deltas[old_label];
+      }
+      ihist = &hist_deltas[new_label * hist_size];
+      for (size_t m = 0; m < n_subspaces; ++m, ihist += PQ_N_CODES)
+        ++ihist[codes[m]];
+      ++count_deltas[new_label];
+    }
+
+    if (n_moved > 0) {
+#pragma omp critical
+      {
+        for (size_t i = 0; i < hist_deltas.size(); ++i)
+          a_clusters->m_hists[i] += hist_deltas[i];
+        for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id)
+          a_clusters->m_counts[c_id] += count_deltas[c_id];
+      }
+    }
+  }
+  return n_moved;
+}
+
+template <typename eT>
+void expand_nearest_centroids_pq(v2ps_t *a_vecid2pol,
+                                 const pq_store_t *a_pq,
+                                 const NWEView<eT> *a_nwe,
+                                 const int a_N,
+                                 const bool a_early_break,
+                                 const double a_tolerance,
+                                 const int a_rerank) {
+  PhaseTimer timer("nc_iterations");
+  const vid_t n_cols = a_pq->m_n_cols;
+  const bool rerank = a_nwe != nullptr && a_rerank > 0;
+
+  // populate intial clusters and compute their centroids
+  nc_pq_clusters_t clusters;
+  clusters.m_labels.assign(n_cols, NC_NO_LABEL);
+  std::vector<bool> is_known(n_cols, false);
+  for (auto &v2p : *a_vecid2pol) {
+    clusters.m_labels[v2p.first] = static_cast<uint8_t>(
+        POLID2IDX[static_cast<pol_t>(v2p.second.first)]);
+    is_known[v2p.first] = true;
+  }
+
+  arma::mat centroids(a_pq->m_n_rows, N_POLARITIES, arma::fill::zeros);
+  std::vector<float> tables(N_POLARITIES * a_pq->m_n_subspaces
+                            * PQ_N_CODES);
+  _nc_pq_compute_hists(&clusters, a_pq);
+  _nc_pq_update_centroids(&centroids, &tables, &clusters, a_pq);
+
+  vid_t n_moved;
+  dist_t shift;
+  const vid_t max_moved = a_tolerance * n_cols;
+  for (int i = 0; !a_early_break; ++i) {
+    n_moved = _nc_pq_assign(&clusters, &tables, a_pq);
+    shift = n_moved ?
+        _nc_pq_update_centroids(&centroids, &tables, &clusters, a_pq): 0.;
+    std::cerr << "Run #" << i << ": " << n_moved
+              << " vectors moved, maximum centroid shift "
+              << shift << std::endl;
+    if (n_moved <= max_moved || shift <= a_tolerance)
+      break;
+  }
+
+  timer.stop();
+
+  // select candidates by their approximate distances to the centroids
+  // (a larger pool of them if the distances are to be reranked)
+  PhaseTimer assign_timer("nc_assign");
+  const int n_pool = rerank && a_N > 0 ? a_N * a_rerank: a_N;
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(n_pool));
+#pragma omp parallel
+  {
+    dist_t idist;
+    pol_t pol_i;
+    top_n_t *itop = &thread_tops[_thread_id()];
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n_cols; ++i) {
+      if (is_known[i])
+        continue;
+
+      pol_i = IDX2POLID[_nc_pq_find_cluster(&tables, a_pq, i, &idist)];
+      if (pol_i == NEUTRAL)
+        continue;
+
+      itop->push(VPD {i, pol_i, idist});
+    }
+  }
+
+  if (rerank) {
+    // recompute distances of the pooled candidates exactly
+    top_n_t *pool = &thread_tops.front();
+    for (size_t i = 1; i < thread_tops.size(); ++i)
+      pool->merge(&thread_tops[i]);
+
+    const arma::Mat<eT> exact_centroids =
+        arma::conv_to<arma::Mat<eT>>::from(centroids);
+    std::vector<top_n_t> reranked(1, top_n_t(a_N));
+    std::vector<eT> buf(a_nwe->n_rows);
+    dist_t idist;
+    pol_t pol_i;
+    for (auto &vpd : pool->m_vpds) {
+      pol_i = IDX2POLID[_nc_find_cluster(&exact_centroids,
+                                         a_nwe->col(vpd.m_vecid,
+                                                    buf.data()),
+                                         &idist)];
+      reranked.front().push(VPD {vpd.m_vecid, pol_i, idist});
+    }
+    vpd_v_t().swap(pool->m_vpds);
+    assign_timer.stop();
+    _add_terms(a_vecid2pol, &reranked);
+  } else {
+    assign_timer.stop();
+    _add_terms(a_vecid2pol, &thread_tops);
+  }
+}
+
+template <typename eT>
+void expand_knn_pq(v2ps_t *a_vecid2pol, const pq_store_t *a_pq,
+                   const NWEView<eT> *a_nwe, const int a_N,
+                   const int a_K, const int a_rerank) {
+  PhaseTimer timer("knn_search");
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
+
+  const size_t n_rows = a_pq->m_n_rows;
+  const vid_t n_cols = a_pq->m_n_cols;
+  const size_t table_size = a_pq->m_n_subspaces * PQ_N_CODES;
+  const bool rerank = a_nwe != nullptr && a_rerank > 0;
+  const size_t K = a_K;
+  // number of approximate neighbors kept for exact reranking
+  const size_t n_kept = rerank ? K * a_rerank: K;
+
+  // use known vectors as queries (they are only reconstructed from
+  // their codes if the uncompressed vectors are not available)
+  const size_t n_seeds = a_vecid2pol->size();
+  arma::mat queries(n_rows, n_seeds);
+  std::vector<vid_t> seed_ids;
+  seed_ids.reserve(n_seeds);
+  std::vector<pol_t> seed_pols;
+  seed_pols.reserve(n_seeds);
+  std::vector<bool> is_seed(n_cols, false);
+  std::vector<eT> seed_buf(n_rows);
+  const eT *iseed;
+  for (auto &v2p : *a_vecid2pol) {
+    if (a_nwe != nullptr) {
+      iseed = a_nwe->col(v2p.first, seed_buf.data());
+      for (size_t r = 0; r < n_rows; ++r)
+        queries(r, seed_ids.size()) = iseed[r];
+    } else
+      pq_decode(a_pq, v2p.first, queries.colptr(seed_ids.size()));
+
+    seed_ids.push_back(v2p.first);
+    seed_pols.push_back(POLID2IDX[v2p.second.first]);
+    is_seed[v2p.first] = true;
+  }
+
+  const vid_t n_blocks = (n_cols + PQ_CAND_BLOCK - 1) / PQ_CAND_BLOCK;
+#pragma omp parallel
+  {
+    std::vector<float> tables(PQ_SEED_TILE * table_size);
+    vpd_v_t heaps(PQ_CAND_BLOCK * n_kept);
+    std::vector<size_t> heap_sizes(PQ_CAND_BLOCK);
+    vpd_v_t workbench(N_POLARITIES);
+    std::vector<eT> seed_buf(rerank? n_rows: 0), cand_buf(seed_buf.size());
+    top_n_t *itop = &thread_tops[_thread_id()];
+
+    const eT *icand;
+    vpd_t ivpd, *iheap;
+    vid_t start;
+    size_t n, seed_end, *iheap_size;
+#pragma omp for schedule(static)
+    for (vid_t b = 0; b < n_blocks; ++b) {
+      start = b * PQ_CAND_BLOCK;
+      n = std::min(static_cast<vid_t>(PQ_CAND_BLOCK), n_cols - start);
+      heap_sizes.assign(n, 0);
+      // scan the block once for each tile of seeds, whose distance
+      // tables are kept in cache
+      for (size_t seed_start = 0; seed_start < n_seeds;
+           seed_start += PQ_SEED_TILE) {
+        seed_end = std::min(seed_start + PQ_SEED_TILE, n_seeds);
+        for (size_t i = seed_start; i < seed_end; ++i)
+          pq_adc_table(a_pq, queries.colptr(i),
+                       &tables[(i - seed_start) * table_size]);
+
+        for (size_t j = 0; j < n; ++j) {
+          if (is_seed[start + j])
+            continue;
+
+          iheap = &heaps[j * n_kept];
+          iheap_size = &heap_sizes[j];
+          for (size_t i = seed_start; i < seed_end; ++i)
+            _knn_push(iheap, iheap_size, n_kept,
+                      VPD {i, seed_pols[i],
+                           pq_adc_distance(
+                               a_pq, &tables[(i - seed_start) * table_size],
+                               start + j)});
+        }
+      }
+
+      for (size_t j = 0; j < n; ++j) {
+        if (is_seed[start + j] || heap_sizes[j] == 0)
+          continue;
+
+        iheap = &heaps[j * n_kept];
+        iheap_size = &heap_sizes[j];
+        if (rerank) {
+          // recompute distances of the kept neighbors exactly and
+          // retain the K nearest ones
+          icand = a_nwe->col(start + j, cand_buf.data());
+          for (size_t h = 0; h < *iheap_size; ++h)
+            iheap[h].m_distance = sq_l2_distance(
+                a_nwe->col(seed_ids[iheap[h].m_vecid], seed_buf.data()),
+                icand, n_rows);
+          std::sort(iheap, iheap + *iheap_size);
+          *iheap_size = std::min(*iheap_size, K);
+        }
+        _knn_add(&ivpd, start + j, iheap, *iheap_size, &workbench);
+        itop->push(ivpd);
+      }
+    }
+  }
+  timer.stop();
+  _add_terms(a_vecid2pol, &thread_tops);
+}
+
+/**
+ * Add a dequantized 8-bit integer vector to a sum
+ *
+ * @param a_sum - sum to update
+ * @param a_store - 8-bit integer word vectors
+ * @param a_vecid - id of the vector to add
+ * @param a_sign - \c 1 for adding and \c -1 for subtracting the vector
+ *
+ * @return \c void
+ */
+static inline void _i8_accumulate(double *a_sum, const i8_store_t *a_store,
+                                  const vid_t a_vecid, const double a_sign) {
+  const int8_t *codes = a_store->codes(a_vecid);
+  const double scale = a_sign * a_store->m_scales[a_vecid];
+  for (size_t i = 0; i < a_store->m_n_rows; ++i)
+    a_sum[i] += scale * codes[i];
+}
+
+/**
+ * Sum up dequantized vectors of each cluster from scratch
+ *
+ * The summation is blocked in the same way as in `_nc_compute_sums()`,
+ * so that the result does not depend on the number of threads.
+ *
+ * @param a_clusters - cluster assignments whose sums should be computed
+ * @param a_store - 8-bit integer word vectors
+ *
+ * @return \c void
+ */
+static void _nc_i8_compute_sums(nc_clusters_t *a_clusters,
+                                const i8_store_t *a_store) {
+  const size_t n_rows = a_store->m_n_rows;
+  const vid_t n_cols = a_store->m_n_cols;
+  const size_t n_blocks = (n_cols + NC_BLOCK - 1) / NC_BLOCK;
+  const uint8_t *labels = a_clusters->m_labels.data();
+  arma::mat block_sums(n_rows, N_POLARITIES * n_blocks, arma::fill::zeros);
+  std::vector<size_t> block_counts(N_POLARITIES * n_blocks, 0);
+
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_blocks; ++b) {
+    uint8_t label;
+    double *sums = block_sums.colptr(b * N_POLARITIES);
+    size_t *counts = &block_counts[b * N_POLARITIES];
+    const vid_t end = std::min<vid_t>(n_cols, (b + 1) * NC_BLOCK);
+    for (vid_t vecid = b * NC_BLOCK; vecid < end; ++vecid) {
+      if ((label = labels[vecid]) == NC_NO_LABEL)
+        continue;
+
+      _i8_accumulate(sums + label * n_rows, a_store, vecid, 1.);
+      ++counts[label];
+    }
+  }
+
+  a_clusters->m_sums.zeros(n_rows, N_POLARITIES);
+  a_clusters->m_counts.assign(N_POLARITIES, 0);
+  for (size_t b = 0; b < n_blocks; ++b) {
+    for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+      a_clusters->m_sums.col(c_id) += block_sums.col(b * N_POLARITIES + c_id);
+      a_clusters->m_counts[c_id] += block_counts[b * N_POLARITIES + c_id];
+    }
+  }
+}
+
+/**
+ * Find cluster whose quantized centroid is nearest to a stored vector
+ *
+ * @param a_centroids - quantized centroids
+ * @param a_store - 8-bit integer word vectors
+ * @param a_vecid - id of the vector whose nearest cluster should be found
+ * @param a_dist - (optional) pointer to a variable in which actual
+ *                  Euclidean distance to the vector should be stored
+ *
+ * @return id of the cluster with the nearest centroid
+ */
+static pol_t _nc_i8_find_cluster(const std::vector<i8_vec_t> *a_centroids,
+                                 const i8_store_t *a_store,
+                                 const vid_t a_vecid,
+                                 dist_t *a_dist = nullptr) {
+  pol_t ret = 0;
+  dist_t idistance = 1., mindistance = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < a_centroids->size(); ++i) {
+    idistance = i8_sq_distance(a_store, &(*a_centroids)[i], a_vecid);
+    if (idistance < mindistance) {
+      mindistance = idistance;
+      ret = i;
+    }
+  }
+  if (a_dist != nullptr)
+    *a_dist = sqrt(mindistance);
+
+  return ret;
+}
+
+/**
+ * Assign 8-bit integer vectors to their nearest centroids and update
+ * cluster sums for the vectors whose assignment changed
+ *
+ * @param a_clusters - cluster assignments to update
+ * @param a_centroids - current quantized centroids
+ * @param a_store - 8-bit integer word vectors
+ *
+ * @return number of vectors whose assignment changed
+ */
+static vid_t _nc_i8_assign(nc_clusters_t *a_clusters,
+                           const std::vector<i8_vec_t> *a_centroids,
+                           const i8_store_t *a_store) {
+  const size_t n_rows = a_store->m_n_rows;
+  const vid_t n_cols = a_store->m_n_cols;
+  const size_t n_blocks = (n_cols + NC_BLOCK - 1) / NC_BLOCK;
+  uint8_t *labels = a_clusters->m_labels.data();
+  arma::mat block_deltas(n_rows, N_POLARITIES * n_blocks);
+  std::vector<long long> block_counts(N_POLARITIES * n_blocks, 0);
+  std::vector<vid_t> block_moved(n_blocks, 0);
+
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_blocks; ++b) {
+    uint8_t old_label, new_label;
+    double *deltas = block_deltas.colptr(b * N_POLARITIES);
+    long long *counts = &block_counts[b * N_POLARITIES];
+    const vid_t end = std::min<vid_t>(n_cols, (b + 1) * NC_BLOCK);
+    for (vid_t vecid = b * NC_BLOCK; vecid < end; ++vecid) {
+      new_label = static_cast<uint8_t>(
+          _nc_i8_find_cluster(a_centroids, a_store, vecid));
+      if ((old_label = labels[vecid]) == new_label)
+        continue;
+
+      if (block_moved[b]++ == 0)
+        std::fill(deltas, deltas + n_rows * N_POLARITIES, 0.);
+
+      labels[vecid] = new_label;
+      if (old_label != NC_NO_LABEL) {
+        _i8_accumulate(deltas + old_label * n_rows, a_store, vecid, -1.);
+        --counts[old_label];
+      }
+      _i8_accumulate(deltas + new_label * n_rows, a_store, vecid, 1.);
+      ++counts[new_label];
+    }
+  }
+
+  vid_t n_moved = 0;
+  for (size_t b = 0; b < n_blocks; ++b) {
+    if (block_moved[b] == 0)
+      continue;
+
+    n_moved += block_moved[b];
+    for (size_t c_id = 0; c_id < N_POLARITIES; ++c_id) {
+      a_clusters->m_sums.col(c_id) +=
+          block_deltas.col(b * N_POLARITIES + c_id);
+      a_clusters->m_counts[c_id] += block_counts[b * N_POLARITIES + c_id];
+    }
+  }
+  return n_moved;
+}
+
+/**
+ * Quantize centroids to 8-bit integers
+ *
+ * @param a_qcentroids - quantized centroids to update
+ * @param a_centroids - centroids in double precision
+ *
+ * @return \c void
+ */
+static void _nc_i8_quantize_centroids(std::vector<i8_vec_t> *a_qcentroids,
+                                      const arma::mat *a_centroids) {
+  a_qcentroids->resize(a_centroids->n_cols);
+  for (size_t c_id = 0; c_id < a_centroids->n_cols; ++c_id)
+    quantize_i8_vector(&(*a_qcentroids)[c_id], a_centroids->colptr(c_id),
+                       a_centroids->n_rows);
+}
+
+void expand_nearest_centroids_i8(v2ps_t *a_vecid2pol,
+                                 const i8_store_t *a_store,
+                                 const int a_N,
+                                 const bool a_early_break,
+                                 const double a_tolerance) {
+  PhaseTimer timer("nc_iterations");
+  const vid_t n_cols = a_store->m_n_cols;
+
+  // populate intial clusters and compute their centroids
+  nc_clusters_t clusters;
+  clusters.m_labels.assign(n_cols, NC_NO_LABEL);
+  std::vector<bool> is_known(n_cols, false);
+  for (auto &v2p : *a_vecid2pol) {
+    clusters.m_labels[v2p.first] = static_cast<uint8_t>(
+        POLID2IDX[static_cast<pol_t>(v2p.second.first)]);
+    is_known[v2p.first] = true;
+  }
+
+  arma::mat centroids(a_store->m_n_rows, N_POLARITIES, arma::fill::zeros);
+  std::vector<i8_vec_t> qcentroids;
+  _nc_i8_compute_sums(&clusters, a_store);
+  _nc_update_centroids(&centroids, &clusters);
+  _nc_i8_quantize_centroids(&qcentroids, &centroids);
+
+  vid_t n_moved;
+  dist_t shift;
+  const vid_t max_moved = a_tolerance * n_cols;
+  for (int i = 0; !a_early_break; ++i) {
+    n_moved = _nc_i8_assign(&clusters, &qcentroids, a_store);
+    shift = 0.;
+    if (n_moved) {
+      shift = _nc_update_centroids(&centroids, &clusters);
+      _nc_i8_quantize_centroids(&qcentroids, &centroids);
+    }
+    std::cerr << "Run #" << i << ": " << n_moved
+              << " vectors moved, maximum centroid shift "
+              << shift << std::endl;
+    if (n_moved <= max_moved || shift <= a_tolerance)
+      break;
+  }
+  timer.stop();
+
+  PhaseTimer assign_timer("nc_assign");
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
+#pragma omp parallel
+  {
+    dist_t idist;
+    pol_t pol_i;
+    top_n_t *itop = &thread_tops[_thread_id()];
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n_cols; ++i) {
+      if (is_known[i])
+        continue;
+
+      pol_i = IDX2POLID[_nc_i8_find_cluster(&qcentroids, a_store, i,
+                                            &idist)];
+      if (pol_i == NEUTRAL)
+        continue;
+
+      itop->push(VPD {i, pol_i, idist});
+    }
+  }
+  assign_timer.stop();
+  _add_terms(a_vecid2pol, &thread_tops);
+}
+
+void expand_knn_i8(v2ps_t *a_vecid2pol, const i8_store_t *a_store,
+                   const int a_N, const int a_K) {
+  PhaseTimer timer("knn_search");
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
+
+  const size_t n_rows = a_store->m_n_rows;
+  const vid_t n_cols = a_store->m_n_cols;
+  const size_t K = a_K;
+
+  // copy codes of the seeds into a contiguous buffer
+  const size_t n_seeds = a_vecid2pol->size();
+  std::vector<int8_t> seed_codes(n_seeds * n_rows);
+  std::vector<i8_vec_t> seeds(n_seeds);
+  std::vector<pol_t> seed_pols;
+  seed_pols.reserve(n_seeds);
+  std::vector<bool> is_seed(n_cols, false);
+  for (auto &v2p : *a_vecid2pol) {
+    std::copy(a_store->codes(v2p.first),
+              a_store->codes(v2p.first) + n_rows,
+              &seed_codes[seed_pols.size() * n_rows]);
+    seeds[seed_pols.size()].m_scale = a_store->m_scales[v2p.first];
+    seeds[seed_pols.size()].m_sq_norm = a_store->m_sq_norms[v2p.first];
+    seed_pols.push_back(POLID2IDX[v2p.second.first]);
+    is_seed[v2p.first] = true;
+  }
+
+  const vid_t n_blocks = (n_cols + KNN_CAND_BLOCK - 1) / KNN_CAND_BLOCK;
+#pragma omp parallel
+  {
+    vpd_v_t heaps(KNN_CAND_BLOCK * K);
+    std::vector<size_t> heap_sizes(KNN_CAND_BLOCK);
+    vpd_v_t workbench(N_POLARITIES);
+    top_n_t *itop = &thread_tops[_thread_id()];
+
+    vpd_t ivpd;
+    vid_t start, vecid;
+    size_t n, seed_end;
+    dist_t idistance;
+    const int8_t *icodes;
+#pragma omp for schedule(static)
+    for (vid_t b = 0; b < n_blocks; ++b) {
+      start = b * KNN_CAND_BLOCK;
+      n = std::min(static_cast<vid_t>(KNN_CAND_BLOCK), n_cols - start);
+      heap_sizes.assign(n, 0);
+      // scan the block once for each tile of seeds, whose codes are
+      // kept in cache
+      for (size_t seed_start = 0; seed_start < n_seeds;
+           seed_start += KNN_SEED_BLOCK) {
+        seed_end = std::min(seed_start + KNN_SEED_BLOCK, n_seeds);
+        for (size_t j = 0; j < n; ++j) {
+          vecid = start + j;
+          if (is_seed[vecid])
+            continue;
+
+          icodes = a_store->codes(vecid);
+          for (size_t i = seed_start; i < seed_end; ++i) {
+            idistance = seeds[i].m_sq_norm + a_store->m_sq_norms[vecid]
+                - 2. * seeds[i].m_scale * a_store->m_scales[vecid]
+                * dot_product(&seed_codes[i * n_rows], icodes, n_rows);
+            _knn_push(&heaps[j * K], &heap_sizes[j], K,
+                      VPD {i, seed_pols[i],
+                           idistance < 0. ? 0.: idistance});
+          }
+        }
+      }
+
+      for (size_t j = 0; j < n; ++j) {
+        if (is_seed[start + j] || heap_sizes[j] == 0)
+          continue;
+
+        _knn_add(&ivpd, start + j, &heaps[j * K], heap_sizes[j],
+                 &workbench);
+        itop->push(ivpd);
+      }
+    }
+  }
+  timer.stop();
+  _add_terms(a_vecid2pol, &thread_tops);
 }
 
 /**
@@ -567,15 +1830,17 @@ static void _divide(arma::mat *mtx, size_t col_idx, const int n) {
  * Compute means of polarity vectors on the dimension with the biggest
  * deviation.
  *
- * @param a_vecid2polscore - mapping from vector id's to polarities
- *   and scores
- * @param a_prjctd - NWE matrix projected on the PCA space
+ * @param a_prjctd - seed vectors projected on the PCA space (one row
+ *                   per seed)
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_pol_stat - struct comprising statiscs about polarity
+ *                     vectors
  *
- * @return \c void
+ * @return matrix of means (one column per polarity index)
  */
-static arma::mat _pca_compute_means(const v2ps_t *a_vecid2polscore,
-				    const arma::mat *a_prjctd,
-				    pol_stat_t *a_pol_stat) {
+static arma::mat _pca_compute_means(const arma::mat *a_prjctd,
+                                    const std::vector<pol_t> *a_seed_pols,
+                                    pol_stat_t *a_pol_stat) {
   a_pol_stat->reset();
 
   // means of polarity vectors (the `+ 1` column is reserved for
@@ -585,8 +1850,9 @@ static arma::mat _pca_compute_means(const v2ps_t *a_vecid2polscore,
 
   // obtain unnormalized means of polarity vectors
   size_t pol_idx;
-  for (auto &v2p : *a_vecid2polscore) {
-    pol_idx = POLID2IDX[v2p.second.first];
+  const size_t n_dims = a_prjctd->n_cols;
+  for (size_t j = 0; j < a_seed_pols->size(); ++j) {
+    pol_idx = (*a_seed_pols)[j];
     switch (pol_idx) {
     case POS_IDX:
       ++a_pol_stat->m_n_pos;
@@ -598,7 +1864,8 @@ static arma::mat _pca_compute_means(const v2ps_t *a_vecid2polscore,
       ++a_pol_stat->m_n_neut;
       break;
     }
-    pol_means.col(pol_idx) += a_prjctd->row(v2p.first).t();
+    for (size_t i = 0; i < n_dims; ++i)
+      pol_means(i, pol_idx) += (*a_prjctd)(j, i);
   }
   a_pol_stat->m_n_subj = a_pol_stat->m_n_pos + a_pol_stat->m_n_neg;
   pol_means.col(SUBJ_IDX) = pol_means.col(POS_IDX) + pol_means.col(NEG_IDX);
@@ -615,34 +1882,68 @@ static arma::mat _pca_compute_means(const v2ps_t *a_vecid2polscore,
  * Find axis with the biggest difference between vectors with opposite
  * polarities.
  *
- * @param mtx - embedding matrix
- * @param a_vecid2pol - mapping from vector id's to polarities and scores
+ * For each axis, the sum of absolute differences between all pairs of
+ * coordinates `a` (1-st class) and `b` (2-nd class) is computed in
+ * O((|A| + |B|) log |B|) time: coordinates of the 2-nd class are
+ * sorted, and for each `a`, the differences to the `c` coordinates not
+ * greater than `a` sum up to `a * c - prefix_sum[c]`, whereas the
+ * differences to the remaining ones sum up to `(total - prefix_sum[c])
+ * - a * (|B| - c)`.  Axes are processed in parallel.
  *
- * @return
+ * @param a_prjctd - seed vectors projected on the PCA space (one row
+ *                   per seed)
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_idx1 - polarity index of the 1-st class
+ * @param a_idx2 - polarity index of the 2-nd class
+ *
+ * @return index of the axis
  */
-static vid_t _pca_find_axis(const arma::mat *a_mtx,
-			    const v2ps_t *a_vecid2polscore,
-			    const size_t a_idx1,
-			    const size_t a_idx2) {
-  arma::vec axis(a_mtx->n_cols, arma::fill::zeros);
-  arma::vec vec1(a_mtx->n_cols);
-
-  vid_t vec_id;
-  size_t pol_idx;
-  for (auto &v2p_1 : *a_vecid2polscore) {
-    pol_idx = POLID2IDX[v2p_1.second.first];
-    if (pol_idx != a_idx1)
-      continue;
-
-    vec_id = v2p_1.first;
-    vec1 = a_mtx->row(vec_id).t();
-    for (auto &v2p_2 : *a_vecid2polscore) {
-      pol_idx = POLID2IDX[v2p_2.second.first];
-      if (pol_idx != a_idx2)
-	continue;
+static vid_t _pca_find_axis(const arma::mat *a_prjctd,
+                            const std::vector<pol_t> *a_seed_pols,
+                            const size_t a_idx1,
+                            const size_t a_idx2) {
+  const size_t n_dims = a_prjctd->n_cols;
+  const size_t n_seeds = a_prjctd->n_rows;
+  arma::vec axis(n_dims, arma::fill::zeros);
+
+  // positions of the seeds of both classes
+  std::vector<size_t> idx1, idx2;
+  for (size_t j = 0; j < n_seeds; ++j) {
+    if ((*a_seed_pols)[j] == a_idx1)
+      idx1.push_back(j);
+    if ((*a_seed_pols)[j] == a_idx2)
+      idx2.push_back(j);
+  }
 
-      vec_id = v2p_2.first;
-      axis += arma::abs(vec1 - a_mtx->row(vec_id).t());
+  if (!idx1.empty() && !idx2.empty()) {
+#pragma omp parallel
+    {
+      const size_t n2 = idx2.size();
+      std::vector<dist_t> coords2(n2), prefix_sums(n2 + 1);
+#pragma omp for schedule(static)
+      for (size_t i = 0; i < n_dims; ++i) {
+        // coordinates of each axis are stored contiguously
+        const dist_t *coords = a_prjctd->colptr(i);
+        for (size_t j = 0; j < n2; ++j)
+          coords2[j] = coords[idx2[j]];
+
+        std::sort(coords2.begin(), coords2.end());
+        prefix_sums[0] = 0.;
+        for (size_t j = 0; j < n2; ++j)
+          prefix_sums[j + 1] = prefix_sums[j] + coords2[j];
+
+        size_t c;
+        dist_t a, delta = 0.;
+        const dist_t total = prefix_sums[n2];
+        for (auto j : idx1) {
+          a = coords[j];
+          c = std::upper_bound(coords2.begin(), coords2.end(), a)
+              - coords2.begin();
+          delta += (a * c - prefix_sums[c])
+              + ((total - prefix_sums[c]) - a * (n2 - c));
+        }
+        axis[i] = delta;
+      }
     }
   }
 
@@ -662,8 +1963,9 @@ static vid_t _pca_find_axis(const arma::mat *a_mtx,
  * Compute means of polarity vectors on the dimension with the biggest
  * deviation.
  *
- * @param a_vecid2pol - mapping from vector id's to polarities
- * @param a_prjctd - NWE matrix projected on the PCA space
+ * @param a_prjctd - seed vectors projected on the PCA space (one row
+ *                   per seed)
+ * @param a_seed_pols - polarity indices of the seed vectors
  * @param a_pol_stat - struct comprising statiscs about polarity
  *                     vectors
  *
@@ -671,18 +1973,17 @@ static vid_t _pca_find_axis(const arma::mat *a_mtx,
  *
  * @note modifies `pol_stat` in place
  */
-static void _pca_find_means_axes(v2ps_t *a_vecid2polscore,
-				 const arma::mat *a_prjctd,
-				 pol_stat_t *a_pol_stat) {
-  arma::mat means = _pca_compute_means(a_vecid2polscore,
-				       a_prjctd, a_pol_stat);
+static void _pca_find_means_axes(const arma::mat *a_prjctd,
+                                 const std::vector<pol_t> *a_seed_pols,
+                                 pol_stat_t *a_pol_stat) {
+  arma::mat means = _pca_compute_means(a_prjctd, a_seed_pols, a_pol_stat);
 
   // look for the dimension with the biggest difference between
   // distinct polarity classes
-  a_pol_stat->m_subj_dim = _pca_find_axis(a_prjctd, a_vecid2polscore,
-					  SUBJ_IDX, NEUT_IDX);
-  a_pol_stat->m_pol_dim = _pca_find_axis(a_prjctd, a_vecid2polscore,
-					 POS_IDX, NEG_IDX);
+  a_pol_stat->m_subj_dim = _pca_find_axis(a_prjctd, a_seed_pols,
+                                          SUBJ_IDX, NEUT_IDX);
+  a_pol_stat->m_pol_dim = _pca_find_axis(a_prjctd, a_seed_pols,
+                                         POS_IDX, NEG_IDX);
 
   // set means of the polarity classes
   a_pol_stat->m_pos_mean = means(a_pol_stat->m_pol_dim, POS_IDX);
@@ -696,87 +1997,716 @@ static void _pca_find_means_axes(v2ps_t *a_vecid2polscore,
  * mean of neutral vectors
  *
  * @param a_vecid2pol - mapping from vector id's to polarities
- * @param a_pca_nwe - neural-word embedding matrix projected onto the
- *                    PCA space
+ * @param a_subj_scores - projections of all vectors on the subjectivity
+ *                        axis
+ * @param a_pol_scores - projections of all vectors on the polarity axis
+ * @param a_is_seed - dense flags marking seed vectors
  * @param a_pol_stat - struct comprising statiscs about polarity
  *                     vectors
  * @param a_N - maximum number of terms to extract (-1 means unlimited)
  *
  * @return \c void
  */
-static void _pca_expand(v2ps_t *a_vecid2pol, const arma::mat *a_pca_nwe, \
-			const pol_stat_t *a_pol_stat, const int a_N) {
-  vpd_v_t vpds;
-  vpds.reserve(a_pca_nwe->n_rows - a_vecid2pol->size());
+static void _pca_expand(v2ps_t *a_vecid2pol,
+                        const arma::vec *a_subj_scores,
+                        const arma::vec *a_pol_scores,
+                        const std::vector<bool> *a_is_seed,
+                        const pol_stat_t *a_pol_stat, const int a_N) {
+  PhaseTimer timer("pca_score");
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
 
   // find maximum values of subjective and polar scores
-  vid_t subj_dim = a_pol_stat->m_subj_dim;
-  vid_t pol_dim = a_pol_stat->m_pol_dim;
-
-  arma::vec subj_scores = a_pca_nwe->col(subj_dim);
-  arma::vec pol_scores = a_pca_nwe->col(pol_dim);
+  const arma::vec &subj_scores = *a_subj_scores;
+  const arma::vec &pol_scores = *a_pol_scores;
 
   dist_t origin_subj = (a_pol_stat->m_neut_mean - a_pol_stat->m_subj_mean) / 2.;
   dist_t max_subj = arma::abs(subj_scores - origin_subj).max();
   dist_t origin_pol = (a_pol_stat->m_pos_mean - a_pol_stat->m_neg_mean) / 2.;
   dist_t max_pol = arma::abs(pol_scores - origin_pol).max();
 
-  int j = 0;
-  pol_t pol_i;
-  vid_t n = a_pca_nwe->n_rows;
-  dist_t subj_score_i, pol_score_i, score_i;
-  dist_t neut_delta, subj_delta, pos_delta, neg_delta;
-  v2ps_t::const_iterator v2p_end = a_vecid2pol->end();
-  // populate (since we are sorting the terms in the ascending order
-  // of their distances, we use negative values here)
-  for (vid_t i = 0; i < n; ++i) {
-    if (a_vecid2pol->find(i) != v2p_end)
-      continue;
+  const vid_t n = subj_scores.n_elem;
+
+#pragma omp parallel
+  {
+    pol_t pol_i;
+    dist_t subj_score_i, pol_score_i, score_i;
+    dist_t neut_delta, subj_delta, pos_delta, neg_delta;
+    top_n_t *itop = &thread_tops[_thread_id()];
+    // populate (since we are sorting the terms in the ascending order
+    // of their distances, we use negative values here)
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n; ++i) {
+      if ((*a_is_seed)[i])
+        continue;
+
+      // determine subjectivity score
+      neut_delta = fabs(subj_scores(i) - a_pol_stat->m_neut_mean);
+      subj_delta = fabs(subj_scores(i) - a_pol_stat->m_subj_mean);
+
+      if (neut_delta > subj_delta) {
+        subj_score_i = 1 + fabs(subj_scores(i) - origin_subj) / max_subj;
+      } else {
+        subj_score_i = 1 - fabs(subj_scores(i) - origin_subj) / max_subj;
+      }
 
-    // determine subjectivity score
-    neut_delta = fabs(subj_scores(i) - a_pol_stat->m_neut_mean);
-    subj_delta = fabs(subj_scores(i) - a_pol_stat->m_subj_mean);
+      // determine polarity score
+      pos_delta = fabs(pol_scores(i) - a_pol_stat->m_pos_mean);
+      neg_delta = fabs(pol_scores(i) - a_pol_stat->m_neg_mean);
 
-    if (neut_delta > subj_delta) {
-      subj_score_i = 1 + fabs(subj_scores(i) - origin_subj) / max_subj;
-    } else {
-      subj_score_i = 1 - fabs(subj_scores(i) - origin_subj) / max_subj;
+      if (pos_delta > neg_delta)
+        pol_i = NEGATIVE;
+      else
+        pol_i = POSITIVE;
+
+      pol_score_i = 1 + fabs(pol_scores(i) - origin_pol) / max_pol;
+
+      score_i = 1000./(subj_score_i + pol_score_i);
+      itop->push(VPD {i, pol_i, score_i});
     }
+  }
+  timer.stop();
+  _add_terms(a_vecid2pol, &thread_tops);
+}
 
-    // determine polarity score
-    pos_delta = fabs(pol_scores(i) - a_pol_stat->m_pos_mean);
-    neg_delta = fabs(pol_scores(i) - a_pol_stat->m_neg_mean);
+/**
+ * Compute mean of all embeddings
+ *
+ * @param a_mean - vector for storing the mean
+ * @param a_nwe - matrix of neural word embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _pca_compute_mean(arma::vec *a_mean,
+                              const NWEView<eT> *a_nwe) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  const size_t n_blocks = (n_cols + PCA_BLOCK - 1) / PCA_BLOCK;
+  arma::mat block_sums(n_rows, n_blocks);
+
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_blocks; ++b) {
+    const eT *ivec;
+    std::vector<eT> buf(n_rows);
+    dist_t *isum = block_sums.colptr(b);
+    std::fill(isum, isum + n_rows, 0.);
+    const vid_t end = std::min<vid_t>(n_cols, (b + 1) * PCA_BLOCK);
+    for (vid_t i = b * PCA_BLOCK; i < end; ++i) {
+      ivec = a_nwe->col(i, buf.data());
+      for (size_t j = 0; j < n_rows; ++j)
+        isum[j] += ivec[j];
+    }
+  }
 
-    if (pos_delta > neg_delta)
-      pol_i = NEGATIVE;
-    else
-      pol_i = POSITIVE;
+  a_mean->zeros(n_rows);
+  for (size_t b = 0; b < n_blocks; ++b)
+    *a_mean += block_sums.col(b);
+  *a_mean /= static_cast<double>(n_cols);
+}
+
+/**
+ * Multiply covariance matrix of the embeddings by a matrix
+ *
+ * The covariance matrix is never formed explicitly: the product
+ * `(X - mu 1^T)(X - mu 1^T)^T Q` is computed as `X (X^T Q) - n mu (mu^T
+ * Q)` over blocks of columns of the embedding matrix, which are used
+ * in place.  Partial products of the blocks are summed up in a fixed
+ * order.  Vectors which have to be normalized are processed in
+ * sub-blocks of `PCA_LAZY_BLOCK` columns, whose products are summed up
+ * in the order of the columns.
+ *
+ * @param a_prod - matrix for storing the product
+ * @param a_Q - matrix to multiply (one column per vector)
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_mean - mean of the embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _pca_cov_times(arma::mat *a_prod, const arma::mat *a_Q,
+                           const NWEView<eT> *a_nwe,
+                           const arma::vec *a_mean) {
+  const size_t n_rows = a_nwe->n_rows;
+  const size_t n_vecs = a_Q->n_cols;
+  const vid_t n_cols = a_nwe->n_cols;
+  const size_t n_blocks = (n_cols + PCA_BLOCK - 1) / PCA_BLOCK;
+  const arma::Mat<eT> Q = arma::conv_to<arma::Mat<eT>>::from(*a_Q);
+  arma::mat block_prods(n_rows, n_vecs * n_blocks);
+
+#pragma omp parallel
+  {
+    const size_t sub_block = a_nwe->is_lazy()? PCA_LAZY_BLOCK: PCA_BLOCK;
+    std::vector<eT> buf(a_nwe->is_lazy()? n_rows * sub_block: 0);
+    arma::Mat<eT> prod;
+    vid_t start, end, n;
+#pragma omp for schedule(static)
+    for (size_t b = 0; b < n_blocks; ++b) {
+      end = std::min<vid_t>(n_cols, (b + 1) * PCA_BLOCK);
+      for (start = b * PCA_BLOCK; start < end; start += n) {
+        n = std::min<vid_t>(sub_block, end - start);
+        // wrap the block of embeddings without copying it (unless it
+        // has to be normalized)
+        const arma::Mat<eT> block(
+            const_cast<eT *>(a_nwe->cols(start, n, buf.data())),
+            n_rows, n, false, true);
+        if (start == b * PCA_BLOCK)
+          prod = block * (block.t() * Q);
+        else
+          prod += block * (block.t() * Q);
+      }
+      const eT *iprod = prod.memptr();
+      dist_t *ibprod = block_prods.colptr(b * n_vecs);
+      for (size_t i = 0; i < n_rows * n_vecs; ++i)
+        ibprod[i] = iprod[i];
+    }
+  }
 
-    pol_score_i = 1 + fabs(pol_scores(i) - origin_pol) / max_pol;
+  a_prod->zeros(n_rows, n_vecs);
+  for (size_t b = 0; b < n_blocks; ++b)
+    *a_prod += block_prods.cols(b * n_vecs, (b + 1) * n_vecs - 1);
+
+  // subtract the contribution of the mean
+  const arma::mat mean_Q = a_mean->t() * (*a_Q);
+  *a_prod -= static_cast<double>(n_cols) * (*a_mean) * mean_Q;
+}
 
-    score_i = 1000./(subj_score_i + pol_score_i);
-    vpds.push_back(VPD {i, pol_i, score_i});
-    ++j;
+/**
+ * Compute leading principal components of the embeddings
+ *
+ * Components are obtained with a randomized subspace iteration on the
+ * covariance matrix, i.e., only `a_n_components` (plus
+ * `PCA_OVERSAMPLING`) directions are ever computed.
+ *
+ * @param a_components - matrix for storing the principal components
+ *                       (one per column, in the order of decreasing
+ *                       variance)
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_mean - mean of the embeddings
+ * @param a_n_components - number of components to compute
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _pca_compute_components(arma::mat *a_components,
+                                    const NWEView<eT> *a_nwe,
+                                    const arma::vec *a_mean,
+                                    const size_t a_n_components) {
+  const size_t n_rows = a_nwe->n_rows;
+  const size_t k = std::min(a_n_components, n_rows);
+  const size_t l = std::min(k + PCA_OVERSAMPLING, n_rows);
+
+  // start from a random (but reproducible) subspace
+  std::mt19937_64 generator(PCA_SEED);
+  std::normal_distribution<double> normal;
+  arma::mat Q(n_rows, l), R, Y;
+  for (size_t i = 0; i < Q.n_elem; ++i)
+    Q[i] = normal(generator);
+
+  Y = Q;
+  for (size_t i = 0; i <= PCA_POWER_ITERS; ++i) {
+    arma::qr_econ(Q, R, Y);
+    _pca_cov_times(&Y, &Q, a_nwe, a_mean);
   }
-  _add_terms(a_vecid2pol, &vpds, j, a_N);
+
+  // solve the eigenproblem projected on the subspace
+  arma::mat B = Q.t() * Y;
+  B = (B + B.t()) / 2.;
+  arma::vec eigval;
+  arma::mat eigvec;
+  arma::eig_sym(eigval, eigvec, B);
+
+  // eigenvalues are sorted in the ascending order
+  a_components->set_size(n_rows, k);
+  for (size_t c = 0; c < k; ++c)
+    a_components->col(c) = Q * eigvec.col(l - 1 - c);
 }
 
+/**
+ * Project vectors on principal components
+ *
+ * @param a_prjctd - vector for storing the projections
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_component - principal component
+ * @param a_mean - mean of the embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _pca_project(arma::vec *a_prjctd,
+                         const NWEView<eT> *a_nwe,
+                         const arma::vec *a_component,
+                         const arma::vec *a_mean) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n = a_nwe->n_cols;
+  // projection of the centered vector `x - mu` on component `c` is
+  // computed as `x . c - mu . c`
+  const arma::Mat<eT> component =
+      arma::conv_to<arma::Mat<eT>>::from(*a_component);
+  const dist_t offset = arma::dot(*a_mean, *a_component);
+
+  a_prjctd->set_size(n);
+#pragma omp parallel
+  {
+    std::vector<eT> buf(n_rows);
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n; ++i)
+      (*a_prjctd)(i) = dot_product(a_nwe->col(i, buf.data()),
+                                   component.memptr(), n_rows) - offset;
+  }
+}
+
+template <typename eT>
+void compute_pca_basis(pca_basis_t *a_basis, const NWEView<eT> *a_nwe,
+                       const int a_n_components) {
+  PhaseTimer timer("pca_basis");
+  // columns of `a_nwe` are observations and rows are variables
+  _pca_compute_mean(&a_basis->m_mean, a_nwe);
+  _pca_compute_components(&a_basis->m_components, a_nwe, &a_basis->m_mean,
+                          static_cast<size_t>(std::max(a_n_components, 1)));
+}
+
+template <typename eT>
+void project_pca_basis(pca_basis_t *a_basis, const NWEView<eT> *a_nwe) {
+  PhaseTimer timer("pca_project_all");
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n = a_nwe->n_cols;
+  const size_t n_components = a_basis->m_components.n_cols;
+  // every vector is read once and projected exactly as by
+  // `_pca_project()`
+  const arma::Mat<eT> components =
+      arma::conv_to<arma::Mat<eT>>::from(a_basis->m_components);
+  std::vector<dist_t> offsets(n_components);
+  for (size_t c = 0; c < n_components; ++c)
+    offsets[c] = arma::dot(a_basis->m_mean,
+                           arma::vec(a_basis->m_components.col(c)));
+
+  a_basis->m_projections.set_size(n, n_components);
+#pragma omp parallel
+  {
+    std::vector<eT> buf(n_rows);
+    const eT *icol;
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n; ++i) {
+      icol = a_nwe->col(i, buf.data());
+      for (size_t c = 0; c < n_components; ++c)
+        a_basis->m_projections(i, c) =
+            dot_product(icol, components.colptr(c), n_rows) - offsets[c];
+    }
+  }
+}
+
+template <typename eT>
 void expand_pca(v2ps_t *a_vecid2polscore,
-                const arma::mat *a_nwe, const int a_N) {
-  // obtain PCA coordinates for the neural word embeddings data
-  arma::mat pca_coeff, prjctd;
-  // `a_nwe` elements are stored in column-major format, i.e., each
-  // word corresponds to a column. `princomp()`, however, requires
-  // that columns represent variables and rows are observations
-  // (``Each row of X is an observation and each column is a
-  // variable'').  Therefore, we transpose the embedding matrix.
-  arma::princomp(pca_coeff, prjctd, a_nwe->t());
+                const NWEView<eT> *a_nwe, const int a_N,
+                const int a_n_components) {
+  // compute leading principal components of the embeddings
+  pca_basis_t basis;
+  compute_pca_basis(&basis, a_nwe, a_n_components);
+  expand_pca(a_vecid2polscore, a_nwe, a_N, &basis);
+}
+
+template <typename eT>
+void expand_pca(v2ps_t *a_vecid2polscore,
+                const NWEView<eT> *a_nwe, const int a_N,
+                const pca_basis_t *a_basis) {
+  PhaseTimer timer("pca_project");
+  const arma::vec &mean = a_basis->m_mean;
+  const arma::mat &components = a_basis->m_components;
+
+  // project seed vectors on the components
+  arma::Mat<eT> seeds;
+  std::vector<dist_t> seed_norms;
+  std::vector<pol_t> seed_pols;
+  std::vector<bool> is_seed;
+  _knn_gather_seeds(&seeds, &seed_norms, &seed_pols, &is_seed,
+                    a_vecid2polscore, a_nwe);
+  arma::mat prjctd = arma::conv_to<arma::mat>::from(seeds).t() * components;
+  const arma::mat offsets = mean.t() * components;
+  for (size_t c = 0; c < prjctd.n_cols; ++c)
+    prjctd.col(c) -= offsets(0, c);
 
   // look for the principal component with the maximum distance
   // between the means of the vectors pertaining to different
   // polarities
   pol_stat_t pol_stat;
-  _pca_find_means_axes(a_vecid2polscore, &prjctd, &pol_stat);
+  _pca_find_means_axes(&prjctd, &seed_pols, &pol_stat);
+
+  // project all vectors on the two selected components
+  arma::vec subj_scores, pol_scores;
+  const arma::vec subj_axis = components.col(pol_stat.m_subj_dim);
+  const arma::vec pol_axis = components.col(pol_stat.m_pol_dim);
+  if (a_basis->m_projections.n_rows == a_nwe->n_cols) {
+    subj_scores = a_basis->m_projections.col(pol_stat.m_subj_dim);
+    pol_scores = a_basis->m_projections.col(pol_stat.m_pol_dim);
+  } else {
+    _pca_project(&subj_scores, a_nwe, &subj_axis, &mean);
+    _pca_project(&pol_scores, a_nwe, &pol_axis, &mean);
+  }
+  timer.stop();
+
   // add new terms
-  _pca_expand(a_vecid2polscore, &prjctd, &pol_stat, a_N);
+  _pca_expand(a_vecid2polscore, &subj_scores, &pol_scores, &is_seed,
+              &pol_stat, a_N);
+}
+
+/**
+ * Compute objective and gradient of the projection line
+ *
+ * The objective is the sum of squared distances between the
+ * projections of all pairs of positive and negative seeds (cf.
+ * `scripts/find_prj_line.py`):
+ *
+ *   J(w) = \sum_{p}\sum_{n} (w^T p - w^T n)^2
+ *        = |N| \sum_{p} s_p^2 + |P| \sum_{n} s_n^2
+ *          - 2 \sum_{p} s_p \sum_{n} s_n,  where s_i = w^T x_i,
+ *
+ * which can be computed in time linear in the number of seeds.  Seeds
+ * are processed in parallel batches of `PRJ_BATCH` vectors whose
+ * partial gradients are summed in a fixed order, so that the result
+ * does not depend on the number of threads.
+ *
+ * @param a_grad - vector for storing the gradient
+ * @param a_prjctd - vector for storing the projections of the seeds
+ * @param a_batch_grads - matrix for storing partial gradients (one
+ *                        column per batch)
+ * @param a_line - current projection line (of unit length)
+ * @param a_seeds - seed vectors (one per column)
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_n_pos - number of positive seeds
+ * @param a_n_neg - number of negative seeds
+ *
+ * @return value of the objective for the current line
+ */
+template <typename eT>
+static dist_t _prj_gradient(std::vector<dist_t> *a_grad,
+                            std::vector<dist_t> *a_prjctd,
+                            arma::mat *a_batch_grads,
+                            const std::vector<eT> *a_line,
+                            const arma::Mat<eT> *a_seeds,
+                            const std::vector<pol_t> *a_seed_pols,
+                            const dist_t a_n_pos, const dist_t a_n_neg) {
+  const size_t n_rows = a_seeds->n_rows;
+  const size_t n_seeds = a_seeds->n_cols;
+  const size_t n_batches = a_batch_grads->n_cols;
+  const eT *line = a_line->data();
+
+  // project seeds on the line
+#pragma omp parallel for schedule(static)
+  for (size_t j = 0; j < n_seeds; ++j)
+    (*a_prjctd)[j] = dot_product(a_seeds->colptr(j), line, n_rows);
+
+  dist_t s, pos_sum = 0., neg_sum = 0., pos_sq = 0., neg_sq = 0.;
+  for (size_t j = 0; j < n_seeds; ++j) {
+    s = (*a_prjctd)[j];
+    switch ((*a_seed_pols)[j]) {
+    case POS_IDX:
+      pos_sum += s;
+      pos_sq += s * s;
+      break;
+    case NEG_IDX:
+      neg_sum += s;
+      neg_sq += s * s;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // dJ/dw = 2 \sum_{p} (|N| s_p - \sum_{n} s_n) p
+  //       + 2 \sum_{n} (|P| s_n - \sum_{p} s_p) n
+#pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n_batches; ++b) {
+    dist_t coeff;
+    const eT *iseed;
+    dist_t *igrad = a_batch_grads->colptr(b);
+    std::fill(igrad, igrad + n_rows, 0.);
+    const size_t end = std::min(n_seeds, (b + 1) * PRJ_BATCH);
+    for (size_t j = b * PRJ_BATCH; j < end; ++j) {
+      switch ((*a_seed_pols)[j]) {
+      case POS_IDX:
+        coeff = 2. * (a_n_neg * (*a_prjctd)[j] - neg_sum);
+        break;
+      case NEG_IDX:
+        coeff = 2. * (a_n_pos * (*a_prjctd)[j] - pos_sum);
+        break;
+      default:
+        continue;
+      }
+      iseed = a_seeds->colptr(j);
+      for (size_t k = 0; k < n_rows; ++k)
+        igrad[k] += coeff * iseed[k];
+    }
+  }
+  std::fill(a_grad->begin(), a_grad->end(), 0.);
+  for (size_t b = 0; b < n_batches; ++b) {
+    const dist_t *igrad = a_batch_grads->colptr(b);
+    for (size_t k = 0; k < n_rows; ++k)
+      (*a_grad)[k] += igrad[k];
+  }
+  return a_n_neg * pos_sq + a_n_pos * neg_sq - 2. * pos_sum * neg_sum;
+}
+
+/**
+ * Normalize projection line to unit length
+ *
+ * @param a_line - projection line to normalize
+ * @param a_iline - copy of the normalized line in the element type of
+ *                  the embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _prj_normalize(std::vector<dist_t> *a_line,
+                           std::vector<eT> *a_iline) {
+  dist_t length = 0.;
+  for (auto &w : *a_line)
+    length += w * w;
+
+  length = sqrt(length);
+  for (size_t k = 0; k < a_line->size(); ++k) {
+    (*a_line)[k] /= length;
+    (*a_iline)[k] = static_cast<eT>((*a_line)[k]);
+  }
 }
+
+/**
+ * Learn line which maximizes the distances between the projections of
+ * positive and negative seeds
+ *
+ * @param a_line - projection line (of unit length)
+ * @param a_prjctd - projections of the seeds on the line
+ * @param a_seeds - seed vectors (one per column)
+ * @param a_seed_pols - polarity indices of the seed vectors
+ * @param a_n_pos - number of positive seeds
+ * @param a_n_neg - number of negative seeds
+ * @param a_alpha - learning rate
+ * @param a_delta - minimum required improvement of the objective
+ * @param a_max_iters - maximum number of gradient updates
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _prj_learn_line(std::vector<eT> *a_line,
+                            std::vector<dist_t> *a_prjctd,
+                            const arma::Mat<eT> *a_seeds,
+                            const std::vector<pol_t> *a_seed_pols,
+                            const size_t a_n_pos, const size_t a_n_neg,
+                            const double a_alpha, const double a_delta,
+                            const unsigned long a_max_iters) {
+  const size_t n_rows = a_seeds->n_rows;
+  const size_t n_seeds = a_seeds->n_cols;
+  // start from the difference between the means of positive and
+  // negative seeds
+  std::vector<dist_t> line(n_rows, 0.), grad(n_rows);
+  dist_t coeff;
+  const eT *iseed;
+  bool is_zero = true;
+  for (size_t j = 0; j < n_seeds; ++j) {
+    switch ((*a_seed_pols)[j]) {
+    case POS_IDX:
+      coeff = 1. / a_n_pos;
+      break;
+    case NEG_IDX:
+      coeff = -1. / a_n_neg;
+      break;
+    default:
+      continue;
+    }
+    iseed = a_seeds->colptr(j);
+    for (size_t k = 0; k < n_rows; ++k)
+      line[k] += coeff * iseed[k];
+  }
+  for (auto &w : line)
+    is_zero = is_zero && w == 0.;
+  if (is_zero)
+    std::fill(line.begin(), line.end(), 1.);
+
+  a_line->resize(n_rows);
+  a_prjctd->resize(n_seeds);
+  arma::mat batch_grads(n_rows, (n_seeds + PRJ_BATCH - 1) / PRJ_BATCH);
+
+  unsigned long i = 0;
+  dist_t cost = 0., prev_cost = -MAX_DIST;
+  for (; i < a_max_iters; ++i) {
+    _prj_normalize(&line, a_line);
+    cost = _prj_gradient(&grad, a_prjctd, &batch_grads, a_line, a_seeds,
+                         a_seed_pols, a_n_pos, a_n_neg);
+    if (cost - prev_cost <= a_delta)
+      break;
+
+    prev_cost = cost;
+    for (size_t k = 0; k < n_rows; ++k)
+      line[k] += a_alpha * grad[k];
+  }
+  if (i == a_max_iters) {
+    _prj_normalize(&line, a_line);
+    cost = _prj_gradient(&grad, a_prjctd, &batch_grads, a_line, a_seeds,
+                         a_seed_pols, a_n_pos, a_n_neg);
+  }
+  std::cerr << "Learned projection line in " << i
+            << " iterations (cost " << cost << ')' << std::endl;
+}
+
+template <typename eT>
+void expand_projection(v2ps_t *a_vecid2polscore,
+                       const NWEView<eT> *a_nwe, const int a_N,
+                       const double a_alpha, const double a_delta,
+                       const unsigned long a_max_iters) {
+  PhaseTimer timer("prj_learn");
+  arma::Mat<eT> seeds;
+  std::vector<dist_t> seed_norms;
+  std::vector<pol_t> seed_pols;
+  std::vector<bool> is_seed;
+  _knn_gather_seeds(&seeds, &seed_norms, &seed_pols, &is_seed,
+                    a_vecid2polscore, a_nwe);
+
+  size_t n_pos = 0, n_neg = 0, n_neut = 0;
+  for (auto pol_idx : seed_pols) {
+    if (pol_idx == POS_IDX)
+      ++n_pos;
+    else if (pol_idx == NEG_IDX)
+      ++n_neg;
+    else
+      ++n_neut;
+  }
+  if (n_pos == 0 || n_neg == 0) {
+    std::cerr << "Cannot learn projection line without positive"
+        " and negative seeds" << std::endl;
+    return;
+  }
+
+  std::vector<eT> line;
+  std::vector<dist_t> prjctd;
+  _prj_learn_line(&line, &prjctd, &seeds, &seed_pols, n_pos, n_neg,
+                  a_alpha, a_delta, a_max_iters);
+
+  // compute mean projections of the seed classes and orient the line
+  // so that positive terms have greater projections
+  dist_t pos_mean = 0., neg_mean = 0., neut_mean = 0.;
+  for (size_t j = 0; j < prjctd.size(); ++j) {
+    switch (seed_pols[j]) {
+    case POS_IDX:
+      pos_mean += prjctd[j];
+      break;
+    case NEG_IDX:
+      neg_mean += prjctd[j];
+      break;
+    default:
+      neut_mean += prjctd[j];
+      break;
+    }
+  }
+  pos_mean /= n_pos;
+  neg_mean /= n_neg;
+  if (n_neut)
+    neut_mean /= n_neut;
+
+  const dist_t sign = pos_mean < neg_mean ? -1. : 1.;
+  pos_mean *= sign;
+  neg_mean *= sign;
+  neut_mean *= sign;
+  const dist_t boundary = (pos_mean + neg_mean) / 2.;
+  timer.stop();
+
+  PhaseTimer score_timer("prj_score");
+  std::vector<top_n_t> thread_tops(_n_threads(), top_n_t(a_N));
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n = a_nwe->n_cols;
+#pragma omp parallel
+  {
+    pol_t pol_i;
+    dist_t prjctd_i;
+    std::vector<eT> buf(n_rows);
+    top_n_t *itop = &thread_tops[_thread_id()];
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n; ++i) {
+      if (is_seed[i])
+        continue;
+
+      prjctd_i = sign * dot_product(a_nwe->col(i, buf.data()), line.data(),
+                                    n_rows);
+      pol_i = prjctd_i > boundary ? POSITIVE : NEGATIVE;
+      // terms that are closer to the neutral seeds than to the seeds
+      // of their polarity are skipped
+      if (n_neut && fabs(prjctd_i - neut_mean)
+          < fabs(prjctd_i - (pol_i == POSITIVE ? pos_mean : neg_mean)))
+        pol_i = NEUTRAL;
+
+      // terms that are farther from the decision boundary come first
+      itop->push(VPD {i, pol_i, 1. / (1. + fabs(prjctd_i - boundary))});
+    }
+  }
+  score_timer.stop();
+  _add_terms(a_vecid2polscore, &thread_tops);
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template void expand_nearest_centroids<float>(v2ps_t *,
+                                              const NWEView<float> *,
+                                              const int, const bool,
+                                              const double);
+template void expand_nearest_centroids<double>(v2ps_t *,
+                                               const NWEView<double> *,
+                                               const int, const bool,
+                                               const double);
+
+template void expand_knn<float>(v2ps_t *, const NWEView<float> *,
+                                const int, const int, const IVFIndex *,
+                                const int);
+template void expand_knn<double>(v2ps_t *, const NWEView<double> *,
+                                 const int, const int, const IVFIndex *,
+                                 const int);
+
+template void expand_knn_multi<float>(std::vector<v2ps_t> *,
+                                      const NWEView<float> *, const int,
+                                      const std::vector<int> *,
+                                      const IVFIndex *, const int);
+template void expand_knn_multi<double>(std::vector<v2ps_t> *,
+                                       const NWEView<double> *, const int,
+                                       const std::vector<int> *,
+                                       const IVFIndex *, const int);
+
+template void expand_nearest_centroids_pq<float>(v2ps_t *, const PQStore *,
+                                                 const NWEView<float> *,
+                                                 const int, const bool,
+                                                 const double, const int);
+template void expand_nearest_centroids_pq<double>(v2ps_t *, const PQStore *,
+                                                  const NWEView<double> *,
+                                                  const int, const bool,
+                                                  const double, const int);
+
+template void expand_knn_pq<float>(v2ps_t *, const PQStore *,
+                                   const NWEView<float> *, const int,
+                                   const int, const int);
+template void expand_knn_pq<double>(v2ps_t *, const PQStore *,
+                                    const NWEView<double> *, const int,
+                                    const int, const int);
+
+template void expand_pca<float>(v2ps_t *, const NWEView<float> *,
+                                const int, const int);
+template void expand_pca<double>(v2ps_t *, const NWEView<double> *,
+                                 const int, const int);
+template void expand_pca<float>(v2ps_t *, const NWEView<float> *,
+                                const int, const pca_basis_t *);
+template void expand_pca<double>(v2ps_t *, const NWEView<double> *,
+                                 const int, const pca_basis_t *);
+
+template void compute_pca_basis<float>(pca_basis_t *,
+                                       const NWEView<float> *, const int);
+template void compute_pca_basis<double>(pca_basis_t *,
+                                        const NWEView<double> *, const int);
+
+template void project_pca_basis<float>(pca_basis_t *,
+                                       const NWEView<float> *);
+template void project_pca_basis<double>(pca_basis_t *,
+                                        const NWEView<double> *);
+
+template void expand_projection<float>(v2ps_t *, const NWEView<float> *,
+                                       const int, const double,
+                                       const double, const unsigned long);
+template void expand_projection<double>(v2ps_t *, const NWEView<double> *,
+                                        const int, const double,
+                                        const double, const unsigned long);
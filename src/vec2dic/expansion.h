@@ -27,6 +27,7 @@
 #include <string>         // std::string
 #include <unordered_map>  // std::unordered_map
 #include <utility>        // std::pair
+#include <vector>         // std::vector
 
 ///////////
 // Types //
@@ -43,7 +44,9 @@ enum Polarity: unsigned {
     };
 const size_t N_POLARITIES = 3;
 
-/** Integral type for distance measure */
+/** Integral type for distance measure (scores are always computed and
+    reported in double precision, independently of the element type of
+    the embedding matrix) */
 using dist_t = double;
 const dist_t MAX_DIST = std::numeric_limits<dist_t>::max();
 const double PI_GRAD = 180 / M_PI;
@@ -57,18 +60,42 @@ using ps_t = std::pair<Polarity, dist_t>;
 /** Map from word to its polarity */
 using w2ps_t = std::unordered_map<std::string, ps_t>;
 
-/** Map from string to the index of its vector */
-using w2v_t = std::unordered_map<std::string, vid_t>;
-
 /** Map from word index to its polarity and score */
 using v2ps_t = std::unordered_map<vid_t, ps_t>;
 
-/** Map from vector index to string */
-using v2w_t = std::unordered_map<vid_t, std::string>;
-
 /** Forward list of vector id's */
 using vid_flist_t = std::forward_list<vid_t>;
 
+/** Inverted-file index for approximate KNN search (see ivf_index.h) */
+struct IVFIndex;
+
+/** Product-quantized word vectors (see pq_store.h) */
+struct PQStore;
+
+/** Word vectors quantized to 8-bit integers (see i8_store.h) */
+struct I8Store;
+
+/** Word vectors normalized on access (see nwe_view.h) */
+template <typename eT>
+class NWEView;
+
+/**
+ * Leading principal components of word embeddings.
+ *
+ * The basis only depends on the embedding matrix, so it can be shared
+ * by all PCA expansions over the same vectors.
+ */
+using pca_basis_t = struct PCABasis {
+  /// mean of the embeddings
+  arma::vec m_mean {};
+  /// principal components (one per column, in the order of decreasing
+  /// variance)
+  arma::mat m_components {};
+  /// projections of all embeddings on the centered components (one
+  /// row per embedding, empty if not computed)
+  arma::mat m_projections {};
+};
+
 /** Default learning rate for gradient methods */
 extern const double DFLT_ALPHA;
 
@@ -78,10 +105,19 @@ extern const double DFLT_DELTA;
 /** Maximum number of gradient updates */
 extern const int MAX_ITERS;
 
+/** Default number of principal components computed by the PCA method */
+extern const int DFLT_PCA_COMPONENTS;
+
 /////////////
 // Methods //
 /////////////
 
+// All expansion methods are templates over the element type `eT` of
+// the embedding matrix and are instantiated for `float` and `double`,
+// except for the ones working on 8-bit integer vectors, which do not
+// depend on it.  Uncompressed vectors are read through an `NWEView`,
+// which normalizes them on access.
+
 /**
  * Apply nearest centroids clustering algorithm to expand seed sets of polar terms
  *
@@ -92,40 +128,259 @@ extern const int MAX_ITERS;
  *              minimal distance to their respective centroids)
  * @param a_early_break - only apply one iteration (i.e. only assign words to the
  *                      centroids of known polarity term clusters)
+ * @param a_tolerance - stop iterating when the share of vectors that
+ *                      changed their clusters or the maximum shift of
+ *                      the centroids does not exceed this value (\c 0
+ *                      means full convergence)
  *
  * @return \c void (`a_vecid2polscore` is modified in place)
  */
+template <typename eT>
 void expand_nearest_centroids(v2ps_t *a_vecid2polscore,
-                              const arma::mat *a_nwe, const int a_N,
-                              const bool a_early_break = false);
+                              const NWEView<eT> *a_nwe, const int a_N,
+                              const bool a_early_break = false,
+                              const double a_tolerance = 0.);
 /**
  * Apply K-nearest neighbors clustering algorithm to expand seed sets of polar terms
  *
+ * If an inverted-file index is given, neighbors of each term are only
+ * searched among the seeds lying in the `a_n_probes` cells nearest to
+ * it, and the recall of this approximate search with respect to the
+ * exact one is estimated on a sample of terms and reported.
+ *
  * @param a_vecid2polscore - dictionary mapping known vector id's to the
  *                      polarities of their respective words
  * @param a_nwe - matrix of neural word embeddings
  * @param a_N - number of polar terms to extract
  * @param a_K - number of nearest neighbors to use
+ * @param a_index - inverted-file index over `a_nwe` (\c nullptr means
+ *                      exact search)
+ * @param a_n_probes - number of cells probed per term (\c 0 means all
+ *                      cells stored in the index)
  *
  * @return \c void (`a_vecid2polscore` is modified in place)
  */
-void expand_knn(v2ps_t *a_vecid2polscore, const arma::mat *a_nwe,
-                const int a_N, const int a_K = 5);
+template <typename eT>
+void expand_knn(v2ps_t *a_vecid2polscore, const NWEView<eT> *a_nwe,
+                const int a_N, const int a_K = 5,
+                const IVFIndex *a_index = nullptr,
+                const int a_n_probes = 0);
+
+/**
+ * Apply K-nearest neighbors algorithm with several values of K at once
+ *
+ * The neighbors of each term are searched only once (for the largest
+ * K) and sorted by distance, so that the class votes for all values of
+ * K are obtained as prefix sums in a single pass over this list.  The
+ * result for a single K is the same as that of `expand_knn()`.
+ *
+ * @param a_vecid2pols - dictionaries mapping known vector id's to the
+ *                      polarities of their respective words (one per
+ *                      element of `a_Ks`, all with the same seeds)
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_N - number of polar terms to extract
+ * @param a_Ks - numbers of nearest neighbors to use
+ * @param a_index - inverted-file index over `a_nwe` (\c nullptr means
+ *                      exact search)
+ * @param a_n_probes - number of cells probed per term (\c 0 means all
+ *                      cells stored in the index)
+ *
+ * @return \c void (`a_vecid2pols` are modified in place)
+ */
+template <typename eT>
+void expand_knn_multi(std::vector<v2ps_t> *a_vecid2pols,
+                      const NWEView<eT> *a_nwe, const int a_N,
+                      const std::vector<int> *a_Ks,
+                      const IVFIndex *a_index = nullptr,
+                      const int a_n_probes = 0);
+
+/**
+ * Apply nearest centroids algorithm to product-quantized word vectors
+ *
+ * Vectors are assigned to the centroids by their approximate distances
+ * computed from the codes, and clusters are represented by histograms
+ * of codes instead of sums of coordinates.  If uncompressed vectors
+ * are given and `a_rerank` is positive, `a_rerank * a_N` candidates
+ * are selected approximately and rescored with exact distances.
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_pq - product-quantized word vectors
+ * @param a_nwe - uncompressed word vectors (can be \c nullptr)
+ * @param a_N - number of polar terms to extract
+ * @param a_early_break - only assign words to the centroids of the seed
+ *                      sets without iterating
+ * @param a_tolerance - stop once the share of moved vectors or the
+ *                      maximum shift of the centroids does not exceed
+ *                      this value
+ * @param a_rerank - factor of candidates rescored exactly (\c 0 means
+ *                      no reranking)
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+template <typename eT>
+void expand_nearest_centroids_pq(v2ps_t *a_vecid2polscore,
+                                 const PQStore *a_pq,
+                                 const NWEView<eT> *a_nwe, const int a_N,
+                                 const bool a_early_break = false,
+                                 const double a_tolerance = 0.,
+                                 const int a_rerank = 0);
+
+/**
+ * Apply K-nearest neighbors algorithm to product-quantized word vectors
+ *
+ * Distances between the seeds and the remaining terms are computed
+ * asymmetrically from lookup tables of the seeds.  The seeds are used
+ * uncompressed if `a_nwe` is given, and reconstructed from their codes
+ * otherwise.  If uncompressed vectors are given and `a_rerank` is
+ * positive, `a_rerank * a_K` neighbors are found approximately, and
+ * the `a_K` nearest of them according to exact distances are used.
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_pq - product-quantized word vectors
+ * @param a_nwe - uncompressed word vectors (can be \c nullptr)
+ * @param a_N - number of polar terms to extract
+ * @param a_K - number of nearest neighbors to use
+ * @param a_rerank - factor of neighbors rescored exactly (\c 0 means
+ *                      no reranking)
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+template <typename eT>
+void expand_knn_pq(v2ps_t *a_vecid2polscore, const PQStore *a_pq,
+                   const NWEView<eT> *a_nwe, const int a_N,
+                   const int a_K = 5, const int a_rerank = 0);
+
+/**
+ * Apply nearest centroids algorithm to 8-bit integer word vectors
+ *
+ * Centroids are computed from the dequantized vectors and quantized
+ * themselves after each update, so that all distances are obtained
+ * from integer dot products.
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_store - word vectors quantized to 8-bit integers
+ * @param a_N - number of polar terms to extract
+ * @param a_early_break - only assign words to the centroids of the seed
+ *                      sets without iterating
+ * @param a_tolerance - stop once the share of moved vectors or the
+ *                      maximum shift of the centroids does not exceed
+ *                      this value
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+void expand_nearest_centroids_i8(v2ps_t *a_vecid2polscore,
+                                 const I8Store *a_store, const int a_N,
+                                 const bool a_early_break = false,
+                                 const double a_tolerance = 0.);
+
+/**
+ * Apply K-nearest neighbors algorithm to 8-bit integer word vectors
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_store - word vectors quantized to 8-bit integers
+ * @param a_N - number of polar terms to extract
+ * @param a_K - number of nearest neighbors to use
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+void expand_knn_i8(v2ps_t *a_vecid2polscore, const I8Store *a_store,
+                   const int a_N, const int a_K = 5);
 
 /**
  * Apply principal component analysis to expand seed sets of polar terms
  *
  * This algorithm applies the PCA algorithm to obtain the subspace of
  * polar terms and then projects remaining terms on this subspace.
+ * Only the leading principal components are computed (by a randomized
+ * truncated decomposition), and only the two selected ones are used
+ * for projecting the remaining terms.
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_N - number of polar terms to extract
+ * @param a_n_components - number of leading principal components to
+ *                      consider
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+template <typename eT>
+void expand_pca(v2ps_t *a_vecid2polscore,
+                const NWEView<eT> *a_nwe, const int a_N,
+                const int a_n_components = DFLT_PCA_COMPONENTS);
+
+/**
+ * Apply principal component analysis with a precomputed basis
  *
  * @param a_vecid2polscore - dictionary mapping known vector id's to the
  *                      polarities of their respective words
  * @param a_nwe - matrix of neural word embeddings
  * @param a_N - number of polar terms to extract
+ * @param a_basis - principal components of `a_nwe` (see
+ *                      `compute_pca_basis()`)
  *
  * @return \c void (`a_vecid2polscore` is modified in place)
  */
+template <typename eT>
 void expand_pca(v2ps_t *a_vecid2polscore,
-                const arma::mat *a_nwe, const int a_N);
+                const NWEView<eT> *a_nwe, const int a_N,
+                const pca_basis_t *a_basis);
+
+/**
+ * Compute leading principal components of word embeddings
+ *
+ * @param a_basis - basis to populate
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_n_components - number of leading principal components to
+ *                      compute
+ *
+ * @return \c void
+ */
+template <typename eT>
+void compute_pca_basis(pca_basis_t *a_basis, const NWEView<eT> *a_nwe,
+                       const int a_n_components = DFLT_PCA_COMPONENTS);
+
+/**
+ * Project word embeddings on all principal components
+ *
+ * PCA expansions with a projected basis skip both passes over the
+ * embeddings which project them on the selected components.
+ *
+ * @param a_basis - basis whose projections should be computed
+ * @param a_nwe - matrix of neural word embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+void project_pca_basis(pca_basis_t *a_basis, const NWEView<eT> *a_nwe);
+
+/**
+ * Apply linear projection to expand seed sets of polar terms
+ *
+ * This algorithm learns a line which maximizes the distances between
+ * the projections of positive and negative seeds by gradient ascent
+ * and then assigns remaining terms to polarity classes according to
+ * their projections on this line.
+ *
+ * @param a_vecid2polscore - dictionary mapping known vector id's to the
+ *                      polarities of their respective words
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_N - number of polar terms to extract
+ * @param a_alpha - learning rate
+ * @param a_delta - minimum required improvement of the objective
+ * @param a_max_iters - maximum number of gradient updates
+ *
+ * @return \c void (`a_vecid2polscore` is modified in place)
+ */
+template <typename eT>
+void expand_projection(v2ps_t *a_vecid2polscore,
+                       const NWEView<eT> *a_nwe, const int a_N,
+                       const double a_alpha = DFLT_ALPHA,
+                       const double a_delta = DFLT_DELTA,
+                       const unsigned long a_max_iters = MAX_ITERS);
 
 #endif    // VEC2DIC_EXPANSION_H_
@@ -0,0 +1,95 @@
+/** @file i8_store.cpp
+ *
+ *  @brief 8-bit integer store of neural word embeddings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/i8_store.h"
+#include "src/vec2dic/nwe_view.h"
+
+#include <algorithm>                    // std::max()
+#include <cmath>                        // fabs(), lround()
+
+///////////////
+// Constants //
+///////////////
+
+/** Largest magnitude of an integer code */
+static const int I8_MAX = 127;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Quantize coordinates of a vector
+ *
+ * @param a_codes - output integer codes
+ * @param a_coords - coordinates of the vector
+ * @param a_n_rows - number of coordinates
+ * @param a_sq_norm - output squared length of the quantized vector
+ *
+ * @return scale of the codes
+ */
+template <typename eT>
+static float _quantize(int8_t *a_codes, const eT *a_coords,
+                       const size_t a_n_rows, dist_t *a_sq_norm) {
+  double max_abs = 0.;
+  for (size_t i = 0; i < a_n_rows; ++i)
+    max_abs = std::max(max_abs, fabs(static_cast<double>(a_coords[i])));
+
+  const float scale = max_abs / I8_MAX;
+  long long sq_norm = 0;
+  for (size_t i = 0; i < a_n_rows; ++i) {
+    // codes are confined to [-127, 127] as required by the kernels
+    a_codes[i] = scale == 0.? 0: lround(a_coords[i] / scale);
+    sq_norm += a_codes[i] * a_codes[i];
+  }
+  *a_sq_norm = static_cast<dist_t>(scale) * scale * sq_norm;
+  return scale;
+}
+
+template <typename eT>
+void quantize_i8_store(i8_store_t *a_store, const NWEView<eT> *a_nwe) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  a_store->m_n_rows = n_rows;
+  a_store->m_n_cols = n_cols;
+  a_store->m_codes.resize(n_rows * n_cols);
+  a_store->m_scales.resize(n_cols);
+  a_store->m_sq_norms.resize(n_cols);
+
+#pragma omp parallel
+  {
+    std::vector<eT> buf(n_rows);
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n_cols; ++i)
+      a_store->m_scales[i] = _quantize(&a_store->m_codes[i * n_rows],
+                                       a_nwe->col(i, buf.data()), n_rows,
+                                       &a_store->m_sq_norms[i]);
+  }
+}
+
+void quantize_i8_vector(i8_vec_t *a_vec, const double *a_coords,
+                        const size_t a_n_rows) {
+  a_vec->m_codes.resize(a_n_rows);
+  a_vec->m_scale = _quantize(a_vec->m_codes.data(), a_coords, a_n_rows,
+                             &a_vec->m_sq_norm);
+}
+
+size_t i8_memory(const i8_store_t *a_store) {
+  return a_store->m_codes.size() * sizeof(int8_t)
+      + a_store->m_scales.size() * sizeof(float)
+      + a_store->m_sq_norms.size() * sizeof(dist_t);
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template void quantize_i8_store<float>(i8_store_t *,
+                                       const NWEView<float> *);
+template void quantize_i8_store<double>(i8_store_t *,
+                                        const NWEView<double> *);
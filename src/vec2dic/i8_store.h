@@ -0,0 +1,120 @@
+/** @file i8_store.h
+ *
+ *  @brief 8-bit integer store of neural word embeddings.
+ *
+ *  This file declares a compressed representation of neural word
+ *  embeddings in which every vector is scaled so that its largest
+ *  coordinate maps to 127 and rounded to 8-bit integers.  Distances are
+ *  computed from exact integer dot products as \f$\|a\|^2 + \|b\|^2 -
+ *  2 s_a s_b (q_a \cdot q_b)\f$, where \f$s\f$ are the scales and
+ *  \f$q\f$ the integer codes of the vectors, and the squared lengths
+ *  are those of the quantized vectors.
+ */
+
+#ifndef VEC2DIC_I8_STORE_H_
+# define VEC2DIC_I8_STORE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/kernels.h"
+
+#include <armadillo>      // arma::mat
+#include <cstdint>        // int8_t
+#include <cstdlib>        // size_t
+#include <vector>         // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Single vector quantized to 8-bit integers.
+ */
+using i8_vec_t = struct I8Vec {
+  /// integer codes of the coordinates
+  std::vector<int8_t> m_codes;
+  /// scale by which the codes have to be multiplied
+  float m_scale = 0.;
+  /// squared length of the quantized vector
+  dist_t m_sq_norm = 0.;
+};
+
+/**
+ * Word vectors quantized to 8-bit integers.
+ */
+using i8_store_t = struct I8Store {
+  /// number of coordinates per vector
+  size_t m_n_rows = 0;
+  /// number of vectors
+  vid_t m_n_cols = 0;
+  /// integer codes of the vectors (column-major)
+  std::vector<int8_t> m_codes;
+  /// scale of each vector
+  std::vector<float> m_scales;
+  /// squared length of each quantized vector
+  std::vector<dist_t> m_sq_norms;
+
+  /// codes of the given vector
+  const int8_t *codes(const vid_t a_vecid) const {
+    return &m_codes[a_vecid * m_n_rows];
+  }
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Quantize word embeddings
+ *
+ * @param a_store - store to populate
+ * @param a_nwe - matrix of neural word embeddings
+ *
+ * @return \c void
+ */
+template <typename eT>
+void quantize_i8_store(i8_store_t *a_store, const NWEView<eT> *a_nwe);
+
+/**
+ * Quantize a single vector
+ *
+ * @param a_vec - output quantized vector
+ * @param a_coords - coordinates of the vector
+ * @param a_n_rows - number of coordinates
+ *
+ * @return \c void
+ */
+void quantize_i8_vector(i8_vec_t *a_vec, const double *a_coords,
+                        const size_t a_n_rows);
+
+/**
+ * Compute squared distance between a quantized vector and a stored one
+ *
+ * @param a_store - 8-bit integer store
+ * @param a_vec - quantized vector
+ * @param a_vecid - id of the stored vector
+ *
+ * @return squared Euclidean distance of the quantized vectors
+ */
+inline dist_t i8_sq_distance(const i8_store_t *a_store,
+                             const i8_vec_t *a_vec, const vid_t a_vecid) {
+  const dist_t ret = a_store->m_sq_norms[a_vecid] + a_vec->m_sq_norm
+      - 2. * a_store->m_scales[a_vecid] * a_vec->m_scale
+      * dot_product(a_store->codes(a_vecid), a_vec->m_codes.data(),
+                    a_store->m_n_rows);
+  // guard against negative values caused by rounding errors
+  return ret < 0.? 0.: ret;
+}
+
+/**
+ * Return number of bytes occupied by the store
+ *
+ * @param a_store - 8-bit integer store
+ *
+ * @return size of codes, scales, and lengths in bytes
+ */
+size_t i8_memory(const i8_store_t *a_store);
+
+#endif    // VEC2DIC_I8_STORE_H_
@@ -0,0 +1,462 @@
+/** @file ivf_index.cpp
+ *
+ *  @brief inverted-file index for approximate nearest-neighbor search.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/ivf_index.h"
+#include "src/vec2dic/kernels.h"
+#include "src/vec2dic/nwe_cache.h"
+#include "src/vec2dic/nwe_view.h"
+
+#include <unistd.h>                     // unlink()
+
+#include <algorithm>                    // std::partial_sort()
+#include <cmath>                        // llround(), sqrt()
+#include <cstring>                      // memcmp(), memcpy(), memset()
+#include <fstream>                      // std::ifstream, std::ofstream
+#include <iostream>                     // std::cerr
+#include <string>                       // std::string
+#include <utility>                      // std::pair
+
+#ifdef _OPENMP
+# include <omp.h>                       // omp_get_max_threads()
+#endif
+
+///////////
+// Types //
+///////////
+
+/**
+ * Header of an index file.
+ */
+using ivf_header_t = struct IVFHeader {
+  /// magic bytes identifying the format
+  char m_magic[8];
+  /// version of the format
+  uint32_t m_version;
+  /// reserved for future use
+  uint32_t m_reserved;
+  /// fingerprint of the embeddings the index was built for
+  uint64_t m_fingerprint;
+  /// number of coordinates per centroid
+  uint64_t m_n_rows;
+  /// number of cells
+  uint64_t m_n_lists;
+  /// number of indexed vectors
+  uint64_t m_n_cols;
+  /// number of nearest cells stored for each vector
+  uint64_t m_n_probes;
+};
+
+/** Distance to a centroid paired with the number of its cell */
+using dc_t = std::pair<dist_t, uint32_t>;
+
+///////////////
+// Constants //
+///////////////
+
+const int DFLT_IVF_PROBES = 16;
+const int DFLT_IVF_LISTS = 0;
+
+/** Magic bytes identifying index files */
+static const char IVF_MAGIC[8] = {'V', '2', 'D', 'I', 'V', 'F', '\0', '\0'};
+
+/** Current version of the index format */
+static const uint32_t IVF_VERSION = 1;
+
+/** Number of sampled vectors per cell used for clustering */
+static const size_t IVF_SAMPLES_PER_LIST = 64;
+
+/** Number of k-means iterations */
+static const int IVF_KMEANS_ITERS = 10;
+
+/** Number of vectors compared to the centroids at once */
+static const size_t IVF_BLOCK = 1024;
+
+/** Maximum number of columns hashed into the fingerprint */
+static const size_t IVF_FINGERPRINT_COLS = 1024;
+
+/** Offset basis and prime of the 64-bit FNV-1a hash */
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Feed bytes into an FNV-1a hash
+ *
+ * @param a_hash - hash to update
+ * @param a_data - bytes to hash
+ * @param a_size - number of bytes
+ *
+ * @return \c void
+ */
+static void _fnv1a(uint64_t *a_hash, const void *a_data, size_t a_size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(a_data);
+  for (size_t i = 0; i < a_size; ++i) {
+    *a_hash ^= bytes[i];
+    *a_hash *= FNV_PRIME;
+  }
+}
+
+template <typename eT>
+uint64_t nwe_fingerprint(const NWEView<eT> *a_nwe) {
+  const uint64_t shape[3] = {a_nwe->n_rows, a_nwe->n_cols, sizeof(eT)};
+  uint64_t hash = FNV_OFFSET;
+  _fnv1a(&hash, shape, sizeof(shape));
+
+  const size_t n_cols = a_nwe->n_cols;
+  const size_t n_sample = std::min(n_cols, IVF_FINGERPRINT_COLS);
+  std::vector<eT> buf(a_nwe->n_rows);
+  for (size_t i = 0; i < n_sample; ++i)
+    _fnv1a(&hash, a_nwe->col(i * n_cols / n_sample, buf.data()),
+           a_nwe->n_rows * sizeof(eT));
+  return hash;
+}
+
+/**
+ * Determine nearest cells of vectors
+ *
+ * Squared distances to the centroids are computed (up to the constant
+ * length of the vector) as \f$\|c\|^2 - 2c\cdot v\f$, with the dot
+ * products of a block of vectors and all centroids obtained by a
+ * single matrix product.  Ties are broken by cell numbers.
+ *
+ * @param a_cells - output array (`a_n_probes` cells per vector)
+ * @param a_n_probes - number of nearest cells to find for each vector
+ * @param a_vecs - vectors to assign (one per column)
+ * @param a_centroids - centroids of the cells (one per column)
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _ivf_nearest_cells(uint32_t *a_cells, const size_t a_n_probes,
+                               const NWEView<eT> *a_vecs,
+                               const arma::Mat<eT> *a_centroids) {
+  const size_t n_rows = a_vecs->n_rows;
+  const size_t n_lists = a_centroids->n_cols;
+  std::vector<dist_t> centroid_norms(n_lists);
+  const eT *icentroid;
+  for (size_t c = 0; c < n_lists; ++c) {
+    icentroid = a_centroids->colptr(c);
+    centroid_norms[c] = dot_product(icentroid, icentroid, n_rows);
+  }
+
+  const size_t n_cols = a_vecs->n_cols;
+  const size_t n_blocks = (n_cols + IVF_BLOCK - 1) / IVF_BLOCK;
+#pragma omp parallel
+  {
+    arma::Mat<eT> dots;
+    std::vector<eT> buf(a_vecs->is_lazy()? n_rows * IVF_BLOCK: 0);
+    std::vector<dc_t> workbench(n_lists);
+    const eT *idots;
+    uint32_t *icells;
+    size_t start, n;
+#pragma omp for schedule(static)
+    for (size_t b = 0; b < n_blocks; ++b) {
+      start = b * IVF_BLOCK;
+      n = std::min(IVF_BLOCK, n_cols - start);
+      const arma::Mat<eT> block(
+          const_cast<eT *>(a_vecs->cols(start, n, buf.data())),
+          n_rows, n, false, true);
+      // (n_lists x n) matrix of dot products
+      dots = a_centroids->t() * block;
+      for (size_t j = 0; j < n; ++j) {
+        idots = dots.colptr(j);
+        for (size_t c = 0; c < n_lists; ++c)
+          workbench[c] = dc_t(centroid_norms[c] - 2. * idots[c], c);
+
+        std::partial_sort(workbench.begin(),
+                          workbench.begin() + a_n_probes, workbench.end());
+        icells = &a_cells[(start + j) * a_n_probes];
+        for (size_t p = 0; p < a_n_probes; ++p)
+          icells[p] = workbench[p].second;
+      }
+    }
+  }
+}
+
+/**
+ * Cluster vectors with the k-means algorithm
+ *
+ * The centroids are initialized with evenly spaced vectors.  Centroids
+ * of empty clusters keep their previous position.
+ *
+ * @param a_centroids - output matrix of centroids (one per column)
+ * @param a_vecs - vectors to cluster (one per column)
+ * @param a_n_lists - number of clusters
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _ivf_kmeans(arma::Mat<eT> *a_centroids,
+                        const arma::Mat<eT> *a_vecs,
+                        const size_t a_n_lists) {
+  const size_t n_rows = a_vecs->n_rows;
+  const size_t n_cols = a_vecs->n_cols;
+  a_centroids->set_size(n_rows, a_n_lists);
+  for (size_t c = 0; c < a_n_lists; ++c)
+    a_centroids->col(c) = a_vecs->col(c * n_cols / a_n_lists);
+
+  const NWEView<eT> vecs(a_vecs);
+  std::vector<uint32_t> labels(n_cols);
+  std::vector<size_t> counts;
+  arma::mat sums;
+  const eT *ivec;
+  double *isum;
+  eT *icentroid;
+  for (int it = 0; it < IVF_KMEANS_ITERS; ++it) {
+    _ivf_nearest_cells(labels.data(), 1, &vecs, a_centroids);
+
+    sums.zeros(n_rows, a_n_lists);
+    counts.assign(a_n_lists, 0);
+    for (size_t i = 0; i < n_cols; ++i) {
+      ivec = a_vecs->colptr(i);
+      isum = sums.colptr(labels[i]);
+      for (size_t r = 0; r < n_rows; ++r)
+        isum[r] += ivec[r];
+      ++counts[labels[i]];
+    }
+
+    for (size_t c = 0; c < a_n_lists; ++c) {
+      if (counts[c] == 0)
+        continue;
+
+      isum = sums.colptr(c);
+      icentroid = a_centroids->colptr(c);
+      for (size_t r = 0; r < n_rows; ++r)
+        icentroid[r] = isum[r] / counts[c];
+    }
+  }
+}
+
+/**
+ * Store nearest cells of all vectors in the index
+ *
+ * @param a_index - index whose centroids are already computed
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_n_probes - number of nearest cells to store for each vector
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _ivf_assign(ivf_index_t *a_index, const NWEView<eT> *a_nwe,
+                        size_t a_n_probes) {
+  const arma::Mat<eT> centroids =
+      arma::conv_to<arma::Mat<eT>>::from(a_index->m_centroids);
+  a_n_probes = std::min<size_t>(a_n_probes, centroids.n_cols);
+  a_index->m_n_probes = a_n_probes;
+  a_index->m_cells.resize(a_nwe->n_cols * a_n_probes);
+  _ivf_nearest_cells(a_index->m_cells.data(), a_n_probes, a_nwe,
+                     &centroids);
+}
+
+template <typename eT>
+void build_ivf_index(ivf_index_t *a_index, const NWEView<eT> *a_nwe,
+                     size_t a_n_lists, size_t a_n_probes) {
+  const size_t n_cols = a_nwe->n_cols;
+  a_index->m_fingerprint = nwe_fingerprint(a_nwe);
+  if (n_cols == 0) {
+    a_index->m_n_probes = 0;
+    a_index->m_centroids.reset();
+    a_index->m_cells.clear();
+    return;
+  }
+
+  if (a_n_lists == 0)
+    a_n_lists = std::max<size_t>(1, llround(sqrt(n_cols)));
+  a_n_lists = std::min(a_n_lists, n_cols);
+
+  // cluster an evenly spaced sample of the vocabulary
+  const size_t n_sample = std::min(n_cols,
+                                   IVF_SAMPLES_PER_LIST * a_n_lists);
+  arma::Mat<eT> centroids;
+  if (n_sample == n_cols && !a_nwe->is_lazy()) {
+    _ivf_kmeans(&centroids, a_nwe->matrix(), a_n_lists);
+  } else {
+    arma::Mat<eT> sample(a_nwe->n_rows, n_sample);
+    for (size_t i = 0; i < n_sample; ++i)
+      a_nwe->normalize(i * n_cols / n_sample, 1, sample.colptr(i));
+    _ivf_kmeans(&centroids, &sample, a_n_lists);
+  }
+  a_index->m_centroids = arma::conv_to<arma::mat>::from(centroids);
+  _ivf_assign(a_index, a_nwe, a_n_probes);
+}
+
+/**
+ * Check that the centroids and cells of an IVF index fill its file
+ *
+ * Sizes are compared by division, so that corrupted headers cannot
+ * make the products of the dimensions overflow.
+ *
+ * @param a_header - header of the index
+ * @param a_size - size of the file after the header in bytes
+ *
+ * @return \c true if the payload has exactly the given size, \c false
+ *   otherwise
+ */
+static bool _check_payload(const ivf_header_t *a_header,
+                           uint64_t a_size) {
+  const uint64_t n_rows = a_header->m_n_rows;
+  const uint64_t n_lists = a_header->m_n_lists;
+  if (n_rows != 0 && n_lists > a_size / sizeof(double) / n_rows)
+    return false;
+
+  a_size -= n_rows * n_lists * sizeof(double);
+  // cells are stored for all vectors only if any cells are probed
+  const uint64_t n_probes = a_header->m_n_probes;
+  if (n_probes == 0)
+    return a_size == 0;
+  if (n_probes > a_size / sizeof(uint32_t))
+    return false;
+  return a_size % (n_probes * sizeof(uint32_t)) == 0
+      && a_header->m_n_cols == a_size / (n_probes * sizeof(uint32_t));
+}
+
+template <typename eT>
+void open_ivf_index(ivf_index_t *a_index, const char *a_fname,
+                    const NWEView<eT> *a_nwe, size_t a_n_lists,
+                    size_t a_n_probes) {
+  const uint64_t fingerprint = nwe_fingerprint(a_nwe);
+  const size_t n_cols = a_nwe->n_cols;
+  // store enough cells for probing more than requested later on
+  const size_t n_stored = std::max<size_t>(a_n_probes, DFLT_IVF_PROBES);
+  bool rebuild = true;
+  std::ifstream is(a_fname, std::ios::binary);
+  if (is.good()) {
+    is.close();
+    if (load_ivf_index(a_fname, a_index) == 0
+        && a_index->m_fingerprint == fingerprint
+        && (a_n_lists == 0
+            || a_index->m_centroids.n_cols == std::min(a_n_lists, n_cols))) {
+      if (a_index->m_n_probes
+          >= std::min<size_t>(a_n_probes, a_index->m_centroids.n_cols)) {
+        std::cerr << "Using IVF index " << a_fname << " ("
+                  << a_index->m_centroids.n_cols << " cells)" << std::endl;
+        return;
+      }
+      rebuild = false;
+    } else {
+      std::cerr << "IVF index " << a_fname << " does not match the vectors"
+          " and will be rebuilt" << std::endl;
+    }
+  }
+
+  if (rebuild) {
+    std::cerr << "Building IVF index ... ";
+    build_ivf_index(a_index, a_nwe, a_n_lists, n_stored);
+  } else {
+    // the clustering is still valid, only more cells are needed
+    std::cerr << "Extending IVF index ... ";
+    _ivf_assign(a_index, a_nwe, n_stored);
+  }
+  std::cerr << "done (" << a_index->m_centroids.n_cols << " cells)"
+            << std::endl;
+  if (save_ivf_index(a_fname, a_index))
+    std::cerr << "IVF index will be rebuilt on the next run" << std::endl;
+}
+
+int save_ivf_index(const char *a_fname, const ivf_index_t *a_index) {
+  ivf_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.m_magic, IVF_MAGIC, sizeof(IVF_MAGIC));
+  header.m_version = IVF_VERSION;
+  header.m_fingerprint = a_index->m_fingerprint;
+  header.m_n_rows = a_index->m_centroids.n_rows;
+  header.m_n_lists = a_index->m_centroids.n_cols;
+  header.m_n_probes = a_index->m_n_probes;
+  header.m_n_cols = header.m_n_probes == 0? 0:
+      a_index->m_cells.size() / header.m_n_probes;
+
+  // write to a private file first, so that concurrent readers never see
+  // an incomplete index
+  const std::string tmp_fname = nwe_cache_tmp_fname(a_fname);
+  std::ofstream os(tmp_fname, std::ios::binary | std::ios::trunc);
+  if (!os) {
+    std::cerr << "Cannot open file " << tmp_fname << std::endl;
+    return 1;
+  }
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char *>(a_index->m_centroids.memptr()),
+           a_index->m_centroids.n_elem * sizeof(double));
+  os.write(reinterpret_cast<const char *>(a_index->m_cells.data()),
+           a_index->m_cells.size() * sizeof(uint32_t));
+  os.close();
+  if (os.fail()) {
+    std::cerr << "Failed to write IVF index " << a_fname << std::endl;
+    unlink(tmp_fname.c_str());
+    return 1;
+  }
+  return commit_nwe_cache_file(tmp_fname, a_fname);
+}
+
+int load_ivf_index(const char *a_fname, ivf_index_t *a_index) {
+  ivf_header_t header;
+  std::ifstream is(a_fname, std::ios::binary | std::ios::ate);
+  if (!is) {
+    std::cerr << "Cannot open file " << a_fname << std::endl;
+    return 1;
+  }
+  const uint64_t size = is.tellg();
+  is.seekg(0);
+  if (!is.read(reinterpret_cast<char *>(&header), sizeof(header))
+      || memcmp(header.m_magic, IVF_MAGIC, sizeof(IVF_MAGIC)) != 0
+      || header.m_version != IVF_VERSION
+      || header.m_n_probes > header.m_n_lists) {
+    std::cerr << "Unsupported IVF index format " << a_fname << std::endl;
+    return 1;
+  }
+  // check the sizes against the file before allocating anything
+  if (!_check_payload(&header, size - sizeof(header))) {
+    std::cerr << "Incorrect IVF index " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    return 1;
+  }
+
+  a_index->m_fingerprint = header.m_fingerprint;
+  a_index->m_n_probes = header.m_n_probes;
+  a_index->m_centroids.set_size(header.m_n_rows, header.m_n_lists);
+  a_index->m_cells.resize(header.m_n_cols * header.m_n_probes);
+  is.read(reinterpret_cast<char *>(a_index->m_centroids.memptr()),
+          a_index->m_centroids.n_elem * sizeof(double));
+  is.read(reinterpret_cast<char *>(a_index->m_cells.data()),
+          a_index->m_cells.size() * sizeof(uint32_t));
+  if (!is) {
+    std::cerr << "Incorrect IVF index " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    return 1;
+  }
+  for (auto cell : a_index->m_cells) {
+    if (cell >= header.m_n_lists) {
+      std::cerr << "Incorrect IVF index " << a_fname
+                << " (truncated or corrupted)" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template uint64_t nwe_fingerprint<float>(const NWEView<float> *);
+template uint64_t nwe_fingerprint<double>(const NWEView<double> *);
+
+template void build_ivf_index<float>(ivf_index_t *, const NWEView<float> *,
+                                     size_t, size_t);
+template void build_ivf_index<double>(ivf_index_t *,
+                                      const NWEView<double> *,
+                                      size_t, size_t);
+
+template void open_ivf_index<float>(ivf_index_t *, const char *,
+                                    const NWEView<float> *, size_t,
+                                    size_t);
+template void open_ivf_index<double>(ivf_index_t *, const char *,
+                                     const NWEView<double> *, size_t,
+                                     size_t);
@@ -0,0 +1,143 @@
+/** @file ivf_index.h
+ *
+ *  @brief inverted-file index for approximate nearest-neighbor search.
+ *
+ *  This file declares an inverted-file (IVF) index which partitions
+ *  the space of word embeddings into cells around the centroids of a
+ *  k-means clustering of the vocabulary.  Vectors are bucketed into
+ *  inverted lists by their nearest centroid, and a query only scans
+ *  the lists of its few nearest centroids (probes), which trades a
+ *  small loss of recall for a large reduction of distance computations.
+ *
+ *  Since the cells only depend on the embeddings, the index is built
+ *  once and stored next to them, and can be reused for any seed set.
+ *  Besides the centroids, the index keeps the nearest cells of every
+ *  vector, so that no distances to the centroids have to be computed
+ *  at query time.
+ *
+ *  The index file consists of a fixed-size header, the column-major
+ *  matrix of centroids in double precision, and the table of nearest
+ *  cells (`n_probes` 32-bit cell numbers per vector, nearest first).
+ *  All numbers are stored in the byte order of the host.
+ */
+
+#ifndef VEC2DIC_IVF_INDEX_H_
+# define VEC2DIC_IVF_INDEX_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <armadillo>      // arma::mat
+#include <cstdint>        // uint64_t
+#include <cstdlib>        // size_t
+#include <vector>         // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Inverted-file index over neural word embeddings.
+ */
+using ivf_index_t = struct IVFIndex {
+  /// fingerprint of the embeddings the index was built for
+  uint64_t m_fingerprint = 0;
+  /// number of nearest cells stored for each vector
+  size_t m_n_probes = 0;
+  /// centroids of the cells (one per column)
+  arma::mat m_centroids;
+  /// nearest cells of each vector (`m_n_probes` per vector)
+  std::vector<uint32_t> m_cells;
+};
+
+///////////////
+// Variables //
+///////////////
+
+/** Default number of cells probed per query */
+extern const int DFLT_IVF_PROBES;
+
+/** Default number of cells (\c 0 means square root of the vocabulary
+    size) */
+extern const int DFLT_IVF_LISTS;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute a fingerprint of neural word embeddings
+ *
+ * The fingerprint covers the shape and precision of the matrix and the
+ * contents of an evenly spaced sample of its columns, which suffices
+ * for detecting stale index files.
+ *
+ * @param a_nwe - matrix of neural word embeddings
+ *
+ * @return 64-bit fingerprint
+ */
+template <typename eT>
+uint64_t nwe_fingerprint(const NWEView<eT> *a_nwe);
+
+/**
+ * Build index by clustering neural word embeddings
+ *
+ * The centroids are obtained by a few k-means iterations on an evenly
+ * spaced sample of the vocabulary, after which the nearest cells of
+ * every vector are determined.
+ *
+ * @param a_index - index to populate
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_n_lists - number of cells (\c 0 means choose automatically)
+ * @param a_n_probes - number of nearest cells to store for each vector
+ *
+ * @return \c void
+ */
+template <typename eT>
+void build_ivf_index(ivf_index_t *a_index, const NWEView<eT> *a_nwe,
+                     size_t a_n_lists, size_t a_n_probes);
+
+/**
+ * Load index for the given embeddings or build and store a new one
+ *
+ * An existing index file is only used if it was built for the same
+ * embeddings, with the same number of cells (unless `a_n_lists` is
+ * \c 0), and stores at least `a_n_probes` nearest cells per vector.
+ * Failure to store a newly built index is not fatal.
+ *
+ * @param a_index - index to populate
+ * @param a_fname - name of the index file
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_n_lists - number of cells (\c 0 means choose automatically)
+ * @param a_n_probes - number of cells probed per query
+ *
+ * @return \c void
+ */
+template <typename eT>
+void open_ivf_index(ivf_index_t *a_index, const char *a_fname,
+                    const NWEView<eT> *a_nwe, size_t a_n_lists,
+                    size_t a_n_probes);
+
+/**
+ * Store index in a binary file
+ *
+ * @param a_fname - name of the output file
+ * @param a_index - index to store
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int save_ivf_index(const char *a_fname, const ivf_index_t *a_index);
+
+/**
+ * Read index from a binary file
+ *
+ * @param a_fname - name of the input file
+ * @param a_index - index to populate
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int load_ivf_index(const char *a_fname, ivf_index_t *a_index);
+
+#endif    // VEC2DIC_IVF_INDEX_H_
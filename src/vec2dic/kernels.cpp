@@ -0,0 +1,186 @@
+/** @file kernels.cpp
+ *
+ *  @brief portable distance kernels and runtime CPU dispatch.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/kernels.h"
+
+#include <cmath>                        // sqrt()
+#include <cstdlib>                      // std::getenv()
+#include <cstring>                      // strcmp()
+#include <iostream>                     // std::cerr
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute squared Euclidean distance between two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return squared Euclidean distance
+ */
+template <typename eT>
+static dist_t _sq_l2(const eT *a_vec1, const eT *a_vec2, size_t a_N) {
+  eT tmp_i, idistance = 0.;
+  for (size_t i = 0; i < a_N; ++i) {
+    tmp_i = a_vec1[i] - a_vec2[i];
+    idistance += tmp_i * tmp_i;
+  }
+  return idistance;
+}
+
+/**
+ * Compute dot product of two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return dot product
+ */
+template <typename eT>
+static dist_t _dot(const eT *a_vec1, const eT *a_vec2, size_t a_N) {
+  eT product = 0.;
+  for (size_t i = 0; i < a_N; ++i)
+    product += a_vec1[i] * a_vec2[i];
+
+  return product;
+}
+
+/**
+ * Compute cosine similarity of two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return cosine similarity
+ */
+template <typename eT>
+static dist_t _cos(const eT *a_vec1, const eT *a_vec2, size_t a_N) {
+  eT product = 0., norm1 = 0., norm2 = 0.;
+  for (size_t i = 0; i < a_N; ++i) {
+    product += a_vec1[i] * a_vec2[i];
+    norm1 += a_vec1[i] * a_vec1[i];
+    norm2 += a_vec2[i] * a_vec2[i];
+  }
+  if (norm1 == 0. || norm2 == 0.)
+    return 0.;
+
+  return product / sqrt(static_cast<dist_t>(norm1) * norm2);
+}
+
+/**
+ * Compute dot product of two 8-bit integer vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return dot product
+ */
+static int32_t _dot_i8(const int8_t *a_vec1, const int8_t *a_vec2,
+                       size_t a_N) {
+  int32_t product = 0;
+  for (size_t i = 0; i < a_N; ++i)
+    product += a_vec1[i] * a_vec2[i];
+
+  return product;
+}
+
+const kernels_t *generic_kernels() {
+  static const kernels_t kernels {
+#if defined(__x86_64__)
+    "sse2",
+#else
+    "generic",
+#endif
+    _sq_l2<float>, _sq_l2<double>,
+    _dot<float>, _dot<double>,
+    _cos<float>, _cos<double>,
+    _dot_i8
+  };
+  return &kernels;
+}
+
+/**
+ * Choose the fastest kernels supported by the CPU
+ *
+ * @return kernel table
+ */
+static const kernels_t *_find_kernels() {
+  const kernels_t *avx512 = avx512_kernels();
+  const kernels_t *avx2 = avx2_kernels();
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("avx512f"))
+    avx512 = nullptr;
+  if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma"))
+    avx2 = nullptr;
+#else
+  avx512 = avx2 = nullptr;
+#endif
+
+  const char *requested = std::getenv("VEC2DIC_KERNELS");
+  if (requested != nullptr && *requested) {
+    if (strcmp(requested, "generic") == 0)
+      return generic_kernels();
+    if (strcmp(requested, "avx2") == 0 && avx2 != nullptr)
+      return avx2;
+    if (strcmp(requested, "avx512") == 0 && avx512 != nullptr)
+      return avx512;
+
+    std::cerr << "Requested kernels '" << requested
+              << "' are not supported, falling back to automatic choice"
+              << std::endl;
+  }
+
+  if (avx512 != nullptr)
+    return avx512;
+  if (avx2 != nullptr)
+    return avx2;
+  return generic_kernels();
+}
+
+/**
+ * Choose the fastest kernels and complete the integer ones
+ *
+ * AVX-512F lacks byte multiplications, so that AVX-512 kernels use
+ * VNNI instructions for integer dot products if the CPU supports them
+ * and fall back to the AVX2 implementation otherwise.
+ *
+ * @return kernel table
+ */
+static kernels_t _select_kernels() {
+  kernels_t ret = *_find_kernels();
+  if (ret.m_dot_i8 != nullptr)
+    return ret;
+
+  i8kernel_t vnni = vnni_dot_i8();
+#if defined(__x86_64__) || defined(__i386__)
+  if (!__builtin_cpu_supports("avx512bw")
+      || !__builtin_cpu_supports("avx512vnni"))
+    vnni = nullptr;
+#endif
+  const kernels_t *avx2 = avx2_kernels();
+  if (vnni != nullptr)
+    ret.m_dot_i8 = vnni;
+  else if (avx2 != nullptr)
+    ret.m_dot_i8 = avx2->m_dot_i8;
+  else
+    ret.m_dot_i8 = generic_kernels()->m_dot_i8;
+  return ret;
+}
+
+///////////////
+// Variables //
+///////////////
+
+const kernels_t KERNELS = _select_kernels();
@@ -0,0 +1,169 @@
+/** @file kernels.h
+ *
+ *  @brief vectorized distance kernels with runtime CPU dispatch.
+ *
+ *  This file declares kernels for computing squared Euclidean
+ *  distances, dot products, and cosine similarities of dense vectors.
+ *  Each kernel is available in several variants (AVX-512, AVX2+FMA,
+ *  and a portable one, which the compiler vectorizes with SSE2 on
+ *  x86-64).  The fastest variant supported by the CPU is selected once
+ *  at program start, so that a single binary runs at full speed on
+ *  different machines.  Setting the environment variable
+ *  `VEC2DIC_KERNELS` to `avx512`, `avx2`, or `generic` overrides this
+ *  choice.
+ *
+ *  All floating-point kernels accumulate in the element type of their
+ *  arguments and return the result in double precision.  The dot
+ *  product of 8-bit integer vectors is computed exactly in 32-bit
+ *  integers (with AVX-512 VNNI instructions where available); its
+ *  arguments must not contain the value -128.
+ */
+
+#ifndef VEC2DIC_KERNELS_H_
+# define VEC2DIC_KERNELS_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <cstdint>        // int8_t, int32_t
+#include <cstdlib>        // size_t
+
+///////////
+// Types //
+///////////
+
+/** Binary kernel over two single-precision vectors */
+using fkernel_t = dist_t (*)(const float *, const float *, size_t);
+
+/** Binary kernel over two double-precision vectors */
+using dkernel_t = dist_t (*)(const double *, const double *, size_t);
+
+/** Binary kernel over two 8-bit integer vectors */
+using i8kernel_t = int32_t (*)(const int8_t *, const int8_t *, size_t);
+
+/**
+ * Table of kernels of one instruction set.
+ */
+using kernels_t = struct Kernels {
+  /// name of the instruction set
+  const char *m_isa;
+  /// squared Euclidean distance (single precision)
+  fkernel_t m_sq_l2_f;
+  /// squared Euclidean distance (double precision)
+  dkernel_t m_sq_l2_d;
+  /// dot product (single precision)
+  fkernel_t m_dot_f;
+  /// dot product (double precision)
+  dkernel_t m_dot_d;
+  /// cosine similarity (single precision)
+  fkernel_t m_cos_f;
+  /// cosine similarity (double precision)
+  dkernel_t m_cos_d;
+  /// dot product (8-bit integers)
+  i8kernel_t m_dot_i8;
+};
+
+///////////////
+// Variables //
+///////////////
+
+/** Kernels selected for the current CPU */
+extern const kernels_t KERNELS;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Return kernels of the portable implementation
+ *
+ * @return kernel table
+ */
+const kernels_t *generic_kernels();
+
+/**
+ * Return kernels using AVX2 and FMA instructions
+ *
+ * @return kernel table or \c nullptr if not compiled in
+ */
+const kernels_t *avx2_kernels();
+
+/**
+ * Return kernels using AVX-512F instructions
+ *
+ * @return kernel table or \c nullptr if not compiled in
+ */
+const kernels_t *avx512_kernels();
+
+/**
+ * Return dot product of 8-bit integers using AVX-512 VNNI instructions
+ *
+ * @return kernel or \c nullptr if not compiled in
+ */
+i8kernel_t vnni_dot_i8();
+
+/**
+ * Compute squared Euclidean distance between two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return squared Euclidean distance
+ */
+inline dist_t sq_l2_distance(const float *a_vec1, const float *a_vec2,
+                             size_t a_N) {
+  return KERNELS.m_sq_l2_f(a_vec1, a_vec2, a_N);
+}
+
+inline dist_t sq_l2_distance(const double *a_vec1, const double *a_vec2,
+                             size_t a_N) {
+  return KERNELS.m_sq_l2_d(a_vec1, a_vec2, a_N);
+}
+
+/**
+ * Compute dot product of two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return dot product
+ */
+inline dist_t dot_product(const float *a_vec1, const float *a_vec2,
+                          size_t a_N) {
+  return KERNELS.m_dot_f(a_vec1, a_vec2, a_N);
+}
+
+inline dist_t dot_product(const double *a_vec1, const double *a_vec2,
+                          size_t a_N) {
+  return KERNELS.m_dot_d(a_vec1, a_vec2, a_N);
+}
+
+inline int32_t dot_product(const int8_t *a_vec1, const int8_t *a_vec2,
+                           size_t a_N) {
+  return KERNELS.m_dot_i8(a_vec1, a_vec2, a_N);
+}
+
+/**
+ * Compute cosine similarity of two vectors
+ *
+ * @param a_vec1 - 1-st vector
+ * @param a_vec2 - 2-nd vector
+ * @param a_N - number of elements in each vector
+ *
+ * @return cosine similarity (0 if either vector is zero)
+ */
+inline dist_t cosine_similarity(const float *a_vec1, const float *a_vec2,
+                                size_t a_N) {
+  return KERNELS.m_cos_f(a_vec1, a_vec2, a_N);
+}
+
+inline dist_t cosine_similarity(const double *a_vec1, const double *a_vec2,
+                                size_t a_N) {
+  return KERNELS.m_cos_d(a_vec1, a_vec2, a_N);
+}
+
+#endif    // VEC2DIC_KERNELS_H_
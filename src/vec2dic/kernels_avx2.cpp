@@ -0,0 +1,230 @@
+/** @file kernels_avx2.cpp
+ *
+ *  @brief distance kernels using AVX2 and FMA instructions.
+ *
+ *  This file is compiled with `-mavx2 -mfma`; its kernels are only
+ *  called after the CPU has been checked for these extensions.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/kernels.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+# include <immintrin.h>                 // AVX2 intrinsics
+#endif
+
+#include <cmath>                        // sqrt()
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Sum up all lanes of a single-precision register
+ *
+ * @param a_v - register to reduce
+ *
+ * @return sum of the lanes
+ */
+static inline float _hsum(__m256 a_v) {
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(a_v),
+                         _mm256_extractf128_ps(a_v, 1));
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  return _mm_cvtss_f32(lo);
+}
+
+/**
+ * Sum up all lanes of a double-precision register
+ *
+ * @param a_v - register to reduce
+ *
+ * @return sum of the lanes
+ */
+static inline double _hsum(__m256d a_v) {
+  __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(a_v),
+                          _mm256_extractf128_pd(a_v, 1));
+  lo = _mm_add_sd(lo, _mm_unpackhi_pd(lo, lo));
+  return _mm_cvtsd_f64(lo);
+}
+
+static dist_t _sq_l2_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps(), diff;
+  size_t i = 0;
+  for (; i + 16 <= a_N; i += 16) {
+    diff = _mm256_sub_ps(_mm256_loadu_ps(a_vec1 + i),
+                         _mm256_loadu_ps(a_vec2 + i));
+    acc0 = _mm256_fmadd_ps(diff, diff, acc0);
+    diff = _mm256_sub_ps(_mm256_loadu_ps(a_vec1 + i + 8),
+                         _mm256_loadu_ps(a_vec2 + i + 8));
+    acc1 = _mm256_fmadd_ps(diff, diff, acc1);
+  }
+  for (; i + 8 <= a_N; i += 8) {
+    diff = _mm256_sub_ps(_mm256_loadu_ps(a_vec1 + i),
+                         _mm256_loadu_ps(a_vec2 + i));
+    acc0 = _mm256_fmadd_ps(diff, diff, acc0);
+  }
+  float ret = _hsum(_mm256_add_ps(acc0, acc1)), tmp_i;
+  for (; i < a_N; ++i) {
+    tmp_i = a_vec1[i] - a_vec2[i];
+    ret += tmp_i * tmp_i;
+  }
+  return ret;
+}
+
+static dist_t _sq_l2_d(const double *a_vec1, const double *a_vec2,
+                       size_t a_N) {
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd(), diff;
+  size_t i = 0;
+  for (; i + 8 <= a_N; i += 8) {
+    diff = _mm256_sub_pd(_mm256_loadu_pd(a_vec1 + i),
+                         _mm256_loadu_pd(a_vec2 + i));
+    acc0 = _mm256_fmadd_pd(diff, diff, acc0);
+    diff = _mm256_sub_pd(_mm256_loadu_pd(a_vec1 + i + 4),
+                         _mm256_loadu_pd(a_vec2 + i + 4));
+    acc1 = _mm256_fmadd_pd(diff, diff, acc1);
+  }
+  for (; i + 4 <= a_N; i += 4) {
+    diff = _mm256_sub_pd(_mm256_loadu_pd(a_vec1 + i),
+                         _mm256_loadu_pd(a_vec2 + i));
+    acc0 = _mm256_fmadd_pd(diff, diff, acc0);
+  }
+  double ret = _hsum(_mm256_add_pd(acc0, acc1)), tmp_i;
+  for (; i < a_N; ++i) {
+    tmp_i = a_vec1[i] - a_vec2[i];
+    ret += tmp_i * tmp_i;
+  }
+  return ret;
+}
+
+static dist_t _dot_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= a_N; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a_vec1 + i),
+                           _mm256_loadu_ps(a_vec2 + i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a_vec1 + i + 8),
+                           _mm256_loadu_ps(a_vec2 + i + 8), acc1);
+  }
+  for (; i + 8 <= a_N; i += 8)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a_vec1 + i),
+                           _mm256_loadu_ps(a_vec2 + i), acc0);
+
+  float ret = _hsum(_mm256_add_ps(acc0, acc1));
+  for (; i < a_N; ++i)
+    ret += a_vec1[i] * a_vec2[i];
+
+  return ret;
+}
+
+static dist_t _dot_d(const double *a_vec1, const double *a_vec2,
+                     size_t a_N) {
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= a_N; i += 8) {
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a_vec1 + i),
+                           _mm256_loadu_pd(a_vec2 + i), acc0);
+    acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(a_vec1 + i + 4),
+                           _mm256_loadu_pd(a_vec2 + i + 4), acc1);
+  }
+  for (; i + 4 <= a_N; i += 4)
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(a_vec1 + i),
+                           _mm256_loadu_pd(a_vec2 + i), acc0);
+
+  double ret = _hsum(_mm256_add_pd(acc0, acc1));
+  for (; i < a_N; ++i)
+    ret += a_vec1[i] * a_vec2[i];
+
+  return ret;
+}
+
+static dist_t _cos_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m256 prod = _mm256_setzero_ps(), norm1 = _mm256_setzero_ps(),
+      norm2 = _mm256_setzero_ps(), v1, v2;
+  size_t i = 0;
+  for (; i + 8 <= a_N; i += 8) {
+    v1 = _mm256_loadu_ps(a_vec1 + i);
+    v2 = _mm256_loadu_ps(a_vec2 + i);
+    prod = _mm256_fmadd_ps(v1, v2, prod);
+    norm1 = _mm256_fmadd_ps(v1, v1, norm1);
+    norm2 = _mm256_fmadd_ps(v2, v2, norm2);
+  }
+  float p = _hsum(prod), n1 = _hsum(norm1), n2 = _hsum(norm2);
+  for (; i < a_N; ++i) {
+    p += a_vec1[i] * a_vec2[i];
+    n1 += a_vec1[i] * a_vec1[i];
+    n2 += a_vec2[i] * a_vec2[i];
+  }
+  if (n1 == 0. || n2 == 0.)
+    return 0.;
+
+  return p / sqrt(static_cast<dist_t>(n1) * n2);
+}
+
+static dist_t _cos_d(const double *a_vec1, const double *a_vec2,
+                     size_t a_N) {
+  __m256d prod = _mm256_setzero_pd(), norm1 = _mm256_setzero_pd(),
+      norm2 = _mm256_setzero_pd(), v1, v2;
+  size_t i = 0;
+  for (; i + 4 <= a_N; i += 4) {
+    v1 = _mm256_loadu_pd(a_vec1 + i);
+    v2 = _mm256_loadu_pd(a_vec2 + i);
+    prod = _mm256_fmadd_pd(v1, v2, prod);
+    norm1 = _mm256_fmadd_pd(v1, v1, norm1);
+    norm2 = _mm256_fmadd_pd(v2, v2, norm2);
+  }
+  double p = _hsum(prod), n1 = _hsum(norm1), n2 = _hsum(norm2);
+  for (; i < a_N; ++i) {
+    p += a_vec1[i] * a_vec2[i];
+    n1 += a_vec1[i] * a_vec1[i];
+    n2 += a_vec2[i] * a_vec2[i];
+  }
+  if (n1 == 0. || n2 == 0.)
+    return 0.;
+
+  return p / sqrt(n1 * n2);
+}
+
+static int32_t _dot_i8(const int8_t *a_vec1, const int8_t *a_vec2,
+                       size_t a_N) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  __m256i acc = _mm256_setzero_si256(), v1, v2, prod;
+  size_t i = 0;
+  for (; i + 32 <= a_N; i += 32) {
+    v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_vec1 + i));
+    v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a_vec2 + i));
+    // `maddubs` multiplies unsigned by signed bytes, so the sign of the
+    // first vector is moved to the second one
+    prod = _mm256_maddubs_epi16(_mm256_sign_epi8(v1, v1),
+                                _mm256_sign_epi8(v2, v1));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(prod, ones));
+  }
+  __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                             _mm256_extracti128_si256(acc, 1));
+  lo = _mm_add_epi32(lo, _mm_unpackhi_epi64(lo, lo));
+  lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, 1));
+  int32_t ret = _mm_cvtsi128_si32(lo);
+  for (; i < a_N; ++i)
+    ret += a_vec1[i] * a_vec2[i];
+
+  return ret;
+}
+
+const kernels_t *avx2_kernels() {
+  static const kernels_t kernels {
+    "avx2", _sq_l2_f, _sq_l2_d, _dot_f, _dot_d, _cos_f, _cos_d, _dot_i8
+  };
+  return &kernels;
+}
+
+#else
+
+const kernels_t *avx2_kernels() {
+  return nullptr;
+}
+
+#endif    // __AVX2__ && __FMA__
@@ -0,0 +1,215 @@
+/** @file kernels_avx512.cpp
+ *
+ *  @brief distance kernels using AVX-512F instructions.
+ *
+ *  This file is compiled with `-mavx512f`; its kernels are only called
+ *  after the CPU has been checked for this extension.  Trailing
+ *  elements are processed with masked loads, so no scalar epilogue is
+ *  needed.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/kernels.h"
+
+#if defined(__AVX512F__)
+# include <immintrin.h>                 // AVX-512 intrinsics
+#endif
+
+#include <cmath>                        // sqrt()
+
+#if defined(__AVX512F__)
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute mask selecting the first `a_n` lanes of a register
+ *
+ * @param a_n - number of lanes to select (less than the register width)
+ *
+ * @return lane mask
+ */
+static inline __mmask16 _fmask(size_t a_n) {
+  return static_cast<__mmask16>((1U << a_n) - 1);
+}
+
+static inline __mmask8 _dmask(size_t a_n) {
+  return static_cast<__mmask8>((1U << a_n) - 1);
+}
+
+/**
+ * Sum up all lanes of a single-precision register
+ *
+ * (`_mm512_reduce_add_ps()` and unmasked extractions are avoided as
+ * they trigger spurious `-Wuninitialized` warnings with GCC 12.)
+ *
+ * @param a_v - register to reduce
+ *
+ * @return sum of the lanes
+ */
+static inline float _hsum(__m512 a_v) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m512d v512 = _mm512_castps_pd(a_v);
+  const __m256 v = _mm256_add_ps(
+      _mm256_castpd_ps(_mm512_mask_extractf64x4_pd(zero, 0xFF, v512, 0)),
+      _mm256_castpd_ps(_mm512_mask_extractf64x4_pd(zero, 0xFF, v512, 1)));
+  __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v),
+                         _mm256_extractf128_ps(v, 1));
+  lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+  lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+  return _mm_cvtss_f32(lo);
+}
+
+/**
+ * Sum up all lanes of a double-precision register
+ *
+ * @param a_v - register to reduce
+ *
+ * @return sum of the lanes
+ */
+static inline double _hsum(__m512d a_v) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d v = _mm256_add_pd(
+      _mm512_mask_extractf64x4_pd(zero, 0xFF, a_v, 0),
+      _mm512_mask_extractf64x4_pd(zero, 0xFF, a_v, 1));
+  __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v),
+                          _mm256_extractf128_pd(v, 1));
+  lo = _mm_add_sd(lo, _mm_unpackhi_pd(lo, lo));
+  return _mm_cvtsd_f64(lo);
+}
+
+static dist_t _sq_l2_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m512 acc = _mm512_setzero_ps(), diff;
+  size_t i = 0;
+  for (; i + 16 <= a_N; i += 16) {
+    diff = _mm512_sub_ps(_mm512_loadu_ps(a_vec1 + i),
+                         _mm512_loadu_ps(a_vec2 + i));
+    acc = _mm512_fmadd_ps(diff, diff, acc);
+  }
+  if (i < a_N) {
+    const __mmask16 mask = _fmask(a_N - i);
+    diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a_vec1 + i),
+                         _mm512_maskz_loadu_ps(mask, a_vec2 + i));
+    acc = _mm512_fmadd_ps(diff, diff, acc);
+  }
+  return _hsum(acc);
+}
+
+static dist_t _sq_l2_d(const double *a_vec1, const double *a_vec2,
+                       size_t a_N) {
+  __m512d acc = _mm512_setzero_pd(), diff;
+  size_t i = 0;
+  for (; i + 8 <= a_N; i += 8) {
+    diff = _mm512_sub_pd(_mm512_loadu_pd(a_vec1 + i),
+                         _mm512_loadu_pd(a_vec2 + i));
+    acc = _mm512_fmadd_pd(diff, diff, acc);
+  }
+  if (i < a_N) {
+    const __mmask8 mask = _dmask(a_N - i);
+    diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, a_vec1 + i),
+                         _mm512_maskz_loadu_pd(mask, a_vec2 + i));
+    acc = _mm512_fmadd_pd(diff, diff, acc);
+  }
+  return _hsum(acc);
+}
+
+static dist_t _dot_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m512 acc = _mm512_setzero_ps();
+  size_t i = 0;
+  for (; i + 16 <= a_N; i += 16)
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(a_vec1 + i),
+                          _mm512_loadu_ps(a_vec2 + i), acc);
+
+  if (i < a_N) {
+    const __mmask16 mask = _fmask(a_N - i);
+    acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a_vec1 + i),
+                          _mm512_maskz_loadu_ps(mask, a_vec2 + i), acc);
+  }
+  return _hsum(acc);
+}
+
+static dist_t _dot_d(const double *a_vec1, const double *a_vec2,
+                     size_t a_N) {
+  __m512d acc = _mm512_setzero_pd();
+  size_t i = 0;
+  for (; i + 8 <= a_N; i += 8)
+    acc = _mm512_fmadd_pd(_mm512_loadu_pd(a_vec1 + i),
+                          _mm512_loadu_pd(a_vec2 + i), acc);
+
+  if (i < a_N) {
+    const __mmask8 mask = _dmask(a_N - i);
+    acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a_vec1 + i),
+                          _mm512_maskz_loadu_pd(mask, a_vec2 + i), acc);
+  }
+  return _hsum(acc);
+}
+
+static dist_t _cos_f(const float *a_vec1, const float *a_vec2, size_t a_N) {
+  __m512 prod = _mm512_setzero_ps(), norm1 = _mm512_setzero_ps(),
+      norm2 = _mm512_setzero_ps(), v1, v2;
+  size_t i = 0;
+  for (; i < a_N; i += 16) {
+    if (i + 16 <= a_N) {
+      v1 = _mm512_loadu_ps(a_vec1 + i);
+      v2 = _mm512_loadu_ps(a_vec2 + i);
+    } else {
+      const __mmask16 mask = _fmask(a_N - i);
+      v1 = _mm512_maskz_loadu_ps(mask, a_vec1 + i);
+      v2 = _mm512_maskz_loadu_ps(mask, a_vec2 + i);
+    }
+    prod = _mm512_fmadd_ps(v1, v2, prod);
+    norm1 = _mm512_fmadd_ps(v1, v1, norm1);
+    norm2 = _mm512_fmadd_ps(v2, v2, norm2);
+  }
+  const float n1 = _hsum(norm1);
+  const float n2 = _hsum(norm2);
+  if (n1 == 0. || n2 == 0.)
+    return 0.;
+
+  return _hsum(prod) / sqrt(static_cast<dist_t>(n1) * n2);
+}
+
+static dist_t _cos_d(const double *a_vec1, const double *a_vec2,
+                     size_t a_N) {
+  __m512d prod = _mm512_setzero_pd(), norm1 = _mm512_setzero_pd(),
+      norm2 = _mm512_setzero_pd(), v1, v2;
+  size_t i = 0;
+  for (; i < a_N; i += 8) {
+    if (i + 8 <= a_N) {
+      v1 = _mm512_loadu_pd(a_vec1 + i);
+      v2 = _mm512_loadu_pd(a_vec2 + i);
+    } else {
+      const __mmask8 mask = _dmask(a_N - i);
+      v1 = _mm512_maskz_loadu_pd(mask, a_vec1 + i);
+      v2 = _mm512_maskz_loadu_pd(mask, a_vec2 + i);
+    }
+    prod = _mm512_fmadd_pd(v1, v2, prod);
+    norm1 = _mm512_fmadd_pd(v1, v1, norm1);
+    norm2 = _mm512_fmadd_pd(v2, v2, norm2);
+  }
+  const double n1 = _hsum(norm1);
+  const double n2 = _hsum(norm2);
+  if (n1 == 0. || n2 == 0.)
+    return 0.;
+
+  return _hsum(prod) / sqrt(n1 * n2);
+}
+
+const kernels_t *avx512_kernels() {
+  static const kernels_t kernels {
+    "avx512", _sq_l2_f, _sq_l2_d, _dot_f, _dot_d, _cos_f, _cos_d,
+    nullptr                     // chosen at runtime (see kernels.cpp)
+  };
+  return &kernels;
+}
+
+#else
+
+const kernels_t *avx512_kernels() {
+  return nullptr;
+}
+
+#endif    // __AVX512F__
@@ -0,0 +1,66 @@
+/** @file kernels_vnni.cpp
+ *
+ *  @brief integer kernels using AVX-512 VNNI instructions.
+ *
+ *  This file is compiled with `-mavx512f -mavx512bw -mavx512vnni`; its
+ *  kernels are only called after the CPU has been checked for these
+ *  extensions.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/kernels.h"
+
+#if defined(__AVX512BW__) && defined(__AVX512VNNI__)
+# include <immintrin.h>                 // AVX-512 intrinsics
+
+/////////////
+// Methods //
+/////////////
+
+static int32_t _dot_i8(const int8_t *a_vec1, const int8_t *a_vec2,
+                       size_t a_N) {
+  // `dpbusd` multiplies unsigned by signed bytes, so the first vector
+  // is shifted by 128 and 128 times the sum of the second one is
+  // subtracted afterwards
+  const __m512i bias = _mm512_set1_epi8(-128);
+  __m512i acc = _mm512_setzero_si512(), corr = _mm512_setzero_si512(),
+      v1, v2;
+  size_t i = 0;
+  for (; i < a_N; i += 64) {
+    if (i + 64 <= a_N) {
+      v1 = _mm512_loadu_si512(a_vec1 + i);
+      v2 = _mm512_loadu_si512(a_vec2 + i);
+    } else {
+      const __mmask64 mask = (~0ULL) >> (64 - (a_N - i));
+      v1 = _mm512_maskz_loadu_epi8(mask, a_vec1 + i);
+      v2 = _mm512_maskz_loadu_epi8(mask, a_vec2 + i);
+    }
+    acc = _mm512_dpbusd_epi32(acc, _mm512_xor_si512(v1, bias), v2);
+    corr = _mm512_dpbusd_epi32(corr, bias, v2);
+  }
+  acc = _mm512_sub_epi32(acc, corr);
+
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i half = _mm256_add_epi32(
+      _mm512_mask_extracti64x4_epi64(zero, 0xFF, acc, 0),
+      _mm512_mask_extracti64x4_epi64(zero, 0xFF, acc, 1));
+  __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(half),
+                             _mm256_extracti128_si256(half, 1));
+  lo = _mm_add_epi32(lo, _mm_unpackhi_epi64(lo, lo));
+  lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, 1));
+  return _mm_cvtsi128_si32(lo);
+}
+
+i8kernel_t vnni_dot_i8() {
+  return _dot_i8;
+}
+
+#else
+
+i8kernel_t vnni_dot_i8() {
+  return nullptr;
+}
+
+#endif    // __AVX512BW__ && __AVX512VNNI__
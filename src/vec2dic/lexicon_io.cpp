@@ -0,0 +1,176 @@
+/** @file lexicon_io.cpp
+ *
+ *  @brief reading seed sets and writing sentiment lexicons.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/lexicon_io.h"
+
+#include <cctype>         // std::isspace()
+#include <cstring>        // strlen()
+
+#include <algorithm>      // std::find_if(), std::transform()
+#include <fstream>        // std::ifstream
+#include <functional>     // std::not1(), std::ptr_fun()
+#include <iostream>       // std::cerr
+#include <stdexcept>      // std::domain_error()
+#include <utility>        // std::make_pair
+
+///////////////
+// Constants //
+///////////////
+
+/// string representing positive polarity class
+static const char *positive  = "positive";
+/// string representing negative polarity class
+static const char *negative = "negative";
+/// string representing neutral polarity class
+static const char *neutral = "neutral";
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Auxiliary function for removing blanks from the left end of a string
+ *
+ * @param s - string to be trimmed
+ *
+ * @return reference to the original string with leading blanks truncated
+ */
+static inline std::string *ltrim(std::string *s) {
+  s->erase(s->begin(),
+           std::find_if(s->begin(), s->end(),
+                        std::not1(std::ptr_fun<int, int>(std::isspace))));
+  return s;
+}
+
+/**
+ * Auxiliary function for removing blanks from the right end of a string
+ *
+ * @param s - string to be trimmed
+ *
+ * @return reference to the original string with trailing blanks truncated
+ */
+static inline std::string *rtrim(std::string *s) {
+  s->erase(std::find_if(s->rbegin(), s->rend(),
+                        std::not1(std::ptr_fun<int, int>(std::isspace))).base(),
+           s->end());
+  return s;
+}
+
+/**
+ * Auxiliary function for removing blanks from both ends of a string
+ *
+ * @param s - string to be trimmed
+ *
+ * @return original string with leading and trailing blanks removed
+ */
+static inline std::string *normalize(std::string *s) {
+  // strip leading and trailing whitespaces
+  ltrim(rtrim(s));
+  // downcase the string
+  std::transform(s->begin(), s->end(), s->begin(), ::tolower);;
+  return s;
+}
+
+int parse_seed_line(std::string *a_line, w2ps_t *a_word2polscore) {
+  std::string &iline = *a_line;
+  Polarity ipol;
+  size_t tab_pos, tab_pos_orig;
+
+  if (iline.empty() || iline.compare(0, 3, "###") == 0)
+    return 0;
+
+  // remove leading and trailing whitespaces
+  normalize(&iline);
+  // find first tab character
+  tab_pos = iline.find_first_of('\t');
+  tab_pos_orig = tab_pos;
+  // skip leading whitespaces
+  while (iline[++tab_pos] && std::isspace(iline[tab_pos])) {}
+  if (tab_pos == std::string::npos || !iline[tab_pos]) {
+    std::cerr << "Incorrect line format (missing polarity): "
+              << iline << std::endl;
+    return 1;
+  }
+  // determine polarity class
+  if (iline.compare(tab_pos, strlen(positive), positive) == 0) {
+    ipol = Polarity::POSITIVE;
+  } else if (iline.compare(tab_pos, strlen(negative), negative) == 0) {
+    ipol = Polarity::NEGATIVE;
+  } else if (iline.compare(tab_pos, strlen(neutral), neutral) == 0) {
+    ipol = Polarity::NEUTRAL;
+  } else {
+    std::cerr << "Unrecognized polarity class at line '"
+              << iline.substr(tab_pos) << "'" << std::endl;
+    return 1;
+  }
+
+  while (tab_pos_orig > 0
+         && std::isspace(iline[tab_pos_orig])) {--tab_pos_orig;}
+  if (tab_pos_orig == 0 && std::isspace(iline[tab_pos_orig])) {
+    std::cerr << "Incorrect line format (missing word): "
+              << iline << std::endl;
+    return 1;
+  }
+  ++tab_pos_orig;
+  a_word2polscore->emplace(
+      std::move(iline.substr(0, tab_pos_orig)),
+      std::make_pair(ipol, 0.));
+  return 0;
+}
+
+int read_seed_set(const char *a_fname, w2ps_t *a_word2polscore) {
+  std::string iline;
+
+  std::cerr << "Reading seed set file ...";
+
+  std::ifstream is(a_fname);
+  if (!is) {
+    std::cerr << "Cannot open file " << a_fname << std::endl;
+    goto error_exit;
+  }
+
+  // read input file
+  while (std::getline(is, iline)) {
+    if (parse_seed_line(&iline, a_word2polscore))
+      goto error_exit;
+  }
+
+  if (!is.eof() && is.fail()) {
+    std::cerr << "Failed to read seed set file " << a_fname << std::endl;
+    goto error_exit;
+  }
+  is.close();
+  std::cerr << "done (read " << a_word2polscore->size() << " entries)"
+            << std::endl;
+  return 0;
+
+ error_exit:
+  is.close();        // basic guarantee
+  a_word2polscore->clear();
+  return 1;
+}
+
+void output_terms(std::ostream &a_stream, const lexicon_t *a_lexicon) {
+  for (auto &entry : *a_lexicon) {
+    switch (entry.m_polarity) {
+      case Polarity::POSITIVE:
+        a_stream << entry.m_word << '\t' << positive << '\t'
+                 << entry.m_score;
+        break;
+      case Polarity::NEGATIVE:
+        a_stream << entry.m_word << '\t' << negative << '\t'
+                 << entry.m_score;
+        break;
+      case Polarity::NEUTRAL:
+        continue;
+    default:
+      throw std::domain_error("Unknown polarity type");
+    }
+    a_stream << std::endl;
+  }
+}
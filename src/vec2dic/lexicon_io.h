@@ -0,0 +1,62 @@
+/** @file lexicon_io.h
+ *
+ *  @brief reading seed sets and writing sentiment lexicons.
+ *
+ *  Seed sets consist of lines with a term and its polarity class
+ *  (`positive`, `negative`, or `neutral`) separated by a tab; empty
+ *  lines and lines starting with `###` are ignored.  Lexicons are
+ *  written as lines with a term, its polarity class, and its score
+ *  separated by tabs.
+ */
+
+#ifndef VEC2DIC_LEXICON_IO_H_
+# define VEC2DIC_LEXICON_IO_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expander.h"
+#include "src/vec2dic/expansion.h"
+
+#include <ostream>        // std::ostream
+#include <string>         // std::string
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Parse a single line of a seed set
+ *
+ * The line is normalized (trimmed and lowercased) in place.  Empty
+ * lines and comments are silently skipped.
+ *
+ * @param a_line - line to parse
+ * @param a_word2polscore - map to which the seed term should be added
+ *
+ * @return \c 0 on success, non-\c 0 if the line is malformed
+ */
+int parse_seed_line(std::string *a_line, w2ps_t *a_word2polscore);
+
+/**
+ * Read seed set of polarity terms
+ *
+ * @param a_fname - name of the seed file
+ * @param a_word2polscore - map to populate with seed terms and their
+ *                      polarities
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int read_seed_set(const char *a_fname, w2ps_t *a_word2polscore);
+
+/**
+ * Output polar terms of a lexicon
+ *
+ * @param a_stream - output stream to use
+ * @param a_lexicon - ranked lexicon
+ *
+ * @return \c void
+ */
+void output_terms(std::ostream &a_stream, const lexicon_t *a_lexicon);
+
+#endif    // VEC2DIC_LEXICON_IO_H_
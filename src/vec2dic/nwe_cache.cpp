@@ -0,0 +1,420 @@
+/** @file nwe_cache.cpp
+ *
+ *  @brief on-disk cache of preprocessed word embeddings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/nwe_cache.h"
+#include "src/vec2dic/nwe_file.h"
+
+#include <dirent.h>                     // opendir(), readdir()
+#include <sys/stat.h>                   // mkdir(), stat()
+#include <unistd.h>                     // getpid(), unlink()
+
+#include <cerrno>                       // errno, EEXIST
+#include <climits>                      // PATH_MAX
+#include <cstdint>                      // uint32_t, uint64_t
+#include <cstdio>                       // rename()
+#include <cstring>                      // memcmp(), memcpy(), memset()
+#include <fstream>                      // std::ifstream, std::ofstream
+#include <iostream>                     // std::cerr
+#include <sstream>                      // std::ostringstream
+#include <vector>                       // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Kind of a cache entry.
+ */
+enum CacheKind: uint32_t {
+  CACHE_NORM = 1,               ///< normalization of word vectors
+  CACHE_PCA = 2                 ///< principal components
+};
+
+/**
+ * Header of a cache entry (except for binary vector files, which
+ * have their own header).
+ */
+using cache_header_t = struct CacheHeader {
+  /// magic bytes identifying the format
+  char m_magic[8];
+  /// version of the format
+  uint32_t m_version;
+  /// kind of the entry (one of `CacheKind`)
+  uint32_t m_kind;
+  /// size of a single element in bytes (4 or 8)
+  uint32_t m_elem_size;
+  /// contents of the entry (`NWEFlags` of normalizations, 1 if a basis
+  /// comes with projections)
+  uint32_t m_flags;
+  /// number of coordinates per vector
+  uint64_t m_n_rows;
+  /// number of vectors
+  uint64_t m_n_cols;
+  /// number of principal components
+  uint64_t m_n_components;
+  /// elongation coefficient of a normalization
+  double m_coefficient;
+};
+
+///////////////
+// Constants //
+///////////////
+
+/** Magic bytes identifying cache entries */
+static const char CACHE_MAGIC[8] = {'V', '2', 'D', 'C', 'A', 'C', 'H',
+                                    'E'};
+
+/** Current version of the format of cache entries */
+static const uint32_t CACHE_VERSION = 1;
+
+/** Offset basis and prime of the 64-bit FNV-1a hash */
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute FNV-1a hash of a string
+ *
+ * @param a_str - string to hash
+ *
+ * @return hash value
+ */
+static uint64_t _hash(const std::string &a_str) {
+  uint64_t hash = FNV_OFFSET;
+  for (const char c : a_str) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Remove entries of previous versions of a vector file
+ *
+ * @param a_dir - cache directory
+ * @param a_file_prefix - prefix shared by all versions of the file
+ * @param a_prefix - prefix of the current version
+ *
+ * @return \c void
+ */
+static void _remove_stale_entries(const std::string &a_dir,
+                                  const std::string &a_file_prefix,
+                                  const std::string &a_prefix) {
+  DIR *dir = opendir(a_dir.c_str());
+  if (dir == nullptr)
+    return;
+
+  std::vector<std::string> stale;
+  const struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    const std::string name = entry->d_name;
+    if (name.compare(0, a_file_prefix.size(), a_file_prefix) == 0
+        && name.compare(0, a_prefix.size(), a_prefix) != 0)
+      stale.push_back(name);
+  }
+  closedir(dir);
+  // entries which are still in use stay valid until they are unmapped
+  for (auto &name : stale)
+    unlink((a_dir + '/' + name).c_str());
+}
+
+/**
+ * Write header and payload of a cache entry
+ *
+ * @param a_fname - path of the entry
+ * @param a_header - header of the entry
+ * @param a_parts - pointers to the parts of the payload
+ * @param a_sizes - sizes of the parts in bytes
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+static int _write_entry(const std::string &a_fname,
+                        const cache_header_t *a_header,
+                        const std::vector<const void *> &a_parts,
+                        const std::vector<size_t> &a_sizes) {
+  const std::string tmp_fname = nwe_cache_tmp_fname(a_fname);
+  std::ofstream os(tmp_fname, std::ios::binary | std::ios::trunc);
+  if (!os) {
+    std::cerr << "Cannot open file " << tmp_fname << std::endl;
+    return 1;
+  }
+  os.write(reinterpret_cast<const char *>(a_header), sizeof(*a_header));
+  for (size_t i = 0; i < a_parts.size(); ++i)
+    os.write(static_cast<const char *>(a_parts[i]), a_sizes[i]);
+  os.close();
+  if (os.fail()) {
+    std::cerr << "Failed to write cache entry " << tmp_fname << std::endl;
+    unlink(tmp_fname.c_str());
+    return 1;
+  }
+  return commit_nwe_cache_file(tmp_fname, a_fname);
+}
+
+/**
+ * Initialize header of a cache entry
+ *
+ * @param a_header - header to initialize
+ * @param a_kind - kind of the entry
+ *
+ * @return \c void
+ */
+static void _init_header(cache_header_t *a_header, const CacheKind a_kind) {
+  memset(a_header, 0, sizeof(*a_header));
+  memcpy(a_header->m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  a_header->m_version = CACHE_VERSION;
+  a_header->m_kind = a_kind;
+}
+
+/**
+ * Open cache entry and read its header
+ *
+ * @param a_is - stream to open
+ * @param a_header - header to populate
+ * @param a_fname - path of the entry
+ * @param a_kind - expected kind of the entry
+ * @param a_n_rows - expected number of coordinates of a vector
+ * @param a_n_cols - expected number of vectors
+ *
+ * @return \c 0 on success, non-\c 0 if the entry does not exist or
+ *   does not match
+ */
+static int _read_header(std::ifstream *a_is, cache_header_t *a_header,
+                        const std::string &a_fname, const CacheKind a_kind,
+                        const size_t a_n_rows, const size_t a_n_cols) {
+  a_is->open(a_fname, std::ios::binary);
+  if (!*a_is)
+    return 1;
+
+  if (!a_is->read(reinterpret_cast<char *>(a_header), sizeof(*a_header))
+      || memcmp(a_header->m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+      || a_header->m_version != CACHE_VERSION
+      || a_header->m_kind != a_kind
+      || a_header->m_n_rows != a_n_rows
+      || a_header->m_n_cols != a_n_cols) {
+    std::cerr << "Cache entry " << a_fname << " does not match the"
+        " vectors and will be rebuilt" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Determine number of bytes left to read in a cache entry
+ *
+ * @param a_is - stream positioned after the header of the entry
+ *
+ * @return number of bytes between the current position and the end of
+ *   the stream
+ */
+static uint64_t _remaining_size(std::ifstream *a_is) {
+  const std::streampos pos = a_is->tellg();
+  a_is->seekg(0, std::ios::end);
+  const std::streampos end = a_is->tellg();
+  a_is->seekg(pos);
+  return end - pos;
+}
+
+int nwe_file_id(const char *a_fname, std::string *a_file_id,
+                std::string *a_version_id) {
+  struct stat st;
+  char path[PATH_MAX];
+  if (stat(a_fname, &st) != 0 || realpath(a_fname, path) == nullptr) {
+    std::cerr << "Cannot access file " << a_fname << std::endl;
+    return 1;
+  }
+
+  // the path identifies the file, its size and modification time
+  // identify the version of its contents
+  std::ostringstream id;
+  id << std::hex << _hash(path);
+  *a_file_id = id.str();
+  id << '-' << st.st_size << '-' << st.st_mtim.tv_sec << '-'
+     << st.st_mtim.tv_nsec;
+  *a_version_id = id.str();
+  return 0;
+}
+
+int open_nwe_cache(nwe_cache_t *a_cache, const char *a_dir,
+                   const char *a_fname) {
+  std::string file_id, version_id;
+  if (nwe_file_id(a_fname, &file_id, &version_id))
+    return 1;
+  if (mkdir(a_dir, 0777) != 0 && errno != EEXIST) {
+    std::cerr << "Cannot create cache directory " << a_dir << std::endl;
+    return 1;
+  }
+
+  a_cache->m_dir = a_dir;
+  a_cache->m_prefix = version_id + '.';
+  _remove_stale_entries(a_cache->m_dir, file_id + '-', a_cache->m_prefix);
+  return 0;
+}
+
+std::string nwe_cache_fname(const nwe_cache_t *a_cache,
+                            const std::string &a_artifact) {
+  return a_cache->m_dir + '/' + a_cache->m_prefix + a_artifact;
+}
+
+std::string nwe_cache_tmp_fname(const std::string &a_fname) {
+  return a_fname + ".tmp" + std::to_string(getpid());
+}
+
+int commit_nwe_cache_file(const std::string &a_tmp_fname,
+                          const std::string &a_fname) {
+  if (rename(a_tmp_fname.c_str(), a_fname.c_str()) != 0) {
+    std::cerr << "Cannot rename file " << a_tmp_fname << " to "
+              << a_fname << std::endl;
+    unlink(a_tmp_fname.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+std::string nwe_norm_key(const size_t a_elem_size,
+                         const bool a_length_normalize,
+                         const bool a_mean_normalize,
+                         const double a_coefficient) {
+  std::ostringstream key;
+  key.precision(17);
+  key << 'f' << 8 * a_elem_size << ".L" << a_length_normalize << ".M"
+      << a_mean_normalize << ".c" << a_coefficient;
+  return key.str();
+}
+
+template <typename eT>
+int save_nwe_norm(const std::string &a_fname, const nwe_norm_t<eT> *a_norm,
+                  const size_t a_n_rows, const size_t a_n_cols) {
+  cache_header_t header;
+  _init_header(&header, CACHE_NORM);
+  header.m_elem_size = sizeof(eT);
+  header.m_n_rows = a_n_rows;
+  header.m_n_cols = a_n_cols;
+  header.m_coefficient = a_norm->m_coefficient;
+  if (!a_norm->m_lengths.empty())
+    header.m_flags |= NWE_LENGTH_NORMALIZED;
+  if (!a_norm->m_means.empty())
+    header.m_flags |= NWE_MEAN_NORMALIZED;
+
+  const std::vector<const void *> parts {
+    a_norm->m_lengths.data(), a_norm->m_means.data(),
+    a_norm->m_inv_stddevs.data()};
+  const std::vector<size_t> sizes {
+    a_norm->m_lengths.size() * sizeof(eT),
+    a_norm->m_means.size() * sizeof(eT),
+    a_norm->m_inv_stddevs.size() * sizeof(eT)};
+  return _write_entry(a_fname, &header, parts, sizes);
+}
+
+template <typename eT>
+int load_nwe_norm(const std::string &a_fname, nwe_norm_t<eT> *a_norm,
+                  const size_t a_n_rows, const size_t a_n_cols) {
+  cache_header_t header;
+  std::ifstream is;
+  if (_read_header(&is, &header, a_fname, CACHE_NORM, a_n_rows, a_n_cols)
+      || header.m_elem_size != sizeof(eT))
+    return 1;
+
+  *a_norm = nwe_norm_t<eT>();
+  a_norm->m_coefficient = static_cast<eT>(header.m_coefficient);
+  if (header.m_flags & NWE_LENGTH_NORMALIZED)
+    a_norm->m_lengths.resize(a_n_cols);
+  if (header.m_flags & NWE_MEAN_NORMALIZED) {
+    a_norm->m_means.resize(a_n_rows);
+    a_norm->m_inv_stddevs.resize(a_n_rows);
+  }
+  is.read(reinterpret_cast<char *>(a_norm->m_lengths.data()),
+          a_norm->m_lengths.size() * sizeof(eT));
+  is.read(reinterpret_cast<char *>(a_norm->m_means.data()),
+          a_norm->m_means.size() * sizeof(eT));
+  is.read(reinterpret_cast<char *>(a_norm->m_inv_stddevs.data()),
+          a_norm->m_inv_stddevs.size() * sizeof(eT));
+  if (!is) {
+    std::cerr << "Incorrect cache entry " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    *a_norm = nwe_norm_t<eT>();
+    return 1;
+  }
+  return 0;
+}
+
+int save_pca_basis(const std::string &a_fname,
+                   const pca_basis_t *a_basis) {
+  cache_header_t header;
+  _init_header(&header, CACHE_PCA);
+  header.m_elem_size = sizeof(double);
+  header.m_n_rows = a_basis->m_components.n_rows;
+  header.m_n_components = a_basis->m_components.n_cols;
+  header.m_n_cols = a_basis->m_projections.n_rows;
+  header.m_flags = a_basis->m_projections.is_empty()? 0: 1;
+
+  const std::vector<const void *> parts {
+    a_basis->m_mean.memptr(), a_basis->m_components.memptr(),
+    a_basis->m_projections.memptr()};
+  const std::vector<size_t> sizes {
+    a_basis->m_mean.n_elem * sizeof(double),
+    a_basis->m_components.n_elem * sizeof(double),
+    a_basis->m_projections.n_elem * sizeof(double)};
+  return _write_entry(a_fname, &header, parts, sizes);
+}
+
+int load_pca_basis(const std::string &a_fname, pca_basis_t *a_basis,
+                   const size_t a_n_rows, const size_t a_n_cols) {
+  cache_header_t header;
+  std::ifstream is;
+  if (_read_header(&is, &header, a_fname, CACHE_PCA, a_n_rows, a_n_cols)
+      || header.m_elem_size != sizeof(double) || header.m_flags != 1)
+    return 1;
+
+  // there cannot be more components than coordinates, which also keeps
+  // the sizes below from overflowing
+  const uint64_t n_components = header.m_n_components;
+  if (n_components == 0 || n_components > a_n_rows
+      || _remaining_size(&is) != (a_n_rows + (a_n_rows + a_n_cols)
+                                  * n_components) * sizeof(double)) {
+    std::cerr << "Incorrect cache entry " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    return 1;
+  }
+
+  a_basis->m_mean.set_size(a_n_rows);
+  a_basis->m_components.set_size(a_n_rows, n_components);
+  a_basis->m_projections.set_size(a_n_cols, n_components);
+  is.read(reinterpret_cast<char *>(a_basis->m_mean.memptr()),
+          a_basis->m_mean.n_elem * sizeof(double));
+  is.read(reinterpret_cast<char *>(a_basis->m_components.memptr()),
+          a_basis->m_components.n_elem * sizeof(double));
+  is.read(reinterpret_cast<char *>(a_basis->m_projections.memptr()),
+          a_basis->m_projections.n_elem * sizeof(double));
+  if (!is) {
+    std::cerr << "Incorrect cache entry " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    *a_basis = pca_basis_t();
+    return 1;
+  }
+  return 0;
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template int save_nwe_norm<float>(const std::string &,
+                                  const nwe_norm_t<float> *, const size_t,
+                                  const size_t);
+template int save_nwe_norm<double>(const std::string &,
+                                   const nwe_norm_t<double> *, const size_t,
+                                   const size_t);
+
+template int load_nwe_norm<float>(const std::string &, nwe_norm_t<float> *,
+                                  const size_t, const size_t);
+template int load_nwe_norm<double>(const std::string &,
+                                   nwe_norm_t<double> *, const size_t,
+                                   const size_t);
@@ -0,0 +1,186 @@
+/** @file nwe_cache.h
+ *
+ *  @brief on-disk cache of preprocessed word embeddings.
+ *
+ *  This file declares methods for keeping the results of
+ *  preprocessing a vector file in a cache directory, so that repeated
+ *  runs over the same file skip parsing, normalization, and the
+ *  principal components.  The cache holds the parsed matrix of a
+ *  textual file (as a raw binary vector file, see nwe_file.h), the
+ *  statistics of every requested normalization, and the principal
+ *  components of the normalized vectors together with the projections
+ *  of all vectors on them.
+ *
+ *  All entries of one vector file share a prefix made of a hash of
+ *  the absolute path of the file, its size, and its modification time,
+ *  so that entries of a modified file are never used (and are removed
+ *  once the file is loaded again).  The remainder of the name of an
+ *  entry encodes the precision and the normalization options it was
+ *  computed for.  Entries are written to temporary files which are
+ *  renamed once complete, so that concurrent runs only ever see whole
+ *  entries.
+ */
+
+#ifndef VEC2DIC_NWE_CACHE_H_
+# define VEC2DIC_NWE_CACHE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/nwe_view.h"
+
+#include <cstdlib>        // size_t
+#include <string>         // std::string
+
+///////////
+// Types //
+///////////
+
+/**
+ * Cache entries of a single vector file.
+ */
+using nwe_cache_t = struct NWECache {
+  /// directory of the cache
+  std::string m_dir {};
+  /// common prefix of the names of all entries of the vector file
+  std::string m_prefix {};
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Identify a vector file and the version of its contents
+ *
+ * @param a_fname - name of the vector file
+ * @param a_file_id - identifier of the file (a hash of its absolute
+ *                    path)
+ * @param a_version_id - identifier of the current contents of the file
+ *                       (prefixed with the identifier of the file)
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int nwe_file_id(const char *a_fname, std::string *a_file_id,
+                std::string *a_version_id);
+
+/**
+ * Prepare cache entries of a vector file
+ *
+ * The cache directory is created if it does not exist, and entries of
+ * previous versions of the vector file are removed.
+ *
+ * @param a_cache - cache to populate
+ * @param a_dir - cache directory
+ * @param a_fname - name of the vector file
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int open_nwe_cache(nwe_cache_t *a_cache, const char *a_dir,
+                   const char *a_fname);
+
+/**
+ * Compose name of a cache entry
+ *
+ * @param a_cache - cache of the vector file
+ * @param a_artifact - name of the entry relative to the vector file
+ *
+ * @return path of the entry
+ */
+std::string nwe_cache_fname(const nwe_cache_t *a_cache,
+                            const std::string &a_artifact);
+
+/**
+ * Compose name of a temporary file for writing a cache entry
+ *
+ * @param a_fname - path of the entry
+ *
+ * @return path of a file in the same directory which is unique to the
+ *   calling process
+ */
+std::string nwe_cache_tmp_fname(const std::string &a_fname);
+
+/**
+ * Publish a completely written cache entry
+ *
+ * @param a_tmp_fname - temporary file holding the entry (removed on
+ *                      failure)
+ * @param a_fname - path of the entry
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int commit_nwe_cache_file(const std::string &a_tmp_fname,
+                          const std::string &a_fname);
+
+/**
+ * Compose name of the entries of a normalization
+ *
+ * @param a_elem_size - size of a matrix element in bytes
+ * @param a_length_normalize - whether the vectors are length-normalized
+ * @param a_mean_normalize - whether the vectors are mean-normalized
+ * @param a_coefficient - elongation coefficient
+ *
+ * @return key which is unique to the precision and the normalization
+ */
+std::string nwe_norm_key(const size_t a_elem_size,
+                         const bool a_length_normalize,
+                         const bool a_mean_normalize,
+                         const double a_coefficient);
+
+/**
+ * Store normalization of word vectors in a cache entry
+ *
+ * @param a_fname - path of the entry
+ * @param a_norm - normalization to store
+ * @param a_n_rows - number of coordinates of a vector
+ * @param a_n_cols - number of vectors
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int save_nwe_norm(const std::string &a_fname, const nwe_norm_t<eT> *a_norm,
+                  const size_t a_n_rows, const size_t a_n_cols);
+
+/**
+ * Read normalization of word vectors from a cache entry
+ *
+ * @param a_fname - path of the entry
+ * @param a_norm - normalization to populate
+ * @param a_n_rows - expected number of coordinates of a vector
+ * @param a_n_cols - expected number of vectors
+ *
+ * @return \c 0 on success, non-\c 0 if the entry does not exist or
+ *   does not match the vectors
+ */
+template <typename eT>
+int load_nwe_norm(const std::string &a_fname, nwe_norm_t<eT> *a_norm,
+                  const size_t a_n_rows, const size_t a_n_cols);
+
+/**
+ * Store principal components in a cache entry
+ *
+ * @param a_fname - path of the entry
+ * @param a_basis - principal components (and, optionally, projections
+ *                  of all vectors on them)
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int save_pca_basis(const std::string &a_fname,
+                   const pca_basis_t *a_basis);
+
+/**
+ * Read principal components from a cache entry
+ *
+ * @param a_fname - path of the entry
+ * @param a_basis - principal components to populate
+ * @param a_n_rows - expected number of coordinates of a vector
+ * @param a_n_cols - expected number of vectors
+ *
+ * @return \c 0 on success, non-\c 0 if the entry does not exist or
+ *   does not match the vectors
+ */
+int load_pca_basis(const std::string &a_fname, pca_basis_t *a_basis,
+                   const size_t a_n_rows, const size_t a_n_cols);
+
+#endif    // VEC2DIC_NWE_CACHE_H_
@@ -0,0 +1,338 @@
+/** @file nwe_file.cpp
+ *
+ *  @brief binary container format for neural word embeddings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/nwe_file.h"
+
+#include <fcntl.h>                      // open()
+#include <sys/mman.h>                   // mmap(), munmap()
+#include <sys/stat.h>                   // fstat()
+#include <unistd.h>                     // close(), pread()
+
+#include <cstring>                      // memcmp(), memcpy(), memset()
+#include <fstream>                      // std::ifstream, std::ofstream
+#include <iostream>                     // std::cerr
+#include <vector>                       // std::vector
+
+///////////////
+// Constants //
+///////////////
+
+/** Magic bytes identifying binary embedding files */
+static const char NWE_MAGIC[8] = {'V', '2', 'D', 'N', 'W', 'E', '\0', '\0'};
+
+/** Current version of the binary format */
+static const uint32_t NWE_VERSION = 1;
+
+/** Alignment of the matrix within the file (one memory page) */
+static const uint64_t NWE_ALIGNMENT = 4096;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Round offset up to the next multiple of an alignment
+ *
+ * @param a_offset - offset to align
+ * @param a_alignment - required alignment
+ *
+ * @return aligned offset
+ */
+static inline uint64_t _align(uint64_t a_offset,
+                              uint64_t a_alignment = NWE_ALIGNMENT) {
+  return (a_offset + a_alignment - 1) / a_alignment * a_alignment;
+}
+
+/**
+ * Populate header of a binary embedding file
+ *
+ * @param a_header - header to populate
+ * @param a_nwe - neural word embeddings
+ * @param a_vocabulary - words of the vectors
+ * @param a_flags - preprocessing applied to the vectors
+ * @param a_coefficient - coefficient by which the vectors were multiplied
+ *
+ * @return \c 0 on success, non-\c 0 if the vocabulary does not match
+ *   the vectors
+ */
+template <typename eT>
+static int _make_header(nwe_header_t *a_header, const NWEView<eT> *a_nwe,
+                        const Vocabulary *a_vocabulary,
+                        const uint32_t a_flags, const double a_coefficient) {
+  const uint64_t n_cols = a_nwe->n_cols;
+  if (a_vocabulary->size() != n_cols) {
+    std::cerr << "Number of words " << a_vocabulary->size()
+              << " differs from the number of vectors " << n_cols
+              << std::endl;
+    return 1;
+  }
+
+  memset(a_header, 0, sizeof(*a_header));
+  memcpy(a_header->m_magic, NWE_MAGIC, sizeof(NWE_MAGIC));
+  a_header->m_version = NWE_VERSION;
+  a_header->m_elem_size = sizeof(eT);
+  a_header->m_n_rows = a_nwe->n_rows;
+  a_header->m_n_cols = n_cols;
+  a_header->m_flags = a_flags;
+  a_header->m_coefficient = a_coefficient;
+  a_header->m_matrix_offset = _align(sizeof(*a_header));
+  // the index is read in place as 64-bit offsets
+  a_header->m_index_offset = _align(a_header->m_matrix_offset
+                                    + a_nwe->n_rows * n_cols
+                                    * a_header->m_elem_size,
+                                    sizeof(uint64_t));
+  a_header->m_strings_offset = a_header->m_index_offset
+      + (n_cols + 1) * sizeof(uint64_t);
+  a_header->m_strings_size = a_vocabulary->offsets()[n_cols];
+  return 0;
+}
+
+/**
+ * Check that the sections of a binary embedding file fit into the file
+ *
+ * Sizes are compared by division, so that corrupted headers cannot
+ * make the products of the dimensions overflow.
+ *
+ * @param a_header - header of the file
+ * @param a_size - size of the file in bytes
+ *
+ * @return \c true if the sections are ordered and large enough,
+ *   \c false otherwise
+ */
+static bool _check_layout(const nwe_header_t *a_header,
+                          const uint64_t a_size) {
+  const uint64_t elem_size = a_header->m_elem_size;
+  if ((elem_size != sizeof(float) && elem_size != sizeof(double))
+      || a_header->m_matrix_offset < sizeof(nwe_header_t)
+      || a_header->m_matrix_offset % elem_size != 0
+      || a_header->m_index_offset < a_header->m_matrix_offset
+      || a_header->m_index_offset % sizeof(uint64_t) != 0
+      || a_header->m_strings_offset < a_header->m_index_offset
+      || a_header->m_strings_offset > a_size
+      || a_header->m_strings_size > a_size - a_header->m_strings_offset)
+    return false;
+
+  // (n_cols + 1) offsets have to fit in front of the string table
+  const uint64_t n_cols = a_header->m_n_cols;
+  if (n_cols >= (a_header->m_strings_offset - a_header->m_index_offset)
+      / sizeof(uint64_t))
+    return false;
+
+  // n_rows * n_cols elements have to fit in front of the index
+  const uint64_t n_elem = (a_header->m_index_offset
+                           - a_header->m_matrix_offset) / elem_size;
+  return a_header->m_n_rows == 0 || n_cols <= n_elem / a_header->m_n_rows;
+}
+
+/**
+ * Check that the word index of a binary embedding file delimits words
+ * within the string table
+ *
+ * @param a_index - index of `a_n_cols + 1` offsets
+ * @param a_n_cols - number of words
+ * @param a_strings_size - size of the string table in bytes
+ *
+ * @return \c true if the offsets start at 0, do not decrease, and end
+ *   at the end of the string table, \c false otherwise
+ */
+static bool _check_index(const uint64_t *a_index, const uint64_t a_n_cols,
+                         const uint64_t a_strings_size) {
+  if (a_index[0] != 0 || a_index[a_n_cols] != a_strings_size)
+    return false;
+
+  for (uint64_t i = 0; i < a_n_cols; ++i) {
+    if (a_index[i] > a_index[i + 1])
+      return false;
+  }
+  return true;
+}
+
+bool is_nwe_file(const char *a_fname) {
+  char magic[sizeof(NWE_MAGIC)];
+  std::ifstream is(a_fname, std::ios::binary);
+  if (!is || !is.read(magic, sizeof(magic)))
+    return false;
+
+  return memcmp(magic, NWE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool is_nwe_fd(const int a_fd) {
+  char magic[sizeof(NWE_MAGIC)];
+  return pread(a_fd, magic, sizeof(magic), 0)
+      == static_cast<ssize_t>(sizeof(magic))
+      && memcmp(magic, NWE_MAGIC, sizeof(magic)) == 0;
+}
+
+template <typename eT>
+size_t nwe_image_size(const NWEView<eT> *a_nwe,
+                      const Vocabulary *a_vocabulary) {
+  nwe_header_t header;
+  if (_make_header(&header, a_nwe, a_vocabulary, NWE_RAW, 1.))
+    return 0;
+  return header.m_strings_offset + header.m_strings_size;
+}
+
+template <typename eT>
+int write_nwe_image(void *a_addr, const NWEView<eT> *a_nwe,
+                    const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                    const double a_coefficient) {
+  nwe_header_t header;
+  if (_make_header(&header, a_nwe, a_vocabulary, a_flags, a_coefficient))
+    return 1;
+
+  char *dst = static_cast<char *>(a_addr);
+  const char *src = reinterpret_cast<const char *>(&header);
+  const size_t magic_size = sizeof(header.m_magic);
+  memset(dst, 0, header.m_matrix_offset);
+  memcpy(dst + magic_size, src + magic_size, sizeof(header) - magic_size);
+  char *matrix_end = dst + header.m_matrix_offset
+      + header.m_n_rows * header.m_n_cols * sizeof(eT);
+  a_nwe->normalize(0, header.m_n_cols,
+                   reinterpret_cast<eT *>(dst + header.m_matrix_offset));
+  memset(matrix_end, 0, dst + header.m_index_offset - matrix_end);
+  memcpy(dst + header.m_index_offset, a_vocabulary->offsets(),
+         (header.m_n_cols + 1) * sizeof(uint64_t));
+  memcpy(dst + header.m_strings_offset, a_vocabulary->bytes(),
+         header.m_strings_size);
+  // the magic bytes come last, so that incomplete images are never
+  // taken for binary embedding files
+  memcpy(dst, src, magic_size);
+  return 0;
+}
+
+template <typename eT>
+int write_nwe_file(const char *a_fname, const NWEView<eT> *a_nwe,
+                   const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                   const double a_coefficient) {
+  nwe_header_t header;
+  if (_make_header(&header, a_nwe, a_vocabulary, a_flags, a_coefficient))
+    return 1;
+  // the offsets of the vocabulary are the index of the string table
+  const uint64_t *index = a_vocabulary->offsets();
+  const uint64_t n_cols = header.m_n_cols;
+
+  std::ofstream os(a_fname, std::ios::binary | std::ios::trunc);
+  if (!os) {
+    std::cerr << "Cannot open file " << a_fname << std::endl;
+    return 1;
+  }
+  // write header and pad it up to the beginning of the matrix
+  std::vector<char> padding(header.m_matrix_offset - sizeof(header), '\0');
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(padding.data(), padding.size());
+  // write matrix column by column, padded up to the word index, word
+  // index, and string table
+  std::vector<eT> buf(a_nwe->n_rows);
+  for (vid_t i = 0; i < n_cols && os; ++i)
+    os.write(reinterpret_cast<const char *>(a_nwe->col(i, buf.data())),
+             a_nwe->n_rows * header.m_elem_size);
+  padding.assign(header.m_index_offset - header.m_matrix_offset
+                 - a_nwe->n_rows * n_cols * header.m_elem_size, '\0');
+  os.write(padding.data(), padding.size());
+  os.write(reinterpret_cast<const char *>(index),
+           (n_cols + 1) * sizeof(uint64_t));
+  os.write(a_vocabulary->bytes(), header.m_strings_size);
+  os.close();
+  if (os.fail()) {
+    std::cerr << "Failed to write binary vector file "
+              << a_fname << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int map_nwe_file(const char *a_fname, nwe_map_t *a_map) {
+  int fd = open(a_fname, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Cannot open file " << a_fname << std::endl;
+    return 1;
+  }
+  // the mapping stays valid after the descriptor is closed
+  int ret = map_nwe_fd(fd, a_fname, a_map);
+  close(fd);
+  return ret;
+}
+
+int map_nwe_fd(const int a_fd, const char *a_fname, nwe_map_t *a_map) {
+  struct stat st;
+  void *addr = MAP_FAILED;
+  const nwe_header_t *header;
+  if (fstat(a_fd, &st) != 0
+      || static_cast<size_t>(st.st_size) < sizeof(nwe_header_t)) {
+    std::cerr << "Incorrect binary vector file " << a_fname << std::endl;
+    goto error_exit;
+  }
+  // the vectors are never modified (they are normalized on access),
+  // so that the pages can be shared with other processes
+  addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, a_fd, 0);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Cannot map file " << a_fname << std::endl;
+    goto error_exit;
+  }
+
+  header = static_cast<const nwe_header_t *>(addr);
+  if (memcmp(header->m_magic, NWE_MAGIC, sizeof(NWE_MAGIC)) != 0
+      || header->m_version != NWE_VERSION) {
+    std::cerr << "Unsupported binary vector file format " << a_fname
+              << std::endl;
+    goto error_exit;
+  }
+  if (!_check_layout(header, st.st_size)
+      || !_check_index(reinterpret_cast<const uint64_t *>(
+          static_cast<const char *>(addr) + header->m_index_offset),
+                       header->m_n_cols, header->m_strings_size)) {
+    std::cerr << "Incorrect binary vector file " << a_fname
+              << " (truncated or corrupted)" << std::endl;
+    goto error_exit;
+  }
+
+  a_map->m_addr = addr;
+  a_map->m_size = st.st_size;
+  a_map->m_header = header;
+  a_map->m_matrix = static_cast<char *>(addr) + header->m_matrix_offset;
+  a_map->m_index = reinterpret_cast<const uint64_t *>(
+      static_cast<const char *>(addr) + header->m_index_offset);
+  a_map->m_strings = static_cast<const char *>(addr)
+      + header->m_strings_offset;
+  return 0;
+
+ error_exit:
+  if (addr != MAP_FAILED)
+    munmap(addr, st.st_size);
+  return 1;
+}
+
+void unmap_nwe_file(nwe_map_t *a_map) {
+  if (a_map->m_addr != nullptr)
+    munmap(a_map->m_addr, a_map->m_size);
+
+  *a_map = nwe_map_t();
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template int write_nwe_file<float>(const char *, const NWEView<float> *,
+                                   const Vocabulary *, const uint32_t,
+                                   const double);
+template int write_nwe_file<double>(const char *, const NWEView<double> *,
+                                    const Vocabulary *, const uint32_t,
+                                    const double);
+
+template size_t nwe_image_size<float>(const NWEView<float> *,
+                                      const Vocabulary *);
+template size_t nwe_image_size<double>(const NWEView<double> *,
+                                       const Vocabulary *);
+
+template int write_nwe_image<float>(void *, const NWEView<float> *,
+                                    const Vocabulary *, const uint32_t,
+                                    const double);
+template int write_nwe_image<double>(void *, const NWEView<double> *,
+                                     const Vocabulary *, const uint32_t,
+                                     const double);
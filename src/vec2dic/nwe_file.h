@@ -0,0 +1,200 @@
+/** @file nwe_file.h
+ *
+ *  @brief binary container format for neural word embeddings.
+ *
+ *  This file declares methods for storing neural word embeddings in a
+ *  compact binary file which can be memory-mapped and used in place,
+ *  without parsing the textual word2vec format.
+ *
+ *  The file consists of a fixed-size header, a contiguous column-major
+ *  matrix of vector coordinates (one column per word), an index of
+ *  `n_cols + 1` offsets, and a string table with the words.  The i-th
+ *  word occupies the bytes `[index[i], index[i + 1])` of the string
+ *  table.  The matrix starts at a page boundary and the index at a
+ *  multiple of 8 bytes, so that both can be used in place.  All numbers
+ *  are stored in the byte order of the host.
+ */
+
+#ifndef VEC2DIC_NWE_FILE_H_
+# define VEC2DIC_NWE_FILE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/vocabulary.h"
+
+#include <armadillo>      // arma::mat
+#include <cstdint>        // uint32_t, uint64_t
+#include <cstdlib>        // size_t
+
+///////////
+// Types //
+///////////
+
+/**
+ * Flags describing the preprocessing applied to the stored vectors.
+ */
+enum NWEFlags: uint32_t {
+  NWE_RAW = 0,                  ///< vectors are stored as read
+  NWE_LENGTH_NORMALIZED = 1,    ///< vectors are length-normalized
+  NWE_MEAN_NORMALIZED = 2       ///< vectors are mean-normalized
+};
+
+/**
+ * Header of a binary embedding file.
+ */
+using nwe_header_t = struct NWEHeader {
+  /// magic bytes identifying the format
+  char m_magic[8];
+  /// version of the format
+  uint32_t m_version;
+  /// size of a single matrix element in bytes (4 or 8)
+  uint32_t m_elem_size;
+  /// number of coordinates per vector
+  uint64_t m_n_rows;
+  /// number of vectors
+  uint64_t m_n_cols;
+  /// preprocessing applied to the vectors (combination of `NWEFlags`)
+  uint32_t m_flags;
+  /// reserved for future use
+  uint32_t m_reserved;
+  /// coefficient by which the vectors were multiplied
+  double m_coefficient;
+  /// offset of the matrix from the beginning of the file
+  uint64_t m_matrix_offset;
+  /// offset of the word index from the beginning of the file
+  uint64_t m_index_offset;
+  /// offset of the string table from the beginning of the file
+  uint64_t m_strings_offset;
+  /// size of the string table in bytes
+  uint64_t m_strings_size;
+};
+
+/**
+ * Memory-mapped binary embedding file.
+ */
+using nwe_map_t = struct NWEMap {
+  /// start of the mapped region
+  void *m_addr = nullptr;
+  /// size of the mapped region
+  size_t m_size = 0;
+  /// header of the file
+  const nwe_header_t *m_header = nullptr;
+  /// first element of the matrix
+  const void *m_matrix = nullptr;
+  /// offsets of the words in the string table
+  const uint64_t *m_index = nullptr;
+  /// string table
+  const char *m_strings = nullptr;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Check whether the file is a binary embedding file
+ *
+ * @param a_fname - name of the file to check
+ *
+ * @return \c true if the file starts with the magic bytes of the
+ *   binary format, \c false otherwise
+ */
+bool is_nwe_file(const char *a_fname);
+
+/**
+ * Check whether an open file holds a complete binary embedding image
+ *
+ * @param a_fd - descriptor of the file to check
+ *
+ * @return \c true if the file starts with the magic bytes of the
+ *   binary format, \c false otherwise
+ */
+bool is_nwe_fd(const int a_fd);
+
+/**
+ * Store neural word embeddings in a binary file
+ *
+ * @param a_fname - name of the output file
+ * @param a_nwe - neural word embeddings (normalized while they are
+ *                written if necessary)
+ * @param a_vocabulary - words of the vectors
+ * @param a_flags - preprocessing applied to the vectors
+ * @param a_coefficient - coefficient by which the vectors were multiplied
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int write_nwe_file(const char *a_fname, const NWEView<eT> *a_nwe,
+                   const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                   const double a_coefficient);
+
+/**
+ * Compute size of the binary image of neural word embeddings
+ *
+ * @param a_nwe - neural word embeddings
+ * @param a_vocabulary - words of the vectors
+ *
+ * @return number of bytes written by write_nwe_image()
+ */
+template <typename eT>
+size_t nwe_image_size(const NWEView<eT> *a_nwe,
+                      const Vocabulary *a_vocabulary);
+
+/**
+ * Store neural word embeddings in memory in the binary file format
+ *
+ * The magic bytes are written last, so that readers which check them
+ * never see a partially written image.
+ *
+ * @param a_addr - destination of nwe_image_size() bytes
+ * @param a_nwe - neural word embeddings (normalized while they are
+ *                written if necessary)
+ * @param a_vocabulary - words of the vectors
+ * @param a_flags - preprocessing applied to the vectors
+ * @param a_coefficient - coefficient by which the vectors were multiplied
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int write_nwe_image(void *a_addr, const NWEView<eT> *a_nwe,
+                    const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                    const double a_coefficient);
+
+/**
+ * Memory-map a binary embedding file
+ *
+ * The file is mapped read-only and shared, so that all processes
+ * which map the same file share its pages.
+ *
+ * @param a_fname - name of the input file
+ * @param a_map - mapping to populate
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int map_nwe_file(const char *a_fname, nwe_map_t *a_map);
+
+/**
+ * Memory-map an open binary embedding file
+ *
+ * @param a_fd - descriptor of the file (may be closed once the file is
+ *               mapped)
+ * @param a_fname - name of the file used in error messages
+ * @param a_map - mapping to populate
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int map_nwe_fd(const int a_fd, const char *a_fname, nwe_map_t *a_map);
+
+/**
+ * Release a previously mapped binary embedding file
+ *
+ * @param a_map - mapping to release
+ *
+ * @return \c void
+ */
+void unmap_nwe_file(nwe_map_t *a_map);
+
+#endif    // VEC2DIC_NWE_FILE_H_
@@ -0,0 +1,164 @@
+/** @file nwe_shm.cpp
+ *
+ *  @brief word embeddings shared by concurrent processes.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/nwe_shm.h"
+#include "src/vec2dic/nwe_file.h"
+
+#include <fcntl.h>                      // O_CREAT, O_EXCL, posix_fallocate()
+#include <sys/file.h>                   // flock()
+#include <sys/mman.h>                   // mmap(), shm_open(), shm_unlink()
+#include <sys/stat.h>                   // fstat()
+#include <unistd.h>                     // close(), usleep()
+
+#include <cerrno>                       // errno, EEXIST, ENOENT
+#include <cstring>                      // strerror()
+#include <iostream>                     // std::cerr
+
+///////////////
+// Constants //
+///////////////
+
+/** Number of attempts to open a segment which is being removed */
+static const int SHM_ATTEMPTS = 8;
+
+/** Delay between attempts to open a segment (in microseconds) */
+static const useconds_t SHM_RETRY_DELAY = 10000;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Remove shared memory segment if its name still refers to it
+ *
+ * @param a_name - name of the segment
+ * @param a_fd - descriptor of the segment
+ *
+ * @return \c void
+ */
+static void _unlink_shm(const char *a_name, const int a_fd) {
+  struct stat st, named_st;
+  int fd = shm_open(a_name, O_RDONLY, 0);
+  if (fd < 0)
+    return;
+
+  // another process may have replaced an incomplete segment already
+  if (fstat(a_fd, &st) == 0 && fstat(fd, &named_st) == 0
+      && st.st_dev == named_st.st_dev && st.st_ino == named_st.st_ino)
+    shm_unlink(a_name);
+  close(fd);
+}
+
+int open_nwe_shm(nwe_shm_t *a_shm, const char *a_name) {
+  int fd;
+  for (int i = 0; i < SHM_ATTEMPTS; ++i) {
+    fd = shm_open(a_name, O_RDONLY, 0);
+    if (fd >= 0) {
+      // wait until the creator of the segment has published the
+      // vectors or has given up
+      if (flock(fd, LOCK_SH) != 0) {
+        close(fd);
+        break;
+      }
+      if (is_nwe_fd(fd)) {
+        a_shm->m_name = a_name;
+        a_shm->m_fd = fd;
+        return 0;
+      }
+      // the creator crashed before publishing the vectors, the first
+      // process to notice it removes the segment (which, at worst,
+      // makes the creator of a new segment keep a private copy)
+      if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+        _unlink_shm(a_name, fd);
+      close(fd);
+      usleep(SHM_RETRY_DELAY);
+      continue;
+    }
+    if (errno != ENOENT)
+      break;
+
+    fd = shm_open(a_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0) {
+      if (flock(fd, LOCK_EX) != 0) {
+        shm_unlink(a_name);
+        close(fd);
+        break;
+      }
+      a_shm->m_name = a_name;
+      a_shm->m_fd = fd;
+      return 1;
+    }
+    // another process has just created the segment
+    if (errno != EEXIST)
+      break;
+  }
+  std::cerr << "Cannot open shared memory segment " << a_name << ": "
+            << strerror(errno) << std::endl;
+  return -1;
+}
+
+template <typename eT>
+int publish_nwe_shm(nwe_shm_t *a_shm, const NWEView<eT> *a_nwe,
+                    const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                    const double a_coefficient) {
+  void *addr = MAP_FAILED;
+  int ret = 0;
+  const size_t size = nwe_image_size(a_nwe, a_vocabulary);
+  if (size == 0)
+    return 1;
+
+  // reserve the memory beforehand, since writing to pages which do not
+  // fit into the shared memory file system would crash the process
+  if ((ret = posix_fallocate(a_shm->m_fd, 0, size)) != 0) {
+    std::cerr << "Cannot allocate " << size << " bytes of shared memory: "
+              << strerror(ret) << std::endl;
+    return 1;
+  }
+  addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+              a_shm->m_fd, 0);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Cannot map shared memory segment " << a_shm->m_name
+              << std::endl;
+    return 1;
+  }
+  ret = write_nwe_image(addr, a_nwe, a_vocabulary, a_flags, a_coefficient);
+  munmap(addr, size);
+  if (ret)
+    return 1;
+
+  // let the waiting processes in
+  if (flock(a_shm->m_fd, LOCK_SH) != 0) {
+    std::cerr << "Cannot unlock shared memory segment " << a_shm->m_name
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+void close_nwe_shm(nwe_shm_t *a_shm) {
+  if (a_shm->m_fd < 0)
+    return;
+
+  // only the last process using the segment can lock it exclusively
+  if (flock(a_shm->m_fd, LOCK_EX | LOCK_NB) == 0)
+    _unlink_shm(a_shm->m_name.c_str(), a_shm->m_fd);
+  close(a_shm->m_fd);
+  a_shm->m_fd = -1;
+  a_shm->m_name.clear();
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template int publish_nwe_shm<float>(nwe_shm_t *, const NWEView<float> *,
+                                    const Vocabulary *, const uint32_t,
+                                    const double);
+template int publish_nwe_shm<double>(nwe_shm_t *, const NWEView<double> *,
+                                     const Vocabulary *, const uint32_t,
+                                     const double);
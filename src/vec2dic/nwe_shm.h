@@ -0,0 +1,96 @@
+/** @file nwe_shm.h
+ *
+ *  @brief word embeddings shared by concurrent processes.
+ *
+ *  This file declares methods for publishing loaded word vectors in a
+ *  named POSIX shared memory segment, so that concurrently running
+ *  processes which load the same vector file keep only one copy of the
+ *  embedding matrix in memory.  The segment holds a binary image of
+ *  the vectors and their words (see nwe_file.h), which is mapped
+ *  read-only by all processes.
+ *
+ *  The first process which opens a segment creates it and holds an
+ *  exclusive lock on it until the image is complete, so that the other
+ *  processes wait for the vectors instead of loading them once more.
+ *  Every process then holds a shared lock on the segment for as long as
+ *  it uses it.  The locks serve as reference counts which the kernel
+ *  releases even when a process crashes: the last process which closes
+ *  the segment (i.e., the one which can lock it exclusively) removes
+ *  it, and segments left incomplete by crashed processes are removed by
+ *  the next process which opens them.
+ */
+
+#ifndef VEC2DIC_NWE_SHM_H_
+# define VEC2DIC_NWE_SHM_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/vocabulary.h"
+
+#include <cstdint>        // uint32_t
+#include <string>         // std::string
+
+///////////
+// Types //
+///////////
+
+/**
+ * Shared memory segment opened by this process.
+ */
+using nwe_shm_t = struct NWEShm {
+  /// name of the segment
+  std::string m_name {};
+  /// descriptor of the segment (-1 if closed)
+  int m_fd = -1;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Open shared memory segment with word vectors
+ *
+ * Waits until the process which creates the segment has published the
+ * vectors.
+ *
+ * @param a_shm - segment to populate
+ * @param a_name - name of the segment (starting with a slash)
+ *
+ * @return \c 0 if the segment holds the vectors, \c 1 if the segment
+ *   was created and the vectors have to be published with
+ *   publish_nwe_shm(), \c -1 on error
+ */
+int open_nwe_shm(nwe_shm_t *a_shm, const char *a_name);
+
+/**
+ * Store word vectors in a newly created shared memory segment
+ *
+ * @param a_shm - segment created by open_nwe_shm()
+ * @param a_nwe - word vectors to publish
+ * @param a_vocabulary - words of the vectors
+ * @param a_flags - preprocessing applied to the vectors
+ * @param a_coefficient - coefficient by which the vectors were multiplied
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int publish_nwe_shm(nwe_shm_t *a_shm, const NWEView<eT> *a_nwe,
+                    const Vocabulary *a_vocabulary, const uint32_t a_flags,
+                    const double a_coefficient);
+
+/**
+ * Close shared memory segment
+ *
+ * The segment is removed if no other process uses it.  Mappings of the
+ * segment stay valid until they are released.
+ *
+ * @param a_shm - segment to close
+ *
+ * @return \c void
+ */
+void close_nwe_shm(nwe_shm_t *a_shm);
+
+#endif    // VEC2DIC_NWE_SHM_H_
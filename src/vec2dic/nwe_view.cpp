@@ -0,0 +1,289 @@
+/** @file nwe_view.cpp
+ *
+ *  @brief word vectors which are normalized when they are read.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/nwe_view.h"
+#include "src/vec2dic/phase_profile.h"
+
+#include <cmath>          // sqrt()
+
+#include <algorithm>      // std::copy(), std::fill(), std::min()
+
+///////////////
+// Constants //
+///////////////
+
+/** Number of columns whose statistics are computed while in cache */
+static const size_t STATS_BLOCK = 64;
+
+/** Number of columns summarized by one partial result */
+static const size_t STATS_CHUNK = 64 * STATS_BLOCK;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Elongate and length-normalize a coordinate
+ *
+ * The statistics of the normalization and the normalized vectors are
+ * computed with this function instead of storing intermediate
+ * results, so that all of them see exactly the same values.
+ *
+ * @param a_value - raw coordinate
+ * @param a_coefficient - elongation coefficient
+ * @param a_length - length of the elongated vector (1 if the vector
+ *                   should not be length-normalized)
+ *
+ * @return normalized coordinate
+ */
+template <typename eT>
+static inline eT _scale(const eT a_value, const eT a_coefficient,
+                        const eT a_length) {
+  return (a_value * a_coefficient) / a_length;
+}
+
+/**
+ * Partial statistics of the coordinates of a range of vectors.
+ */
+using row_stats_t = struct RowStats {
+  /// number of vectors
+  size_t m_n = 0;
+  /// means of the coordinates
+  std::vector<double> m_means {};
+  /// sums of squared deviations of the coordinates from their means
+  std::vector<double> m_m2 {};
+};
+
+/**
+ * Combine statistics of two disjoint ranges of vectors
+ *
+ * Uses the pairwise update of Chan et al., so that the deviations of
+ * every range are taken from its own mean.
+ *
+ * @param a_dst - statistics to extend
+ * @param a_src - statistics of the vectors to add
+ *
+ * @return \c void
+ */
+static void _merge_row_stats(row_stats_t *a_dst, const row_stats_t &a_src) {
+  if (a_src.m_n == 0)
+    return;
+  if (a_dst->m_n == 0) {
+    *a_dst = a_src;
+    return;
+  }
+
+  const double n_a = a_dst->m_n, n_b = a_src.m_n, n = n_a + n_b;
+  const double w_b = n_b / n, w_m2 = n_a * n_b / n;
+  double delta;
+  for (size_t j = 0; j < a_src.m_means.size(); ++j) {
+    delta = a_src.m_means[j] - a_dst->m_means[j];
+    a_dst->m_means[j] += delta * w_b;
+    a_dst->m_m2[j] += a_src.m_m2[j] + delta * delta * w_m2;
+  }
+  a_dst->m_n += a_src.m_n;
+}
+
+/**
+ * Compute lengths of elongated word vectors and statistics of their
+ * coordinates in one pass over a chunk of columns
+ *
+ * The chunk is processed in blocks of `STATS_BLOCK` columns which stay
+ * in cache while their lengths, means, and squared deviations are
+ * computed, so that every column is read from memory once.
+ *
+ * @param a_stats - statistics of the chunk to populate (not computed
+ *                  if \c nullptr)
+ * @param a_lengths - lengths of all vectors, of which those of the
+ *                    chunk are populated (1 for vectors of zero length,
+ *                    not computed if \c nullptr)
+ * @param a_nwe - Armadillo matrix of word vectors (each word vector
+ *                is a column in this matrix)
+ * @param a_coefficient - elongation coefficient
+ * @param a_start - first column of the chunk
+ * @param a_end - end of the chunk
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _compute_chunk_stats(row_stats_t *a_stats,
+                                 std::vector<eT> *a_lengths,
+                                 const arma::Mat<eT> *a_nwe,
+                                 const eT a_coefficient,
+                                 const size_t a_start, const size_t a_end) {
+  const size_t n_rows = a_nwe->n_rows;
+  row_stats_t block;
+  block.m_means.resize(n_rows);
+  block.m_m2.resize(n_rows);
+  const eT *icol;
+  eT ilength = 1;
+  dist_t length, tmp_j;
+  size_t i, j, end;
+  for (size_t start = a_start; start < a_end; start += STATS_BLOCK) {
+    end = std::min(start + STATS_BLOCK, a_end);
+    if (a_lengths != nullptr) {
+      for (i = start; i < end; ++i) {
+        icol = a_nwe->colptr(i);
+        length = 0.;
+        for (j = 0; j < n_rows; ++j) {
+          tmp_j = icol[j] * a_coefficient;
+          length += tmp_j * tmp_j;
+        }
+        length = sqrt(length);
+        (*a_lengths)[i] = length? static_cast<eT>(length): 1;
+      }
+    }
+    if (a_stats == nullptr)
+      continue;
+
+    // exact two-pass statistics of the cached block
+    std::fill(block.m_means.begin(), block.m_means.end(), 0.);
+    std::fill(block.m_m2.begin(), block.m_m2.end(), 0.);
+    block.m_n = end - start;
+    for (i = start; i < end; ++i) {
+      icol = a_nwe->colptr(i);
+      if (a_lengths != nullptr)
+        ilength = (*a_lengths)[i];
+      for (j = 0; j < n_rows; ++j)
+        block.m_means[j] += _scale(icol[j], a_coefficient, ilength);
+    }
+    for (j = 0; j < n_rows; ++j)
+      block.m_means[j] /= static_cast<double>(block.m_n);
+    for (i = start; i < end; ++i) {
+      icol = a_nwe->colptr(i);
+      if (a_lengths != nullptr)
+        ilength = (*a_lengths)[i];
+      for (j = 0; j < n_rows; ++j) {
+        tmp_j = _scale(icol[j], a_coefficient, ilength) - block.m_means[j];
+        block.m_m2[j] += tmp_j * tmp_j;
+      }
+    }
+    _merge_row_stats(a_stats, block);
+  }
+}
+
+/**
+ * Compute lengths of elongated word vectors and means and standard
+ * deviations of their coordinates
+ *
+ * Threads process fixed chunks of `STATS_CHUNK` columns, whose
+ * statistics are merged in the order of the chunks, so that every
+ * column is read from memory once and the results do not depend on the
+ * number of threads.  Statistics are accumulated in double precision
+ * regardless of the element type of the matrix.
+ *
+ * @param a_lengths - vector to populate with the lengths (not computed
+ *                    if \c nullptr)
+ * @param a_means - vector to populate with the means of the rows (not
+ *                  computed if \c nullptr)
+ * @param a_stddevs - vector to populate with the standard deviations
+ *                    of the rows (1 for constant rows)
+ * @param a_nwe - Armadillo matrix of word vectors (each word vector
+ *                is a column in this matrix)
+ * @param a_coefficient - elongation coefficient
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _compute_stats(std::vector<eT> *a_lengths,
+                           std::vector<eT> *a_means,
+                           std::vector<eT> *a_stddevs,
+                           const arma::Mat<eT> *a_nwe,
+                           const eT a_coefficient) {
+  const size_t n_rows = a_nwe->n_rows, n_cols = a_nwe->n_cols;
+  const size_t n_chunks = (n_cols + STATS_CHUNK - 1) / STATS_CHUNK;
+  std::vector<row_stats_t> chunks(a_means != nullptr? n_chunks: 0);
+  if (a_lengths != nullptr)
+    a_lengths->resize(n_cols);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t k = 0; k < n_chunks; ++k)
+    _compute_chunk_stats(a_means != nullptr? &chunks[k]: nullptr,
+                         a_lengths, a_nwe, a_coefficient, k * STATS_CHUNK,
+                         std::min((k + 1) * STATS_CHUNK, n_cols));
+  if (a_means == nullptr)
+    return;
+
+  row_stats_t stats;
+  for (auto &chunk : chunks)
+    _merge_row_stats(&stats, chunk);
+  a_means->resize(n_rows);
+  a_stddevs->resize(n_rows);
+  double stddev;
+  for (size_t j = 0; j < n_rows; ++j) {
+    stddev = n_cols > 1? sqrt(stats.m_m2[j] / (n_cols - 1)): 0.;
+    (*a_means)[j] = n_cols > 0? static_cast<eT>(stats.m_means[j]): 0;
+    (*a_stddevs)[j] = stddev? static_cast<eT>(stddev): 1;
+  }
+}
+
+template <typename eT>
+void NWEView<eT>::normalize(const vid_t a_start, const size_t a_n,
+                            eT *a_dst) const {
+  const eT *src = m_nwe->colptr(a_start);
+  if (m_norm == nullptr) {
+    std::copy(src, src + n_rows * a_n, a_dst);
+    return;
+  }
+
+  const eT coefficient = m_norm->m_coefficient;
+  const bool length_normalize = !m_norm->m_lengths.empty();
+  const bool mean_normalize = !m_norm->m_means.empty();
+  const eT *means = m_norm->m_means.data();
+  const eT *inv_stddevs = m_norm->m_inv_stddevs.data();
+  eT ilength;
+  for (size_t i = 0; i < a_n; ++i, src += n_rows, a_dst += n_rows) {
+    ilength = length_normalize? m_norm->m_lengths[a_start + i]: 1;
+    if (mean_normalize) {
+      for (size_t j = 0; j < n_rows; ++j)
+        a_dst[j] = (_scale(src[j], coefficient, ilength) - means[j])
+            * inv_stddevs[j];
+    } else {
+      for (size_t j = 0; j < n_rows; ++j)
+        a_dst[j] = _scale(src[j], coefficient, ilength);
+    }
+  }
+}
+
+template <typename eT>
+void compute_nwe_norm(nwe_norm_t<eT> *a_norm, const arma::Mat<eT> *a_nwe,
+                      const double a_coefficient,
+                      const bool a_length_normalize,
+                      const bool a_mean_normalize) {
+  *a_norm = nwe_norm_t<eT>();
+  a_norm->m_coefficient = static_cast<eT>(a_coefficient);
+
+  if (!a_length_normalize && !a_mean_normalize)
+    return;
+
+  // compute lengths of word vectors together with the means and
+  // standard deviations of their coordinates
+  PhaseTimer timer("normalize_stats");
+  std::vector<eT> stddevs;
+  _compute_stats(a_length_normalize? &a_norm->m_lengths: nullptr,
+                 a_mean_normalize? &a_norm->m_means: nullptr, &stddevs,
+                 a_nwe, a_norm->m_coefficient);
+  if (a_mean_normalize) {
+    a_norm->m_inv_stddevs.resize(stddevs.size());
+    for (size_t j = 0; j < stddevs.size(); ++j)
+      a_norm->m_inv_stddevs[j] = 1 / stddevs[j];
+  }
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template class NWEView<float>;
+template class NWEView<double>;
+
+template void compute_nwe_norm<float>(nwe_norm_t<float> *,
+                                      const arma::fmat *, const double,
+                                      const bool, const bool);
+template void compute_nwe_norm<double>(nwe_norm_t<double> *,
+                                       const arma::mat *, const double,
+                                       const bool, const bool);
@@ -0,0 +1,184 @@
+/** @file nwe_view.h
+ *
+ *  @brief word vectors which are normalized when they are read.
+ *
+ *  Normalization of word vectors is represented by the lengths of the
+ *  vectors and by the means and standard deviations of their
+ *  coordinates instead of being applied to the embedding matrix.  The
+ *  expansion algorithms read vectors through a view, which normalizes
+ *  the columns they need into small buffers of the caller just before
+ *  they enter the distance kernels.  The embedding matrix thus stays
+ *  unmodified, so that it can be mapped read-only and shared, and
+ *  several normalizations can be used over one loaded matrix.
+ *
+ *  The normalized coordinate `j` of vector `i` is computed exactly as
+ *  the former in-place normalization did, i.e., as
+ *  `((x_ij * coefficient) / length_i - mean_j) * inv_stddev_j`, so
+ *  that the results of the algorithms do not depend on whether the
+ *  vectors are normalized lazily or were normalized beforehand.
+ */
+
+#ifndef VEC2DIC_NWE_VIEW_H_
+# define VEC2DIC_NWE_VIEW_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <armadillo>      // arma::Mat
+#include <cstdlib>        // size_t
+#include <vector>         // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Normalization of word vectors.
+ */
+template <typename eT>
+struct NWENorm {
+  /// elongation coefficient of the vectors
+  eT m_coefficient = 1;
+  /// lengths of the elongated vectors (empty if the vectors are not
+  /// length-normalized)
+  std::vector<eT> m_lengths {};
+  /// means of the coordinates (empty if the vectors are not
+  /// mean-normalized)
+  std::vector<eT> m_means {};
+  /// reciprocal standard deviations of the coordinates
+  std::vector<eT> m_inv_stddevs {};
+
+  /// check whether the normalization leaves vectors unchanged
+  bool is_identity() const {
+    return m_coefficient == 1 && m_lengths.empty() && m_means.empty();
+  }
+};
+
+template <typename eT>
+using nwe_norm_t = NWENorm<eT>;
+
+/////////////
+// Classes //
+/////////////
+
+/**
+ * Read-only view of normalized word vectors.
+ *
+ * The view does not own the matrix or the normalization, both of which
+ * have to outlive it.  All methods are safe to call from multiple
+ * threads.
+ */
+template <typename eT>
+class NWEView {
+ public:
+  /**
+   * Wrap matrix of word vectors
+   *
+   * @param a_nwe - matrix of word vectors (one per column, \c nullptr
+   *                yields an empty view which must not be read)
+   * @param a_norm - normalization to apply on access (\c nullptr means
+   *                 that the vectors are used as they are)
+   */
+  explicit NWEView(const arma::Mat<eT> *a_nwe,
+                   const nwe_norm_t<eT> *a_norm = nullptr):
+    n_rows{a_nwe != nullptr? a_nwe->n_rows: 0},
+    n_cols{a_nwe != nullptr? a_nwe->n_cols: 0}, m_nwe{a_nwe},
+    m_norm{a_norm != nullptr && !a_norm->is_identity()? a_norm: nullptr}
+  {}
+
+  /// number of coordinates of a vector (as in Armadillo matrices)
+  const size_t n_rows;
+  /// number of vectors
+  const vid_t n_cols;
+
+  /// check whether columns are normalized on access (otherwise, they
+  /// are returned in place and no buffers are used)
+  bool is_lazy() const {
+    return m_norm != nullptr;
+  }
+
+  /// underlying (unnormalized) matrix
+  const arma::Mat<eT> *matrix() const {
+    return m_nwe;
+  }
+
+  /**
+   * Obtain normalized vector
+   *
+   * @param a_vecid - id of the vector
+   * @param a_buf - buffer of `n_rows` elements which is used if the
+   *                vector has to be normalized
+   *
+   * @return pointer to the normalized coordinates (valid until the
+   *   buffer is reused)
+   */
+  const eT *col(const vid_t a_vecid, eT *a_buf) const {
+    return cols(a_vecid, 1, a_buf);
+  }
+
+  /**
+   * Obtain consecutive normalized vectors
+   *
+   * @param a_start - id of the first vector
+   * @param a_n - number of vectors
+   * @param a_buf - buffer of `n_rows * a_n` elements which is used if
+   *                the vectors have to be normalized
+   *
+   * @return pointer to the column-major coordinates of the vectors
+   */
+  const eT *cols(const vid_t a_start, const size_t a_n, eT *a_buf) const {
+    if (m_norm == nullptr)
+      return m_nwe->colptr(a_start);
+
+    normalize(a_start, a_n, a_buf);
+    return a_buf;
+  }
+
+  /**
+   * Copy consecutive normalized vectors
+   *
+   * @param a_start - id of the first vector
+   * @param a_n - number of vectors
+   * @param a_dst - destination of `n_rows * a_n` elements
+   *
+   * @return \c void
+   */
+  void normalize(const vid_t a_start, const size_t a_n, eT *a_dst) const;
+
+ private:
+  /// matrix of word vectors
+  const arma::Mat<eT> *m_nwe;
+  /// normalization applied on access (\c nullptr if none)
+  const nwe_norm_t<eT> *m_norm;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute normalization of word vectors
+ *
+ * Vectors are first elongated by the coefficient, then
+ * length-normalized, and finally mean-normalized (i.e., centered and
+ * scaled to unit variance in every dimension).  Only the statistics of
+ * these steps are computed, by read-only streaming passes over the
+ * matrix.
+ *
+ * @param a_norm - normalization to populate
+ * @param a_nwe - matrix of word vectors (one per column)
+ * @param a_coefficient - elongation coefficient
+ * @param a_length_normalize - normalize lengths of the vectors
+ * @param a_mean_normalize - center and scale the coordinates
+ *
+ * @return \c void
+ */
+template <typename eT>
+void compute_nwe_norm(nwe_norm_t<eT> *a_norm, const arma::Mat<eT> *a_nwe,
+                      const double a_coefficient,
+                      const bool a_length_normalize,
+                      const bool a_mean_normalize);
+
+#endif    // VEC2DIC_NWE_VIEW_H_
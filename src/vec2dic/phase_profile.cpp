@@ -0,0 +1,42 @@
+/** @file phase_profile.cpp
+ *
+ *  @brief collection of wall-clock timings of processing phases.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/phase_profile.h"
+
+///////////////
+// Variables //
+///////////////
+
+/// profile of the current thread
+static thread_local phase_profile_t *s_profile = nullptr;
+
+/////////////
+// Methods //
+/////////////
+
+void set_phase_profile(phase_profile_t *a_profile) {
+  s_profile = a_profile;
+}
+
+PhaseTimer::PhaseTimer(const char *a_phase):
+  m_phase{a_phase}, m_profile{s_profile}
+{
+  if (m_profile != nullptr)
+    m_start = std::chrono::steady_clock::now();
+}
+
+void PhaseTimer::stop() {
+  if (m_profile == nullptr)
+    return;
+
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - m_start;
+  m_profile->m_seconds[m_phase] += elapsed.count();
+  ++m_profile->m_counts[m_phase];
+  m_profile = nullptr;
+}
@@ -0,0 +1,93 @@
+/** @file phase_profile.h
+ *
+ *  @brief collection of wall-clock timings of processing phases.
+ *
+ *  Loading, normalization, and the expansion algorithms mark their
+ *  phases with scoped `PhaseTimer`s.  Timings are only collected on
+ *  threads on which a profile has been activated with
+ *  `set_phase_profile()` (e.g., by the benchmark); otherwise, the
+ *  timers do nothing.  Phases are always entered and left by the
+ *  thread which starts the parallel regions, so that their times are
+ *  wall-clock times of the whole team.
+ */
+
+#ifndef VEC2DIC_PHASE_PROFILE_H_
+# define VEC2DIC_PHASE_PROFILE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include <chrono>         // std::chrono::steady_clock
+#include <map>            // std::map
+#include <string>         // std::string
+
+///////////
+// Types //
+///////////
+
+/**
+ * Accumulated timings of phases.
+ */
+using phase_profile_t = struct PhaseProfile {
+  /// wall-clock seconds spent in each phase
+  std::map<std::string, double> m_seconds {};
+  /// number of times each phase was entered
+  std::map<std::string, size_t> m_counts {};
+
+  /// forget all timings
+  void clear() {
+    m_seconds.clear();
+    m_counts.clear();
+  }
+};
+
+/////////////
+// Classes //
+/////////////
+
+/**
+ * Scoped timer of a phase.
+ */
+class PhaseTimer {
+ public:
+  /**
+   * Start timing a phase
+   *
+   * @param a_phase - name of the phase (has to outlive the timer)
+   */
+  explicit PhaseTimer(const char *a_phase);
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  /// add the elapsed time to the profile (unless stopped before)
+  ~PhaseTimer() {
+    stop();
+  }
+
+  /// add the elapsed time to the profile and stop timing
+  void stop();
+
+ private:
+  /// name of the phase
+  const char *m_phase;
+  /// profile of the calling thread (\c nullptr if none is active)
+  phase_profile_t *m_profile;
+  /// time at which the phase was entered
+  std::chrono::steady_clock::time_point m_start {};
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Activate profile for the calling thread
+ *
+ * @param a_profile - profile to which timings should be added
+ *                    (\c nullptr deactivates profiling)
+ *
+ * @return \c void
+ */
+void set_phase_profile(phase_profile_t *a_profile);
+
+#endif    // VEC2DIC_PHASE_PROFILE_H_
@@ -0,0 +1,211 @@
+/** @file pq_store.cpp
+ *
+ *  @brief product-quantized store of neural word embeddings.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/pq_store.h"
+#include "src/vec2dic/nwe_view.h"
+
+#include <algorithm>                    // std::min()
+#include <limits>                       // std::numeric_limits
+
+#ifdef _OPENMP
+# include <omp.h>                       // omp_get_max_threads()
+#endif
+
+///////////////
+// Constants //
+///////////////
+
+/** Maximum number of vectors used for learning the codebooks */
+static const size_t PQ_TRAIN_SAMPLES = 32768;
+
+/** Number of k-means iterations per subspace */
+static const int PQ_KMEANS_ITERS = 12;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Find codeword nearest to a subvector
+ *
+ * @param a_codebooks - codewords of all subspaces
+ * @param a_first - first coordinate of the subspace
+ * @param a_last - coordinate after the last one of the subspace
+ * @param a_vec - full vector whose subvector should be encoded
+ *
+ * @return code of the nearest codeword
+ */
+template <typename eT>
+static uint8_t _pq_nearest_code(const arma::fmat *a_codebooks,
+                                const size_t a_first, const size_t a_last,
+                                const eT *a_vec) {
+  uint8_t ret = 0;
+  const float *icodeword;
+  float idiff, idistance, mindistance = std::numeric_limits<float>::max();
+  for (size_t k = 0; k < PQ_N_CODES; ++k) {
+    icodeword = a_codebooks->colptr(k);
+    idistance = 0.;
+    for (size_t r = a_first; r < a_last; ++r) {
+      idiff = a_vec[r] - icodeword[r];
+      idistance += idiff * idiff;
+    }
+    if (idistance < mindistance) {
+      mindistance = idistance;
+      ret = k;
+    }
+  }
+  return ret;
+}
+
+/**
+ * Learn codebook of a single subspace with the k-means algorithm
+ *
+ * The codewords are initialized with evenly spaced sample vectors.
+ * Codewords of empty clusters keep their previous position.
+ *
+ * @param a_codebooks - codewords of all subspaces (only the rows of
+ *                      the given subspace are modified)
+ * @param a_first - first coordinate of the subspace
+ * @param a_last - coordinate after the last one of the subspace
+ * @param a_sample - training vectors (one per column)
+ *
+ * @return \c void
+ */
+static void _pq_kmeans(arma::fmat *a_codebooks,
+                       const size_t a_first, const size_t a_last,
+                       const arma::fmat *a_sample) {
+  const size_t n_sample = a_sample->n_cols;
+  for (size_t k = 0; k < PQ_N_CODES; ++k)
+    for (size_t r = a_first; r < a_last; ++r)
+      (*a_codebooks)(r, k) = (*a_sample)(r, k * n_sample / PQ_N_CODES);
+
+  std::vector<uint8_t> labels(n_sample);
+  std::vector<double> sums;
+  std::vector<size_t> counts;
+  const size_t n_dims = a_last - a_first;
+  const float *ivec;
+  double *isum;
+  for (int it = 0; it < PQ_KMEANS_ITERS; ++it) {
+    for (size_t i = 0; i < n_sample; ++i)
+      labels[i] = _pq_nearest_code(a_codebooks, a_first, a_last,
+                                   a_sample->colptr(i));
+
+    sums.assign(n_dims * PQ_N_CODES, 0.);
+    counts.assign(PQ_N_CODES, 0);
+    for (size_t i = 0; i < n_sample; ++i) {
+      ivec = a_sample->colptr(i) + a_first;
+      isum = &sums[labels[i] * n_dims];
+      for (size_t r = 0; r < n_dims; ++r)
+        isum[r] += ivec[r];
+      ++counts[labels[i]];
+    }
+
+    for (size_t k = 0; k < PQ_N_CODES; ++k) {
+      if (counts[k] == 0)
+        continue;
+
+      isum = &sums[k * n_dims];
+      for (size_t r = 0; r < n_dims; ++r)
+        (*a_codebooks)(a_first + r, k) = isum[r] / counts[k];
+    }
+  }
+}
+
+template <typename eT>
+void train_pq_store(pq_store_t *a_pq, const NWEView<eT> *a_nwe,
+                    size_t a_n_subspaces) {
+  const size_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  a_n_subspaces = std::max<size_t>(1, std::min(a_n_subspaces, n_rows));
+
+  a_pq->m_n_rows = n_rows;
+  a_pq->m_n_cols = n_cols;
+  a_pq->m_n_subspaces = a_n_subspaces;
+  a_pq->m_offsets.resize(a_n_subspaces + 1);
+  for (size_t m = 0; m <= a_n_subspaces; ++m)
+    a_pq->m_offsets[m] = m * n_rows / a_n_subspaces;
+  a_pq->m_codebooks.zeros(n_rows, PQ_N_CODES);
+  a_pq->m_codes.resize(n_cols * a_n_subspaces);
+  if (n_cols == 0)
+    return;
+
+  // learn codebooks on an evenly spaced sample of the vocabulary
+  const size_t n_sample = std::min<vid_t>(n_cols, PQ_TRAIN_SAMPLES);
+  arma::fmat sample(n_rows, n_sample);
+  std::vector<eT> buf(n_rows);
+  const eT *ivec;
+  float *isample;
+  for (size_t i = 0; i < n_sample; ++i) {
+    ivec = a_nwe->col(i * n_cols / n_sample, buf.data());
+    isample = sample.colptr(i);
+    for (size_t r = 0; r < n_rows; ++r)
+      isample[r] = ivec[r];
+  }
+
+  const std::vector<size_t> &offsets = a_pq->m_offsets;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t m = 0; m < a_n_subspaces; ++m)
+    _pq_kmeans(&a_pq->m_codebooks, offsets[m], offsets[m + 1], &sample);
+
+  // encode all vectors
+#pragma omp parallel
+  {
+    std::vector<eT> ibuf(n_rows);
+    const eT *ivec;
+    uint8_t *icodes;
+#pragma omp for schedule(static)
+    for (vid_t i = 0; i < n_cols; ++i) {
+      ivec = a_nwe->col(i, ibuf.data());
+      icodes = &a_pq->m_codes[i * a_n_subspaces];
+      for (size_t m = 0; m < a_n_subspaces; ++m)
+        icodes[m] = _pq_nearest_code(&a_pq->m_codebooks, offsets[m],
+                                     offsets[m + 1], ivec);
+    }
+  }
+}
+
+void pq_decode(const pq_store_t *a_pq, const vid_t a_vecid, double *a_vec) {
+  const uint8_t *codes = &a_pq->m_codes[a_vecid * a_pq->m_n_subspaces];
+  const float *icodeword;
+  for (size_t m = 0; m < a_pq->m_n_subspaces; ++m) {
+    icodeword = a_pq->m_codebooks.colptr(codes[m]);
+    for (size_t r = a_pq->m_offsets[m]; r < a_pq->m_offsets[m + 1]; ++r)
+      a_vec[r] = icodeword[r];
+  }
+}
+
+void pq_adc_table(const pq_store_t *a_pq, const double *a_query,
+                  float *a_table) {
+  const float *icodeword;
+  double idiff, idistance;
+  for (size_t m = 0; m < a_pq->m_n_subspaces; ++m) {
+    for (size_t k = 0; k < PQ_N_CODES; ++k) {
+      icodeword = a_pq->m_codebooks.colptr(k);
+      idistance = 0.;
+      for (size_t r = a_pq->m_offsets[m]; r < a_pq->m_offsets[m + 1]; ++r) {
+        idiff = a_query[r] - icodeword[r];
+        idistance += idiff * idiff;
+      }
+      a_table[m * PQ_N_CODES + k] = idistance;
+    }
+  }
+}
+
+size_t pq_memory(const pq_store_t *a_pq) {
+  return a_pq->m_codes.size() * sizeof(uint8_t)
+      + a_pq->m_codebooks.n_elem * sizeof(float);
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template void train_pq_store<float>(pq_store_t *, const NWEView<float> *,
+                                    size_t);
+template void train_pq_store<double>(pq_store_t *, const NWEView<double> *,
+                                     size_t);
@@ -0,0 +1,130 @@
+/** @file pq_store.h
+ *
+ *  @brief product-quantized store of neural word embeddings.
+ *
+ *  This file declares a compressed representation of neural word
+ *  embeddings based on product quantization.  The coordinates of the
+ *  vectors are split into `M` consecutive subspaces, each of which is
+ *  quantized independently with a codebook of 256 codewords learned by
+ *  k-means, so that every vector is stored as `M` one-byte codes.
+ *
+ *  Squared Euclidean distances between an uncompressed query and the
+ *  stored vectors are computed asymmetrically: the distances between
+ *  the query and all codewords are tabulated once, after which the
+ *  distance to every stored vector only takes `M` table lookups.
+ */
+
+#ifndef VEC2DIC_PQ_STORE_H_
+# define VEC2DIC_PQ_STORE_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <armadillo>      // arma::fmat
+#include <cstdint>        // uint8_t
+#include <cstdlib>        // size_t
+#include <vector>         // std::vector
+
+///////////////
+// Constants //
+///////////////
+
+/** Number of codewords per subspace */
+const size_t PQ_N_CODES = 256;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Product-quantized word vectors.
+ */
+using pq_store_t = struct PQStore {
+  /// number of coordinates per vector
+  size_t m_n_rows = 0;
+  /// number of vectors
+  vid_t m_n_cols = 0;
+  /// number of subspaces (bytes per vector)
+  size_t m_n_subspaces = 0;
+  /// first coordinate of each subspace (`m_n_subspaces + 1` offsets)
+  std::vector<size_t> m_offsets;
+  /// codewords (column `k` holds the `k`-th codeword of every subspace
+  /// in the rows of the respective subspace)
+  arma::fmat m_codebooks;
+  /// codes of the vectors (`m_n_subspaces` per vector)
+  std::vector<uint8_t> m_codes;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Learn codebooks from word embeddings and encode them
+ *
+ * @param a_pq - store to populate
+ * @param a_nwe - matrix of neural word embeddings
+ * @param a_n_subspaces - number of subspaces (at most the number of
+ *                        coordinates)
+ *
+ * @return \c void
+ */
+template <typename eT>
+void train_pq_store(pq_store_t *a_pq, const NWEView<eT> *a_nwe,
+                    size_t a_n_subspaces);
+
+/**
+ * Reconstruct a stored vector from its codes
+ *
+ * @param a_pq - product-quantized store
+ * @param a_vecid - id of the vector
+ * @param a_vec - output array of `m_n_rows` coordinates
+ *
+ * @return \c void
+ */
+void pq_decode(const pq_store_t *a_pq, const vid_t a_vecid, double *a_vec);
+
+/**
+ * Tabulate squared distances between a query and all codewords
+ *
+ * @param a_pq - product-quantized store
+ * @param a_query - query vector of `m_n_rows` coordinates
+ * @param a_table - output table of `m_n_subspaces * PQ_N_CODES`
+ *                  distances
+ *
+ * @return \c void
+ */
+void pq_adc_table(const pq_store_t *a_pq, const double *a_query,
+                  float *a_table);
+
+/**
+ * Compute approximate squared distance between a query and a stored vector
+ *
+ * @param a_pq - product-quantized store
+ * @param a_table - distance table of the query
+ * @param a_vecid - id of the stored vector
+ *
+ * @return approximate squared Euclidean distance
+ */
+inline dist_t pq_adc_distance(const pq_store_t *a_pq, const float *a_table,
+                              const vid_t a_vecid) {
+  const size_t n_subspaces = a_pq->m_n_subspaces;
+  const uint8_t *codes = &a_pq->m_codes[a_vecid * n_subspaces];
+  float ret = 0.;
+  for (size_t m = 0; m < n_subspaces; ++m, a_table += PQ_N_CODES)
+    ret += a_table[codes[m]];
+  return ret;
+}
+
+/**
+ * Return number of bytes occupied by the store
+ *
+ * @param a_pq - product-quantized store
+ *
+ * @return size of codes and codebooks in bytes
+ */
+size_t pq_memory(const pq_store_t *a_pq);
+
+#endif    // VEC2DIC_PQ_STORE_H_
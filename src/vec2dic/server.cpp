@@ -0,0 +1,589 @@
+/** @file server.cpp
+ *
+ *  @brief resident server answering expansion requests over a Unix
+ *  domain socket.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/server.h"
+#include "src/vec2dic/lexicon_io.h"
+
+#include <errno.h>        // errno
+#include <fcntl.h>        // fcntl()
+#include <poll.h>         // poll()
+#include <signal.h>       // sigaction()
+#include <sys/socket.h>   // socket(), bind(), listen(), accept()
+#include <sys/stat.h>     // stat()
+#include <sys/un.h>       // sockaddr_un
+#include <unistd.h>       // close(), pipe(), unlink()
+
+#include <algorithm>      // std::max()
+#include <chrono>         // std::chrono::steady_clock
+#include <condition_variable>  // std::condition_variable
+#include <cstring>        // memset(), strerror()
+#include <deque>          // std::deque
+#include <iostream>       // std::cerr
+#include <memory>         // std::unique_ptr
+#include <mutex>          // std::mutex
+#include <sstream>        // std::istringstream, std::ostringstream
+#include <stdexcept>      // std::exception
+#include <thread>         // std::thread
+#include <unordered_map>  // std::unordered_map
+#include <utility>        // std::move(), std::pair
+#include <vector>         // std::vector
+
+#ifdef _OPENMP
+# include <omp.h>         // omp_set_num_threads()
+#endif
+
+///////////////
+// Constants //
+///////////////
+
+const int DFLT_SERVER_WORKERS = 4;
+
+/** Maximum length of a request line in bytes */
+static const size_t MAX_LINE_LENGTH = 1 << 20;
+
+/** Interval in milliseconds in which the server checks for shutdown */
+static const int POLL_INTERVAL = 500;
+
+/** Number of expansion types */
+static const size_t N_TYPES = static_cast<size_t>(ExpansionType::MAX_SENTINEL);
+
+/** Number of distinct expanders (one per type and normalization) */
+static const size_t N_EXPANDERS = N_TYPES * N_NORMALIZATIONS;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Complete request received over a connection.
+ */
+using request_t = struct Request {
+  /// socket of the connection to answer
+  int m_fd = -1;
+  /// header line (empty until it has been received)
+  std::string m_header {};
+  /// lines with the seed terms
+  std::vector<std::string> m_seed_lines {};
+  /// time at which the request was received completely
+  std::chrono::steady_clock::time_point m_start {};
+};
+
+/**
+ * Expander of one type and normalization.
+ */
+using expander_slot_t = struct ExpanderSlot {
+  /// guard of the construction of the expander
+  std::mutex m_mutex {};
+  /// expander (built on first use)
+  std::unique_ptr<Expander> m_expander {};
+};
+
+/**
+ * State shared by the receiving thread and the workers of a server.
+ */
+using server_state_t = struct ServerState {
+  /// word vectors
+  const EmbeddingStore *m_store = nullptr;
+  /// default options of the requests
+  expander_options_t m_defaults {};
+  /// guard of the queues and the counters
+  std::mutex m_mutex {};
+  /// signals new requests and shutdown to the workers
+  std::condition_variable m_cond {};
+  /// received requests waiting for a worker
+  std::deque<request_t> m_requests {};
+  /// sockets of answered requests together with whether their
+  /// connections are still usable
+  std::vector<std::pair<int, bool>> m_answered {};
+  /// write end of the pipe which wakes up the receiving thread
+  int m_wake_fd = -1;
+  /// whether the server is shutting down
+  bool m_stop = false;
+  /// number of requests served so far
+  unsigned long m_n_requests = 0;
+  /// expanders of each type and normalization
+  expander_slot_t m_expanders[N_EXPANDERS];
+};
+
+/**
+ * Buffered reader of a connection.
+ */
+using connection_t = struct Connection {
+  /// socket of the connection
+  int m_fd = -1;
+  /// received but not yet consumed data
+  std::string m_buffer {};
+  /// request being received
+  request_t m_request {};
+  /// whether a worker is answering a request of the connection (its
+  /// further requests wait until the answer has been sent)
+  bool m_busy = false;
+  /// whether the client has finished sending
+  bool m_eof = false;
+};
+
+///////////////
+// Variables //
+///////////////
+
+/// set by the signal handler once the server should shut down
+static volatile sig_atomic_t s_stop = 0;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Request shutdown of the server
+ *
+ * @param a_signal - received signal
+ *
+ * @return \c void
+ */
+static void _on_signal(int) {
+  s_stop = 1;
+}
+
+/**
+ * Receive available data of a connection
+ *
+ * @param a_conn - connection to read from
+ *
+ * @return \c true on success (including end of file), \c false on error
+ */
+static bool _receive(connection_t *a_conn) {
+  char buf[4096];
+  ssize_t n;
+  while ((n = recv(a_conn->m_fd, buf, sizeof(buf), MSG_DONTWAIT)) < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return true;
+    if (errno != EINTR)
+      return false;
+  }
+  if (n == 0)
+    a_conn->m_eof = true;
+  else
+    a_conn->m_buffer.append(buf, n);
+  return true;
+}
+
+/**
+ * Extract the next complete request from the received data
+ *
+ * @param a_conn - connection whose data should be consumed
+ * @param a_request - request to populate
+ *
+ * @return \c 1 if a request was extracted, \c 0 if more data is needed,
+ *   \c -1 if a line is overlong
+ */
+static int _next_request(connection_t *a_conn, request_t *a_request) {
+  request_t *request = &a_conn->m_request;
+  std::string &buffer = a_conn->m_buffer;
+  std::string line;
+  size_t pos = 0, eol;
+  int ret = 0;
+  while (ret == 0 && (eol = buffer.find('\n', pos)) != std::string::npos) {
+    line.assign(buffer, pos, eol - pos);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    pos = eol + 1;
+    if (request->m_header.empty()) {
+      // tolerate blank lines between requests
+      request->m_header = line;
+    } else if (line.empty()) {
+      *a_request = std::move(*request);
+      *request = request_t();
+      ret = 1;
+    } else {
+      request->m_seed_lines.push_back(line);
+    }
+  }
+  buffer.erase(0, pos);
+  if (ret == 0 && buffer.size() > MAX_LINE_LENGTH)
+    return -1;
+  return ret;
+}
+
+/**
+ * Send a complete message over a connection
+ *
+ * @param a_fd - socket of the connection
+ * @param a_msg - message to send
+ *
+ * @return \c true on success, \c false otherwise
+ */
+static bool _write_all(const int a_fd, const std::string &a_msg) {
+  const char *data = a_msg.data();
+  size_t left = a_msg.size();
+  ssize_t n;
+  while (left > 0) {
+    if ((n = send(a_fd, data, left, MSG_NOSIGNAL)) < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += n;
+    left -= n;
+  }
+  return true;
+}
+
+/**
+ * Parse header line of a request
+ *
+ * @param a_options - algorithm and normalization to use (the defaults
+ *                    have to be set by the caller)
+ * @param a_params - parameters of the expansion (the defaults have to
+ *                   be set by the caller)
+ * @param a_line - header line
+ * @param a_error - description of the problem if the line is invalid
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+static int _parse_header(expander_options_t *a_options,
+                         expansion_params_t *a_params,
+                         const std::string &a_line, std::string *a_error) {
+  std::istringstream is(a_line);
+  std::string token;
+  if (!(is >> token) || token != "EXPAND") {
+    *a_error = "Unknown request '" + token + "'";
+    return 1;
+  }
+  while (is >> token) {
+    if (parse_expansion_setting(token, a_options, a_params, a_error))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Return expander of the given type and normalization (building it if
+ * necessary)
+ *
+ * @param a_state - state of the server
+ * @param a_options - requested algorithm and normalization (other
+ *                    options are those of the server)
+ *
+ * @return expander of the given type and normalization
+ *
+ * @throws std::invalid_argument if the type or normalization is not
+ *   supported with the options of the server
+ */
+static const Expander *_get_expander(server_state_t *a_state,
+                                     const expander_options_t &a_options) {
+  // only requests of the same type and normalization wait while the
+  // expander is being prepared
+  expander_slot_t &slot =
+      a_state->m_expanders[static_cast<size_t>(a_options.m_type)
+                           * N_NORMALIZATIONS
+                           + a_options.normalization_index()];
+  std::lock_guard<std::mutex> lock(slot.m_mutex);
+  if (!slot.m_expander)
+    slot.m_expander.reset(new Expander(a_state->m_store, a_options));
+  return slot.m_expander.get();
+}
+
+/**
+ * Answer a single request
+ *
+ * @param a_state - state of the server
+ * @param a_request - request to answer
+ *
+ * @return \c true if the answer was sent, \c false if the connection
+ *   is broken
+ */
+static bool _answer_request(server_state_t *a_state,
+                            request_t *a_request) {
+  std::string error;
+  w2ps_t seeds;
+  lexicon_t lexicon;
+  expander_options_t options = a_state->m_defaults;
+  expansion_params_t params;
+  unsigned long request_id;
+  params.m_n_terms = a_state->m_defaults.m_n_terms;
+  params.m_knn = a_state->m_defaults.m_knn;
+  bool ok = _parse_header(&options, &params, a_request->m_header,
+                          &error) == 0;
+  for (auto &line : a_request->m_seed_lines) {
+    if (!ok)
+      break;
+    if (parse_seed_line(&line, &seeds)) {
+      error = "Incorrect seed line '" + line + "'";
+      ok = false;
+    }
+  }
+
+  if (ok) {
+    try {
+      if (_get_expander(a_state, options)->expand(
+              &seeds, &lexicon, params.m_n_terms, params.m_knn)) {
+        error = "Expansion failed";
+        ok = false;
+      }
+    } catch (const std::exception &e) {
+      error = e.what();
+      ok = false;
+    }
+  }
+
+  std::ostringstream os;
+  if (ok) {
+    os << "OK " << lexicon.size() << '\n';
+    output_terms(os, &lexicon);
+  } else {
+    os << "ERROR " << error << '\n';
+  }
+  if (!_write_all(a_request->m_fd, os.str()))
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(a_state->m_mutex);
+    request_id = ++a_state->m_n_requests;
+  }
+  std::ostringstream log;
+  log << "Request #" << request_id << " (type "
+      << static_cast<int>(options.m_type) << ", length-normalize "
+      << !options.m_no_length_normalize << ", mean-normalize "
+      << !options.m_no_mean_normalize << ", k " << params.m_knn
+      << ", n-terms " << params.m_n_terms << "): ";
+  if (ok)
+    log << seeds.size() << " seeds, " << lexicon.size() << " terms";
+  else
+    log << "error: " << error;
+  log << " in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - a_request->m_start).count()
+      << " ms\n";
+  std::cerr << log.str();
+  return true;
+}
+
+/**
+ * Answer requests from the queue until the server shuts down
+ *
+ * @param a_state - state of the server
+ * @param a_n_threads - number of OpenMP threads per request
+ *
+ * @return \c void
+ */
+static void _worker(server_state_t *a_state, const int a_n_threads) {
+#ifdef _OPENMP
+  omp_set_num_threads(a_n_threads);
+#else
+  (void) a_n_threads;
+#endif
+  request_t request;
+  bool sent;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(a_state->m_mutex);
+      a_state->m_cond.wait(lock, [a_state] {
+          return a_state->m_stop || !a_state->m_requests.empty();});
+      if (a_state->m_requests.empty())
+        return;
+
+      request = std::move(a_state->m_requests.front());
+      a_state->m_requests.pop_front();
+    }
+    sent = _answer_request(a_state, &request);
+    {
+      std::lock_guard<std::mutex> lock(a_state->m_mutex);
+      a_state->m_answered.emplace_back(request.m_fd, sent);
+    }
+    // hand the connection back to the receiving thread (a full pipe
+    // means that it is going to wake up anyway)
+    while (write(a_state->m_wake_fd, "", 1) < 0 && errno == EINTR) {}
+  }
+}
+
+/**
+ * Queue the next complete request of a connection for the workers
+ *
+ * @param a_state - state of the server
+ * @param a_conn - connection (requests are only taken from connections
+ *                 which are not waiting for an answer)
+ *
+ * @return \c true if the connection is still usable, \c false if it
+ *   should be closed
+ */
+static bool _dispatch(server_state_t *a_state, connection_t *a_conn) {
+  if (a_conn->m_busy)
+    return true;
+
+  request_t request;
+  const int ret = _next_request(a_conn, &request);
+  if (ret < 0)
+    return false;
+  if (ret == 0)
+    return !a_conn->m_eof;
+
+  request.m_fd = a_conn->m_fd;
+  request.m_start = std::chrono::steady_clock::now();
+  a_conn->m_busy = true;
+  std::lock_guard<std::mutex> lock(a_state->m_mutex);
+  a_state->m_requests.push_back(std::move(request));
+  a_state->m_cond.notify_one();
+  return true;
+}
+
+int serve(const EmbeddingStore *a_store,
+          const expander_options_t &a_defaults,
+          const server_options_t &a_options) {
+  const char *path = a_options.m_socket.c_str();
+  const int n_workers = std::max(1, a_options.m_n_workers);
+  int n_threads = a_options.m_n_threads;
+#ifdef _OPENMP
+  if (n_threads <= 0)
+    n_threads = std::max(1, omp_get_num_procs() / n_workers);
+#else
+  n_threads = 1;
+#endif
+
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (a_options.m_socket.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path " << path << " is too long" << std::endl;
+    return 1;
+  }
+  a_options.m_socket.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+
+  // prepare the default expander before accepting any requests
+  server_state_t state;
+  state.m_store = a_store;
+  state.m_defaults = a_defaults;
+  try {
+    _get_expander(&state, a_defaults);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  // remove a stale socket of a previous server (but no other files)
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+
+  int wake_fds[2] = {-1, -1};
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0
+      || bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0
+      || listen(fd, SOMAXCONN) < 0) {
+    std::cerr << "Cannot listen on socket " << path << ": "
+              << strerror(errno) << std::endl;
+    if (fd >= 0)
+      close(fd);
+    return 1;
+  }
+  if (pipe(wake_fds) < 0
+      || fcntl(wake_fds[0], F_SETFL, O_NONBLOCK) < 0
+      || fcntl(wake_fds[1], F_SETFL, O_NONBLOCK) < 0) {
+    std::cerr << "Cannot create pipe: " << strerror(errno) << std::endl;
+    if (wake_fds[0] >= 0) {
+      close(wake_fds[0]);
+      close(wake_fds[1]);
+    }
+    close(fd);
+    unlink(path);
+    return 1;
+  }
+  state.m_wake_fd = wake_fds[1];
+
+  struct sigaction action, old_int, old_term;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = _on_signal;
+  sigemptyset(&action.sa_mask);
+  s_stop = 0;
+  sigaction(SIGINT, &action, &old_int);
+  sigaction(SIGTERM, &action, &old_term);
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < n_workers; ++i)
+    workers.emplace_back(_worker, &state, n_threads);
+
+  std::cerr << "Serving requests on " << path << " (" << n_workers
+            << " workers with " << n_threads << " threads each)"
+            << std::endl;
+
+  // this thread receives the requests of all connections, so that idle
+  // connections do not occupy any worker
+  std::unordered_map<int, connection_t> conns;
+  std::vector<std::pair<int, bool>> answered;
+  std::vector<pollfd> pfds;
+  char drain[256];
+  int cfd;
+  while (!s_stop) {
+    pfds.clear();
+    pfds.push_back(pollfd{fd, POLLIN, 0});
+    pfds.push_back(pollfd{wake_fds[0], POLLIN, 0});
+    for (auto &conn : conns) {
+      if (!conn.second.m_busy)
+        pfds.push_back(pollfd{conn.first, POLLIN, 0});
+    }
+    if (poll(pfds.data(), pfds.size(), POLL_INTERVAL) <= 0)
+      continue;
+
+    // take back the connections whose requests have been answered
+    if (pfds[1].revents) {
+      while (read(wake_fds[0], drain, sizeof(drain)) == sizeof(drain)) {}
+      {
+        std::lock_guard<std::mutex> lock(state.m_mutex);
+        answered.swap(state.m_answered);
+      }
+      for (auto &answer : answered) {
+        connection_t &conn = conns[answer.first];
+        conn.m_busy = false;
+        if (!answer.second || !_dispatch(&state, &conn)) {
+          close(answer.first);
+          conns.erase(answer.first);
+        }
+      }
+      answered.clear();
+    }
+
+    for (size_t i = 2; i < pfds.size(); ++i) {
+      if (pfds[i].revents == 0)
+        continue;
+
+      connection_t &conn = conns[pfds[i].fd];
+      if (!_receive(&conn) || !_dispatch(&state, &conn)) {
+        close(pfds[i].fd);
+        conns.erase(pfds[i].fd);
+      }
+    }
+
+    if (pfds[0].revents && (cfd = accept(fd, nullptr, nullptr)) >= 0)
+      conns[cfd].m_fd = cfd;
+  }
+
+  // drop waiting requests and interrupt the answers being sent
+  // (requests which are being expanded are finished first)
+  std::cerr << "Shutting down server" << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(state.m_mutex);
+    state.m_stop = true;
+    state.m_requests.clear();
+    for (auto &conn : conns) {
+      if (conn.second.m_busy)
+        shutdown(conn.first, SHUT_RDWR);
+    }
+  }
+  state.m_cond.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+
+  for (auto &conn : conns)
+    close(conn.first);
+  close(wake_fds[0]);
+  close(wake_fds[1]);
+  close(fd);
+  unlink(path);
+  sigaction(SIGINT, &old_int, nullptr);
+  sigaction(SIGTERM, &old_term, nullptr);
+  return 0;
+}
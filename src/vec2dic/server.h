@@ -0,0 +1,81 @@
+/** @file server.h
+ *
+ *  @brief resident server answering expansion requests over a Unix
+ *  domain socket.
+ *
+ *  The server keeps the word vectors of an `EmbeddingStore` in memory
+ *  and serves requests with a fixed pool of worker threads, so that
+ *  the latency of a request only comprises the expansion itself.  A
+ *  single thread receives the requests of all connections and hands
+ *  complete requests to the workers, so that idle connections do not
+ *  occupy any worker.  Clients may send any number of requests over
+ *  one connection, which are answered in order.  A
+ *  request is a header line followed by the seed terms (in the format
+ *  of seed set files) and terminated by an empty line:
+ *
+ *      EXPAND [type=T] [k=K] [n-terms=N]
+ *      gut<TAB>positive
+ *      schlecht<TAB>negative
+ *      <empty line>
+ *
+ *  Omitted parameters take the values given on the command line of the
+ *  server.  The response is either `OK COUNT`, followed by `COUNT`
+ *  lines of the generated lexicon (term, polarity, and score separated
+ *  by tabs), or a single line `ERROR MESSAGE`.
+ */
+
+#ifndef VEC2DIC_SERVER_H_
+# define VEC2DIC_SERVER_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/expander.h"
+
+#include <string>         // std::string
+
+///////////////
+// Constants //
+///////////////
+
+/** Default number of requests served concurrently */
+extern const int DFLT_SERVER_WORKERS;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Options of the server.
+ */
+using server_options_t = struct ServerOptions {
+  /// path of the Unix domain socket
+  std::string m_socket {};
+  /// number of requests served concurrently
+  int m_n_workers = DFLT_SERVER_WORKERS;
+  /// number of OpenMP threads used by each request (0 means share all
+  /// available cores among the workers)
+  int m_n_threads = 0;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Serve expansion requests until SIGINT or SIGTERM is received
+ *
+ * @param a_store - loaded word vectors
+ * @param a_defaults - default options of the requests (compression
+ *                     and index options cannot be changed by requests)
+ * @param a_options - options of the server
+ *
+ * @return \c 0 on orderly shutdown, non-\c 0 if the socket could not be
+ *   set up
+ */
+int serve(const EmbeddingStore *a_store,
+          const expander_options_t &a_defaults,
+          const server_options_t &a_options);
+
+#endif    // VEC2DIC_SERVER_H_
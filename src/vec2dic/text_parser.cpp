@@ -0,0 +1,433 @@
+/** @file text_parser.cpp
+ *
+ *  @brief parallel parser of textual word2vec files.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/text_parser.h"
+
+#include <fcntl.h>                      // open()
+#include <sys/mman.h>                   // madvise(), mmap(), munmap()
+#include <sys/stat.h>                   // fstat()
+#include <unistd.h>                     // close()
+
+#include <cstdint>                      // uint64_t
+#include <cstdio>                       // sscanf()
+#include <cstdlib>                      // strtof()
+#include <cstring>                      // memchr(), memcpy()
+#include <algorithm>                    // std::min(), std::max()
+#include <iostream>                     // std::cerr
+#include <string>                       // std::string
+
+#ifdef _OPENMP
+# include <omp.h>                       // omp_get_max_threads()
+#endif
+
+///////////////
+// Constants //
+///////////////
+
+/** Minimum number of bytes of a chunk parsed by one thread */
+static const size_t MIN_CHUNK_SIZE = 1 << 16;
+
+/** Number of chunks per thread (for balancing the load) */
+static const size_t CHUNKS_PER_THREAD = 8;
+
+/** Largest mantissa which is exactly representable as float */
+static const uint64_t MAX_EXACT_MANTISSA = 1 << 24;
+
+/** Powers of ten which are exactly representable as float */
+static const float EXACT_POW10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                    1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+/** Largest exponent in `EXACT_POW10` */
+static const int MAX_EXACT_EXP = 10;
+
+/** Maximum length of a number copied for `strtof()` */
+static const size_t MAX_NUMBER_LEN = 64;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Kinds of malformed lines.
+ */
+enum class LineError: int {
+  NONE = 0,                   // line is correct
+    MISSING_WORD,             // line does not start with a word
+    VECTOR_SIZE               // line has too few coordinates
+    };
+
+/**
+ * Chunk of lines parsed by one thread.
+ */
+using text_chunk_t = struct TextChunk {
+  /// first character of the chunk
+  const char *m_start = nullptr;
+  /// end of the chunk (after its last newline)
+  const char *m_end = nullptr;
+  /// vector id of the first line of the chunk
+  vid_t m_first_col = 0;
+  /// number of lines of the chunk
+  vid_t m_n_lines = 0;
+  /// first malformed line of the chunk
+  LineError m_error = LineError::NONE;
+  /// vector id of the malformed line
+  vid_t m_error_col = 0;
+  /// number of coordinates read from the malformed line
+  vid_t m_error_rows = 0;
+  /// start of the malformed line
+  const char *m_error_line = nullptr;
+  /// end of the malformed line
+  const char *m_error_line_end = nullptr;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Check whether character is a blank (like `std::isspace()` in the C
+ * locale)
+ *
+ * @param a_c - character to check
+ *
+ * @return \c true if the character is a blank
+ */
+static inline bool _is_space(const char a_c) {
+  return a_c == ' ' || (a_c >= '\t' && a_c <= '\r');
+}
+
+/**
+ * Parse a number with `strtof()`
+ *
+ * The number is copied to a terminated buffer first, because the
+ * mapped file is not terminated.
+ *
+ * @param a_pos - start of the number
+ * @param a_end - end of the line
+ * @param a_value - parsed number
+ *
+ * @return position after the number or \c nullptr if there is none
+ */
+static const char *_strtof(const char *a_pos, const char *a_end,
+                           float *a_value) {
+  const char *end = a_pos;
+  while (end < a_end && !_is_space(*end))
+    ++end;
+
+  char buf[MAX_NUMBER_LEN + 1], *num_end;
+  std::string long_buf;
+  const char *num = buf;
+  const size_t len = end - a_pos;
+  if (len <= MAX_NUMBER_LEN) {
+    memcpy(buf, a_pos, len);
+    buf[len] = '\0';
+  } else {
+    long_buf.assign(a_pos, len);
+    num = long_buf.c_str();
+  }
+  *a_value = strtof(num, &num_end);
+  if (num_end == num)
+    return nullptr;
+  return a_pos + (num_end - num);
+}
+
+/**
+ * Parse a floating-point number
+ *
+ * Decimal numbers with at most 24 significant bits and small decimal
+ * exponents (i.e., the vast majority of coordinates written by
+ * word2vec and similar tools) are converted by a single
+ * floating-point operation, which rounds correctly because both of
+ * its operands are exact.  All other numbers are passed on to
+ * `strtof()`, so that the result is always the same as that of
+ * `sscanf("%f")`.
+ *
+ * @param a_pos - start of the number
+ * @param a_end - end of the line
+ * @param a_value - parsed number
+ *
+ * @return position after the number or \c nullptr if there is none
+ */
+static inline const char *_parse_float(const char *a_pos,
+                                       const char *a_end, float *a_value) {
+  const char *s = a_pos;
+  const bool negative = s < a_end && *s == '-';
+  if (s < a_end && (*s == '-' || *s == '+'))
+    ++s;
+  // leave hexadecimal numbers, infinities, and NaNs to `strtof()`
+  if (s == a_end || (*s == '0' && s + 1 < a_end && (s[1] | 0x20) == 'x'))
+    return _strtof(a_pos, a_end, a_value);
+
+  uint64_t mantissa = 0;
+  int exponent = 0, n_digits = 0;
+  for (; s < a_end && *s >= '0' && *s <= '9'; ++s, ++n_digits)
+    mantissa = mantissa * 10 + (*s - '0');
+  if (s < a_end && *s == '.') {
+    for (++s; s < a_end && *s >= '0' && *s <= '9'; ++s, ++n_digits) {
+      mantissa = mantissa * 10 + (*s - '0');
+      --exponent;
+    }
+  }
+  if (n_digits == 0 || n_digits > 19)
+    return _strtof(a_pos, a_end, a_value);
+
+  // the exponent only belongs to the number if it has digits
+  if (s < a_end && (*s | 0x20) == 'e') {
+    const char *e = s + 1;
+    const bool negative_exp = e < a_end && *e == '-';
+    if (e < a_end && (*e == '-' || *e == '+'))
+      ++e;
+    if (e < a_end && *e >= '0' && *e <= '9') {
+      int exp_value = 0;
+      for (; e < a_end && *e >= '0' && *e <= '9'; ++e)
+        if (exp_value < 10000)
+          exp_value = exp_value * 10 + (*e - '0');
+      exponent += negative_exp? -exp_value: exp_value;
+      s = e;
+    }
+  }
+  if (mantissa > MAX_EXACT_MANTISSA || exponent < -MAX_EXACT_EXP
+      || exponent > MAX_EXACT_EXP)
+    return _strtof(a_pos, a_end, a_value);
+
+  float value = static_cast<float>(mantissa);
+  if (exponent < 0)
+    value /= EXACT_POW10[-exponent];
+  else
+    value *= EXACT_POW10[exponent];
+  *a_value = negative? -value: value;
+  return s;
+}
+
+/**
+ * Parse all lines of a chunk
+ *
+ * Parsing stops at the first malformed line, which is recorded in the
+ * chunk.
+ *
+ * @param a_chunk - chunk to parse
+ * @param a_nwe - matrix to populate
+ * @param a_words - positions of the words
+ * @param a_data - start of the mapped file
+ *
+ * @return \c void
+ */
+template <typename eT>
+static void _parse_chunk(text_chunk_t *a_chunk, arma::Mat<eT> *a_nwe,
+                         std::vector<text_word_t> *a_words,
+                         const char *a_data) {
+  const vid_t n_rows = a_nwe->n_rows;
+  const vid_t n_cols = a_nwe->n_cols;
+  const char *line = a_chunk->m_start, *line_end, *word_end, *pos;
+  vid_t irow;
+  float value;
+  eT *column;
+  for (vid_t icol = a_chunk->m_first_col;
+       icol < n_cols && line < a_chunk->m_end; ++icol) {
+    line_end = static_cast<const char *>(
+        memchr(line, '\n', a_chunk->m_end - line));
+    if (line_end == nullptr)
+      line_end = a_chunk->m_end;
+
+    // the word extends up to the first space or tab (without the
+    // blanks preceding it); lines without any of them (e.g., empty
+    // lines) fail because of their missing coordinates
+    for (word_end = line; word_end < line_end && *word_end != ' '
+           && *word_end != '\t'; ++word_end) {}
+    pos = word_end;
+    while (word_end > line && _is_space(word_end[-1]))
+      --word_end;
+    if (word_end == line && pos < line_end) {
+      a_chunk->m_error = LineError::MISSING_WORD;
+      goto error_exit;
+    }
+    (*a_words)[icol].m_offset = line - a_data;
+    (*a_words)[icol].m_length = word_end - line;
+
+    column = a_nwe->colptr(icol);
+    for (irow = 0; irow < n_rows; ++irow) {
+      while (pos < line_end && _is_space(*pos))
+        ++pos;
+      if (pos == line_end
+          || (pos = _parse_float(pos, line_end, &value)) == nullptr)
+        break;
+      column[irow] = value;
+    }
+    if (irow != n_rows) {
+      a_chunk->m_error = LineError::VECTOR_SIZE;
+      a_chunk->m_error_rows = irow;
+      goto error_exit;
+    }
+    line = line_end + 1;
+    continue;
+
+ error_exit:
+    a_chunk->m_error_col = icol;
+    a_chunk->m_error_line = line;
+    a_chunk->m_error_line_end = line_end;
+    return;
+  }
+}
+
+int map_text_file(const char *a_fname, text_map_t *a_map) {
+  struct stat st;
+  void *addr;
+  int fd = open(a_fname, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Cannot open file " << a_fname << std::endl;
+    return 1;
+  }
+  if (fstat(fd, &st) != 0) {
+    std::cerr << "Failed to read vector file " << a_fname << std::endl;
+    close(fd);
+    return 1;
+  }
+  *a_map = text_map_t();
+  if (st.st_size == 0) {
+    close(fd);
+    a_map->m_data = "";
+    return 0;
+  }
+
+  addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "Cannot map file " << a_fname << std::endl;
+    return 1;
+  }
+  // every chunk is read from its beginning to its end
+  madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+  a_map->m_addr = addr;
+  a_map->m_data = static_cast<const char *>(addr);
+  a_map->m_size = st.st_size;
+  return 0;
+}
+
+void unmap_text_file(text_map_t *a_map) {
+  if (a_map->m_addr != nullptr)
+    munmap(a_map->m_addr, a_map->m_size);
+
+  *a_map = text_map_t();
+}
+
+template <typename eT>
+int parse_text_vectors(const text_map_t *a_map,
+                       std::unique_ptr<arma::Mat<eT>> *a_nwe,
+                       std::vector<text_word_t> *a_words) {
+  const char *data = a_map->m_data;
+  const char *end = data + a_map->m_size;
+  const char *pos = data, *line_end;
+  vid_t mrows = 0, ncolumns = 0;
+
+  // skip empty lines at the beginning of file
+  while (pos < end && *pos == '\n')
+    ++pos;
+  line_end = static_cast<const char *>(memchr(pos, '\n', end - pos));
+  if (line_end == nullptr)
+    line_end = end;
+  const std::string header(pos, line_end);
+  // initialize matrix (columns represent words, rows are coordinates)
+  if (sscanf(header.c_str(), "%llu %llu", &ncolumns, &mrows) != 2) {
+    std::cerr << "Incorrect declaration line format: '"
+              << header << std::endl;
+    return 1;
+  }
+  pos = line_end < end? line_end + 1: end;
+
+  // split remaining lines into chunks which end after a newline
+  size_t n_threads = 1;
+#ifdef _OPENMP
+  n_threads = omp_get_max_threads();
+#endif
+  const size_t body_size = end - pos;
+  const size_t n_chunks = std::max<size_t>(
+      1, std::min(body_size / MIN_CHUNK_SIZE,
+                  n_threads * CHUNKS_PER_THREAD));
+  std::vector<text_chunk_t> chunks(n_chunks);
+  const char *chunk_end = pos;
+  for (size_t c = 0; c < n_chunks; ++c) {
+    chunks[c].m_start = chunk_end;
+    if (c + 1 == n_chunks) {
+      chunk_end = end;
+    } else {
+      chunk_end = std::max(chunk_end, pos + (c + 1) * body_size / n_chunks);
+      if (chunk_end > data && chunk_end[-1] != '\n') {
+        chunk_end = static_cast<const char *>(
+            memchr(chunk_end, '\n', end - chunk_end));
+        chunk_end = chunk_end == nullptr? end: chunk_end + 1;
+      }
+    }
+    chunks[c].m_end = chunk_end;
+  }
+
+  // count lines of the chunks (a trailing line without newline counts
+  // only if it is not empty) to find the vector ids of their words
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t c = 0; c < n_chunks; ++c) {
+    text_chunk_t *chunk = &chunks[c];
+    const char *p = chunk->m_start;
+    while (p < chunk->m_end
+           && (p = static_cast<const char *>(
+               memchr(p, '\n', chunk->m_end - p))) != nullptr) {
+      ++chunk->m_n_lines;
+      ++p;
+    }
+    if (chunk->m_end > chunk->m_start && chunk->m_end[-1] != '\n')
+      ++chunk->m_n_lines;
+  }
+  vid_t n_lines = 0;
+  for (auto &chunk : chunks) {
+    chunk.m_first_col = n_lines;
+    n_lines += chunk.m_n_lines;
+  }
+
+  // allocate space for the words and the matrix and parse the chunks
+  a_words->assign(std::min(n_lines, ncolumns), text_word_t());
+  a_nwe->reset(new arma::Mat<eT>(mrows, ncolumns));
+  arma::Mat<eT> *nwe = a_nwe->get();
+#pragma omp parallel for schedule(dynamic, 1)
+  for (size_t c = 0; c < n_chunks; ++c)
+    _parse_chunk(&chunks[c], nwe, a_words, data);
+
+  // report the first malformed line
+  for (auto &chunk : chunks) {
+    if (chunk.m_error == LineError::NONE)
+      continue;
+
+    const std::string iline(chunk.m_error_line, chunk.m_error_line_end);
+    if (chunk.m_error == LineError::MISSING_WORD) {
+      std::cerr << "Incorrect line format (missing word): "
+                << iline << std::endl;
+    } else {
+      std::cerr << "Incorrect line format (declared vector size " << mrows
+                << " differs from the actual size " << chunk.m_error_rows
+                << "):\n" << iline << std::endl;
+    }
+    return 1;
+  }
+  if (n_lines < ncolumns) {
+    std::cerr << "Incorrect file format: declared number of vectors "
+              << ncolumns << " differs from the actual number "
+              << n_lines << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+////////////////////////////
+// Explicit Instantiation //
+////////////////////////////
+
+template int parse_text_vectors<float>(const text_map_t *,
+                                       std::unique_ptr<arma::fmat> *,
+                                       std::vector<text_word_t> *);
+
+template int parse_text_vectors<double>(const text_map_t *,
+                                        std::unique_ptr<arma::mat> *,
+                                        std::vector<text_word_t> *);
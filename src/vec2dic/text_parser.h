@@ -0,0 +1,94 @@
+/** @file text_parser.h
+ *
+ *  @brief parallel parser of textual word2vec files.
+ *
+ *  The file is mapped into memory and split into chunks of whole
+ *  lines.  After counting the lines of every chunk, which determines
+ *  the vector id of their first word, all chunks are parsed
+ *  concurrently and their coordinates are written directly into the
+ *  columns of the preallocated matrix.  Words are not copied but
+ *  returned as positions in the mapped file.
+ */
+
+#ifndef VEC2DIC_TEXT_PARSER_H_
+# define VEC2DIC_TEXT_PARSER_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <armadillo>      // arma::Mat
+#include <cstdlib>        // size_t
+#include <memory>         // std::unique_ptr
+#include <vector>         // std::vector
+
+///////////
+// Types //
+///////////
+
+/**
+ * Memory-mapped text file.
+ */
+using text_map_t = struct TextMap {
+  /// start of the mapped region
+  void *m_addr = nullptr;
+  /// contents of the file
+  const char *m_data = nullptr;
+  /// size of the file in bytes
+  size_t m_size = 0;
+};
+
+/**
+ * Position of a word in a mapped text file.
+ */
+using text_word_t = struct TextWord {
+  /// offset of the first character of the word
+  size_t m_offset = 0;
+  /// number of characters of the word
+  size_t m_length = 0;
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Memory-map a text file for reading
+ *
+ * @param a_fname - name of the input file
+ * @param a_map - mapping to populate
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+int map_text_file(const char *a_fname, text_map_t *a_map);
+
+/**
+ * Release a previously mapped text file
+ *
+ * @param a_map - mapping to release
+ *
+ * @return \c void
+ */
+void unmap_text_file(text_map_t *a_map);
+
+/**
+ * Parse word vectors of a mapped word2vec file
+ *
+ * Coordinates are read with the precision of `float` regardless of
+ * `eT`, like the former `sscanf()`-based parser did.  Malformed lines
+ * are reported in the same way as by a sequential parser, i.e., the
+ * first one of them in the file.
+ *
+ * @param a_map - mapped textual word2vec file
+ * @param a_nwe - matrix to allocate and populate (one column per word)
+ * @param a_words - positions of the words (one per column)
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+template <typename eT>
+int parse_text_vectors(const text_map_t *a_map,
+                       std::unique_ptr<arma::Mat<eT>> *a_nwe,
+                       std::vector<text_word_t> *a_words);
+
+#endif    // VEC2DIC_TEXT_PARSER_H_
@@ -9,42 +9,31 @@
 //////////////
 // Includes //
 //////////////
-#include "src/vec2dic/expansion.h"
+#include "src/vec2dic/batch.h"
+#include "src/vec2dic/cli_util.h"
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/expander.h"
+#include "src/vec2dic/lexicon_io.h"
 #include "src/vec2dic/optparse.h"
+#include "src/vec2dic/server.h"
 
-#include <cctype>         // std::isspace()
+#include <climits>        // INT_MAX
 #include <clocale>        // setlocale()
-#include <cmath>          // sqrt(), fabs()
-#include <cstdio>         // sscanf()
 #include <cstdlib>        // std::exit(), std::strtoul()
-#include <cstring>        // strcmp(), strlen()
 
-#include <algorithm>
-#include <armadillo>      // arma::mat
-#include <fstream>        // std::ifstream
-#include <functional>
+#include <fstream>        // std::ifstream, std::ofstream
 #include <iostream>       // std::cerr, std::cout
-#include <locale>
-#include <stdexcept>      // std::domain_error()
 #include <string>         // std::string
-#include <unordered_map>  // std::unordered_map
-#include <utility>        // std::make_pair
+#include <vector>         // std::vector
+
+#ifdef _OPENMP
+# include <omp.h>         // omp_set_num_threads()
+#endif
 
 /////////////
 // Classes //
 /////////////
 
-/**
- * Type of algorithm to use for lexicon expansion.
- */
-enum class ExpansionType: int {
-  NC_CLUSTERING = 0,          // Nearest centroids algorithm
-    KNN_CLUSTERING,           // K-nearest neighbors
-    PCA_CLUSTERING,           // Proincipal component analysis
-    PRJ_CLUSTERING,           // Projection-based clustering
-    MAX_SENTINEL              // Unused type that serves as a sentinel
-    };
-
 // forward declaration of `usage()` method
 static void usage(int a_ret = EXIT_SUCCESS);
 
@@ -56,22 +45,64 @@ public:
   // Members
   /// input file containing seed polarity terms
   std::ifstream m_seedfile {};
+  /// output file for binary vectors (convert mode)
+  const char *convert_fname = nullptr;
+  /// manifest file of the jobs to run (batch mode)
+  const char *batch_fname = nullptr;
+  /// directory of the cache of preprocessed vectors (\c nullptr means
+  /// no cache)
+  const char *cache_dir = nullptr;
+  /// path of the Unix domain socket to serve requests on (server mode)
+  const char *serve_socket = nullptr;
+  /// number of requests (server mode) or job groups (batch mode)
+  /// processed concurrently (0 means the default of the mode)
+  int n_workers = 0;
+  /// file name prefix of the lexicons (\c nullptr means standard output)
+  const char *output_prefix = nullptr;
   /// default number of nearest neighbors to consider by the KNN algorithm
   int knn = 5;
   /// maximum number of new terms to extract (-1 means all new terms)
   int n_terms = -1;
+  /// all numbers of nearest neighbors to consider
+  std::vector<int> knn_list {5};
+  /// all numbers of terms to extract
+  std::vector<int> n_terms_list {-1};
+  /// number of threads to use (0 means all available cores)
+  int n_threads = 0;
   /// learning rate for gradient methods
   double alpha = DFLT_ALPHA;
   /// minimum required improvement for gradient methods
   double delta = DFLT_DELTA;
   /// maximum number of gradient updates
   unsigned long max_iters = MAX_ITERS;
+  /// number of principal components considered by the PCA method
+  int pca_components = DFLT_PCA_COMPONENTS;
+  /// number of cells of the IVF index (0 means choose automatically)
+  int ivf_lists = DFLT_IVF_LISTS;
+  /// number of IVF cells probed per term
+  int ivf_probes = DFLT_IVF_PROBES;
+  /// number of product quantization subspaces (0 means no compression)
+  int pq_subspaces = 0;
+  /// factor of approximate candidates rescored exactly (0 means none)
+  int pq_rerank = 0;
+  /// convergence tolerance of the nearest centroids algorithm
+  double tolerance = 0.;
   /// elongation coefficient for vector lengths (useful for linear transformation)
   double coefficient = 1.;
   /// do not normalize length of the vectors
   bool no_length_normalize = false;
   /// do not center means of the vectors
   bool no_mean_normalize = false;
+  /// store and process vectors in single precision
+  bool single_precision = false;
+  /// share loaded vectors with concurrent processes
+  bool shared_memory = false;
+  /// use approximate KNN search with an IVF index
+  bool ivf = false;
+  /// store vectors as 8-bit integers
+  bool int8 = false;
+  /// compare the results on 8-bit integers with the uncompressed ones
+  bool int8_validate = false;
   /// algorithm to use for expansion
   ExpansionType etype = ExpansionType::NC_CLUSTERING;
 
@@ -87,25 +118,95 @@ public:
   ON_OPTION_WITH_ARG(SHORTOPT('a') || LONGOPT("alpha"))
   alpha = std::atof(arg);
 
+  ON_OPTION_WITH_ARG(LONGOPT("batch"))
+  batch_fname = arg;
+
+  ON_OPTION_WITH_ARG(LONGOPT("cache-dir"))
+  cache_dir = arg;
+
   ON_OPTION_WITH_ARG(SHORTOPT('c') || LONGOPT("coefficient"))
   coefficient = std::atof(arg);
 
+  ON_OPTION_WITH_ARG(LONGOPT("convert"))
+  convert_fname = arg;
+
   ON_OPTION_WITH_ARG(SHORTOPT('d') || LONGOPT("delta"))
   delta = std::atof(arg);
 
+  ON_OPTION_WITH_ARG(SHORTOPT('e') || LONGOPT("tolerance"))
+  tolerance = std::atof(arg);
+  if (tolerance < 0.)
+    throw optparse::invalid_value("tolerance should be >= 0");
+
   ON_OPTION(SHORTOPT('h') || LONGOPT("help"))
   usage();
 
+  ON_OPTION(LONGOPT("int8"))
+  int8 = true;
+
+  ON_OPTION(LONGOPT("int8-validate"))
+  int8 = true;
+  int8_validate = true;
+
+  ON_OPTION_WITH_ARG(SHORTOPT('j') || LONGOPT("threads"))
+  n_threads = std::atoi(arg);
+  if (n_threads < 0)
+    throw optparse::invalid_value("number of threads should be >= 0");
+
+  ON_OPTION(LONGOPT("ivf"))
+  ivf = true;
+
+  ON_OPTION_WITH_ARG(LONGOPT("ivf-lists"))
+  ivf_lists = std::atoi(arg);
+  if (ivf_lists < 0)
+    throw optparse::invalid_value("ivf-lists should be >= 0");
+
+  ON_OPTION_WITH_ARG(LONGOPT("ivf-probes"))
+  ivf_probes = std::atoi(arg);
+  if (ivf_probes < 1)
+    throw optparse::invalid_value("ivf-probes should be >= 1");
+
   ON_OPTION_WITH_ARG(SHORTOPT('i') || LONGOPT("max-iterations"))
   max_iters = std::strtoul(arg, nullptr, 10);
 
   ON_OPTION_WITH_ARG(SHORTOPT('k') || LONGOPT("k-nearest-neighbors"))
-  knn = std::atoi(arg);
-  if (knn < 1)
-    throw optparse::invalid_value("k-nearest-neighbors should be >= 1");
+  if (parse_int_list(&knn_list, arg, 1, INT_MAX))
+    throw optparse::invalid_value("k-nearest-neighbors should be a"
+                                  " comma-separated list of values >= 1");
+  knn = knn_list.front();
 
   ON_OPTION_WITH_ARG(SHORTOPT('n') || LONGOPT("n-terms"))
-  n_terms = std::atoi(arg);
+  if (parse_int_list(&n_terms_list, arg, -1, INT_MAX))
+    throw optparse::invalid_value("n-terms should be a comma-separated"
+                                  " list of values >= -1");
+  n_terms = n_terms_list.front();
+
+  ON_OPTION_WITH_ARG(SHORTOPT('o') || LONGOPT("output"))
+  output_prefix = arg;
+
+  ON_OPTION_WITH_ARG(SHORTOPT('p') || LONGOPT("pca-components"))
+  pca_components = std::atoi(arg);
+  if (pca_components < 1)
+    throw optparse::invalid_value("pca-components should be >= 1");
+
+  ON_OPTION_WITH_ARG(LONGOPT("pq"))
+  pq_subspaces = std::atoi(arg);
+  if (pq_subspaces < 0)
+    throw optparse::invalid_value("pq should be >= 0");
+
+  ON_OPTION_WITH_ARG(LONGOPT("pq-rerank"))
+  pq_rerank = std::atoi(arg);
+  if (pq_rerank < 0)
+    throw optparse::invalid_value("pq-rerank should be >= 0");
+
+  ON_OPTION_WITH_ARG(LONGOPT("serve"))
+  serve_socket = arg;
+
+  ON_OPTION(LONGOPT("shared-memory"))
+  shared_memory = true;
+
+  ON_OPTION(SHORTOPT('s') || LONGOPT("single-precision"))
+  single_precision = true;
 
   ON_OPTION_WITH_ARG(SHORTOPT('t') || LONGOPT("type"))
   int itype = std::atoi(arg);
@@ -114,55 +215,14 @@ public:
 
   etype = static_cast<ExpansionType>(itype);
 
+  ON_OPTION_WITH_ARG(LONGOPT("workers"))
+  n_workers = std::atoi(arg);
+  if (n_workers < 1)
+    throw optparse::invalid_value("workers should be >= 1");
+
   END_OPTION_MAP()
 };
 
-/// Pair of c_string and polarity
-typedef struct WP {
-  /// polar word
-  const char *m_word = nullptr;
-  /// polarity class of the word
-  Polarity m_polarity = Polarity::NEUTRAL;
-  /// polarity score of the word
-  dist_t m_score = 0.;
-
-  /// copy constructor
-  WP(const char *a_word, const Polarity a_polarity,
-     dist_t a_score):
-    m_word(a_word), m_polarity(a_polarity), m_score(fabs(a_score))
-  {}
-
-  /// copy constructor
-  WP(const char *a_word, const ps_t *a_ps):
-    m_word(a_word), m_polarity(a_ps->first), m_score(fabs(a_ps->second))
-  {}
-} wp_t;
-
-/// Vector of pairs of c_string and their polarities
-typedef std::vector<wp_t> wpv_t;
-
-/////////////////////////////
-// Variables and Constants //
-/////////////////////////////
-
-/// string representing positive polarity class
-const char *positive  = "positive";
-/// string representing negative polarity class
-const char *negative = "negative";
-/// string representing neutral polarity class
-const char *neutral = "neutral";
-
-/// Mapping from words to the index of their NWE vector
-static w2v_t word2vecid;
-/// Mapping from the index of NWE vectors to their respective words
-static v2w_t vecid2word;
-/// Mapping from word to its polarity
-static w2ps_t word2polscore;
-/// Matrix of neural word embeddings
-static arma::mat NWE;
-/// Output debug information
-const bool debug = false;
-
 /////////////
 // Methods //
 /////////////
@@ -179,7 +239,12 @@ static void usage(int a_ret) {
       " applying clustering" << std::endl;
   std::cerr << "to neural word embeddings." << std::endl << std::endl;
   std::cerr << "Usage:" << std::endl;
-  std::cerr << "vec2dic [OPTIONS] VECTOR_FILE SEED_FILE"
+  std::cerr << "vec2dic [OPTIONS] VECTOR_FILE SEED_FILE" << std::endl;
+  std::cerr << "vec2dic [OPTIONS] --convert=BINARY_FILE VECTOR_FILE"
+            << std::endl;
+  std::cerr << "vec2dic [OPTIONS] --serve=SOCKET VECTOR_FILE"
+            << std::endl;
+  std::cerr << "vec2dic [OPTIONS] --batch=MANIFEST VECTOR_FILE"
             << std::endl << std::endl;
   std::cerr << "Options:" << std::endl;
   std::cerr << "-L|--no-length-normalizion  do not normalize length"
@@ -188,20 +253,100 @@ static void usage(int a_ret) {
       " of word vectors" << std::endl;
   std::cerr << "-a|--alpha  learning rate for gradient methods"
       " (default " << DFLT_ALPHA << ")" << std::endl;
+  std::cerr << "--batch  run the jobs of MANIFEST (lines with SEED_FILE,"
+      " OUTPUT_FILE," << std::endl;
+  std::cerr << "           and optional type=T, length-normalize=0|1,"
+      " mean-normalize=0|1," << std::endl;
+  std::cerr << "           k=K, and n-terms=N settings) over one"
+      << std::endl;
+  std::cerr << "           copy of the vectors, sharing work between jobs"
+      " of the same seeds" << std::endl;
+  std::cerr << "--cache-dir  keep parsed vectors, their normalization,"
+      " and principal" << std::endl;
+  std::cerr << "           components in DIR to reuse them in later"
+      " runs" << std::endl;
   std::cerr << "-c|--coefficient  elongate vectors by the"
       " coefficient (implies -L)" << std::endl;
+  std::cerr << "--convert  store normalized vectors in a binary file"
+      " which can be" << std::endl;
+  std::cerr << "           used instead of VECTOR_FILE" << std::endl;
   std::cerr << "-d|--delta  learning rate for gradient methods"
       " (default " << DFLT_DELTA << ")" << std::endl;
+  std::cerr << "-e|--tolerance  stop nearest centroids once the share of"
+      " moved vectors" << std::endl;
+  std::cerr << "           or the maximum centroid shift does not exceed"
+      " this value" << std::endl;
+  std::cerr << "           (default 0 (full convergence))" << std::endl;
   std::cerr << "-h|--help  show this screen and exit" << std::endl;
   std::cerr << "-i|--max-iterations  maximum number of gradient"
       " updates (default " << MAX_ITERS << ")" << std::endl;
+  std::cerr << "--int8  store vectors as 8-bit integers and compute"
+      " distances with" << std::endl;
+  std::cerr << "           integer dot products (types 0 and 1 only)"
+            << std::endl;
+  std::cerr << "--int8-validate  like --int8, but also run the"
+      " uncompressed algorithm" << std::endl;
+  std::cerr << "           and report how many new terms both runs"
+      " share" << std::endl;
+  std::cerr << "--ivf  search KNN neighbors approximately with an"
+      " inverted-file index," << std::endl;
+  std::cerr << "           which is stored in VECTOR_FILE.ivf and built"
+      " if missing" << std::endl;
+  std::cerr << "--ivf-lists  number of cells of a newly built index"
+      " (default: 0" << std::endl;
+  std::cerr << "           (square root of the vocabulary size))"
+            << std::endl;
+  std::cerr << "--ivf-probes  number of nearest cells searched per term"
+      " (default " << DFLT_IVF_PROBES << ")" << std::endl;
+  std::cerr << "-j|--threads  number of threads to use (default: 0"
+      " (all available cores))" << std::endl;
   std::cerr << "-k|--k-nearest-neighbors  set the number of neighbors"
       " for KNN algorithm" << std::endl;
+  std::cerr << "           (a comma-separated list searches neighbors"
+      " once and outputs" << std::endl;
+  std::cerr << "           one lexicon per value, requires -o)"
+            << std::endl;
   std::cerr << "-n|--n-terms  number of terms to extract (default:"
       " -1 (unlimited))" << std::endl;
+  std::cerr << "           (a comma-separated list outputs one lexicon"
+      " per value, requires -o)" << std::endl;
+  std::cerr << "-o|--output  write lexicons to files PREFIX.kK.nN"
+      " (PREFIX.nN for types" << std::endl;
+  std::cerr << "           other than KNN, N is `all' for -1) instead of"
+      " standard output" << std::endl;
+  std::cerr << "-p|--pca-components  number of leading principal"
+      " components considered" << std::endl;
+  std::cerr << "           by the PCA method (default "
+            << DFLT_PCA_COMPONENTS << ")" << std::endl;
+  std::cerr << "--pq  compress vectors to the given number of bytes by"
+      " product quantization" << std::endl;
+  std::cerr << "           (types 0 and 1 only, default: 0 (no"
+      " compression))" << std::endl;
+  std::cerr << "--pq-rerank  rescore this many times more candidates than"
+      " needed" << std::endl;
+  std::cerr << "           with exact distances (keeps uncompressed"
+      " vectors, default: 0)" << std::endl;
+  std::cerr << "--serve  keep vectors in memory and answer expansion"
+      " requests on the" << std::endl;
+  std::cerr << "           Unix domain socket SOCKET (the other options"
+      " set the defaults" << std::endl;
+  std::cerr << "           of the requests, -j the threads per request)"
+            << std::endl;
+  std::cerr << "--shared-memory  keep one copy of the loaded vectors in"
+      " memory for all" << std::endl;
+  std::cerr << "           concurrent processes which load the same file"
+            << std::endl;
+  std::cerr << "-s|--single-precision  store and process vectors as 32-bit"
+      " floats" << std::endl;
   std::cerr << "-t|--type  type of expansion algorithm to use:" << std::endl;
   std::cerr << "           (0 - nearest centroids (default), "
-      "1 - KNN, 2 - PCA dimension)" << std::endl << std::endl;
+      "1 - KNN, 2 - PCA dimension," << std::endl;
+  std::cerr << "           3 - linear projection)" << std::endl;
+  std::cerr << "--workers  number of requests (--serve) or job groups"
+      " (--batch) processed" << std::endl;
+  std::cerr << "           concurrently (default " << DFLT_SERVER_WORKERS
+            << " and " << DFLT_BATCH_WORKERS << ", respectively)"
+            << std::endl << std::endl;
   std::cerr << "Exit status:" << std::endl;
   std::cerr << EXIT_SUCCESS << " on sucess, non-" << EXIT_SUCCESS
             << " otherwise" << std::endl;
@@ -209,321 +354,169 @@ static void usage(int a_ret) {
 }
 
 /**
- * Output polar terms in sorted alphabetic order
- *
- * @param a_stream - output stream to use
- * @param a_vecid2polscore - mapping from vector id's to their respective polarities
- *
- * @return \c void
- */
-static void output_terms(std::ostream &a_stream,
-                         const v2ps_t *a_vecid2polscore) {
-  // add new words to `word2polscore` map
-  v2w_t::iterator v2w_it;
-
-  for (auto &v2ps : *a_vecid2polscore) {
-    // we assume that the word is always found
-    v2w_it = vecid2word.find(v2ps.first);
-    word2polscore.emplace(v2w_it->second, v2ps.second);
-  }
-
-  // populate word/polarity vector
-  wpv_t wpv;
-  wpv.reserve(word2polscore.size());
-  for (auto &w2p : word2polscore) {
-    wpv.push_back(WP {w2p.first.c_str(), &w2p.second});
-  }
-  // sort words
-  std::sort(wpv.begin(), wpv.end(), [](const wp_t& wp1, const wp_t& wp2) \
-            {return wp1.m_score < wp2.m_score;});
-
-  // output sorted dict to the requested stream
-  for (auto &wp : wpv) {
-    switch (wp.m_polarity) {
-      case Polarity::POSITIVE:
-        a_stream << wp.m_word << '\t' << positive << '\t' << wp.m_score;
-        break;
-      case Polarity::NEGATIVE:
-        a_stream << wp.m_word << '\t' << negative << '\t' << wp.m_score;
-        break;
-      case Polarity::NEUTRAL:
-        continue;
-    default:
-      throw std::domain_error("Unknown polarity type");
-    }
-    a_stream << std::endl;
-  }
-}
-
-/**
- * Auxiliary function for removing blanks from the left end of a string
- *
- * @param s - string to be trimmed
+ * Collect options of the embedding store
  *
- * @return reference to the original string with leading blanks truncated
- */
-static inline std::string *ltrim(std::string *s) {
-  s->erase(s->begin(),
-           std::find_if(s->begin(), s->end(),
-                        std::not1(std::ptr_fun<int, int>(std::isspace))));
-  return s;
-}
-
-/**
- * Auxiliary function for removing blanks from the right end of a string
- *
- * @param s - string to be trimmed
+ * @param a_option - pointer to user's options
  *
- * @return reference to the original string with trailing blanks truncated
+ * @return options for loading word vectors
  */
-static inline std::string *rtrim(std::string *s) {
-  s->erase(std::find_if(s->rbegin(), s->rend(),
-                        std::not1(std::ptr_fun<int, int>(std::isspace))).base(),
-           s->end());
-  return s;
+static store_options_t store_options(const Option *a_option) {
+  store_options_t options;
+  options.m_coefficient = a_option->coefficient;
+  options.m_no_length_normalize = a_option->no_length_normalize;
+  options.m_no_mean_normalize = a_option->no_mean_normalize;
+  options.m_single_precision = a_option->single_precision;
+  options.m_shared_memory = a_option->shared_memory;
+  if (a_option->cache_dir != nullptr)
+    options.m_cache_dir = a_option->cache_dir;
+  return options;
 }
 
 /**
- * Auxiliary function for removing blanks from both ends of a string
+ * Collect options of the expander
  *
- * @param s - string to be trimmed
+ * @param a_option - pointer to user's options
  *
- * @return original string with leading and trailing blanks removed
+ * @return options of the expansion algorithm
  */
-static inline std::string *normalize(std::string *s) {
-  // strip leading and trailing whitespaces
-  ltrim(rtrim(s));
-  // downcase the string
-  std::transform(s->begin(), s->end(), s->begin(), ::tolower);;
-  return s;
+static expander_options_t expander_options(const Option *a_option) {
+  expander_options_t options;
+  options.m_type = a_option->etype;
+  options.m_n_terms = a_option->n_terms;
+  options.m_knn = a_option->knn;
+  options.m_pca_components = a_option->pca_components;
+  options.m_alpha = a_option->alpha;
+  options.m_delta = a_option->delta;
+  options.m_max_iters = a_option->max_iters;
+  options.m_tolerance = a_option->tolerance;
+  options.m_ivf = a_option->ivf;
+  options.m_ivf_lists = a_option->ivf_lists;
+  options.m_ivf_probes = a_option->ivf_probes;
+  options.m_pq_subspaces = a_option->pq_subspaces;
+  options.m_pq_rerank = a_option->pq_rerank;
+  options.m_int8 = a_option->int8;
+  options.m_int8_validate = a_option->int8_validate;
+  options.m_no_length_normalize = a_option->no_length_normalize;
+  options.m_no_mean_normalize = a_option->no_mean_normalize;
+  return options;
 }
 
 /**
- * Perform length-normalization of word vectors
+ * Expand seed set with all requested numbers of neighbors and terms
  *
- * @param a_nwe - Armadillo matrix of word vectors (each word vector
- *                is a column in this matrix)
+ * @param a_expander - expander to use
+ * @param a_seeds - seed terms and their polarities
+ * @param a_option - pointer to user's options
  *
- * @return \c void
+ * @return 0 on success, non-0 otherwise
  */
-static void _length_normalize(arma::mat *a_nwe) {
-  dist_t ilength = 0., tmp_j;
-  size_t j, n_rows = a_nwe->n_rows;
-  for (size_t i = 0; i < a_nwe->n_cols; ++i) {
-    ilength = 0.;
-    // compute the unnormalized length of the vector
-    for (j = 0; j < n_rows; ++j) {
-      tmp_j = (*a_nwe)(j, i);
-      ilength += tmp_j * tmp_j;
+static int output_grid(const Expander *a_expander, const w2ps_t *a_seeds,
+                       const Option *a_option) {
+  int ret = EXIT_SUCCESS;
+  // the number of neighbors only matters for KNN
+  const bool is_knn = a_option->etype == ExpansionType::KNN_CLUSTERING;
+  const std::vector<int> knns = is_knn? a_option->knn_list:
+      std::vector<int> {a_option->knn};
+  std::vector<expansion_params_t> params;
+  std::vector<std::string> fnames;
+  expansion_params_t iparams;
+  std::string fname;
+  for (int knn : knns) {
+    for (int n_terms : a_option->n_terms_list) {
+      iparams.m_knn = knn;
+      iparams.m_n_terms = n_terms;
+      params.push_back(iparams);
+
+      fname = a_option->output_prefix;
+      if (is_knn)
+        fname += ".k" + std::to_string(knn);
+      fname += ".n" + (n_terms < 0? std::string("all"):
+                       std::to_string(n_terms));
+      fnames.push_back(fname);
     }
-    // normalize the length
-    ilength = sqrt(ilength);
-    // normalize the vector by dividing it by normalized length
-    if (ilength)
-      a_nwe->col(i) /= float(ilength);
   }
-}
 
-/**
- * Perform mean-normalization of word vectors
- *
- * @param a_nwe - Armadillo matrix of word vectors (each word vector
- *                is a column in this matrix)
- *
- * @return \c void
- */
-static void _mean_normalize(arma::mat *a_nwe) {
-  arma::vec vmean = arma::mean(*a_nwe, 1);
-  arma::vec vstddev = arma::stddev(*a_nwe, 0, 1);
-
-  for (vid_t i = 0; i < vmean.n_rows; ++i) {
-    a_nwe->row(i) -= vmean[i];
+  std::vector<lexicon_t> lexicons;
+  if ((ret = a_expander->expand_many(a_seeds, &params, &lexicons)))
+    return ret;
 
-    if (vstddev[i])
-      a_nwe->row(i) /= vstddev[i];
+  for (size_t i = 0; i < lexicons.size(); ++i) {
+    std::ofstream os(fnames[i]);
+    if (os)
+      output_terms(os, &lexicons[i]);
+    if (!os) {
+      std::cerr << "Cannot write file " << fnames[i] << std::endl;
+      ret = EXIT_FAILURE;
+    }
   }
+  return ret;
 }
 
 /**
- * Read NWE vectors for words.
+ * Read word vectors and seeds and run the requested expansion
  *
- * @param a_ret - exit code for the program
+ * @param a_argv - positional command line arguments
  * @param a_option - pointer to user's options
  *
- * @return \c 0 on success, non-\c 0 otherwise
+ * @return 0 on success, non-0 otherwise
  */
-static int read_vectors(const char *a_fname, const Option *a_option) {
-  float iwght;
-  const char *cline;
-  std::string iline;
-  size_t space_pos, tab_pos;
-  int nchars;
-  vid_t mrows = 0, ncolumns = 0, icol = 0, irow = 0;
-  const int coefficient = a_option->coefficient;
-  const bool no_length_normalize = a_option->no_length_normalize;
-  const bool no_mean_normalize = a_option->no_mean_normalize;
-  std::cerr << "Reading word vectors ... ";
-
-  std::ifstream is(a_fname);
-  if (!is) {
-    std::cerr << "Cannot open file " << a_fname << std::endl;
-    goto error_exit;
-  }
-  // skip empty lines at the beginning of file
-  while (std::getline(is, iline) && iline.empty()) {}
-  // initialize matrix (columns represent words, rows are coordinates)
-  if (sscanf(iline.c_str(), "%llu %llu", &ncolumns, &mrows) != 2) {
-    std::cerr << "Incorrect declaration line format: '"
-              << iline.c_str() << std::endl;
-    goto error_exit;
-  }
+static int run_expansion(char *a_argv[], const Option *a_option) {
+  int ret = EXIT_SUCCESS;
+  EmbeddingStore store;
+  w2ps_t word2polscore;
+  lexicon_t lexicon;
 
-  // allocate space for map and matrix
-  word2vecid.reserve(ncolumns); vecid2word.reserve(ncolumns);
-  NWE.set_size(mrows, ncolumns);
-
-  while (icol < ncolumns && std::getline(is, iline)) {
-    tab_pos = iline.find_first_of('\t');
-    space_pos = iline.find_first_of(' ');
-    if (tab_pos < space_pos)
-      space_pos = tab_pos;
-
-    while (space_pos > 0 && std::isspace(iline[space_pos])) {--space_pos;}
-    if (space_pos == 0 && std::isspace(iline[space_pos])) {
-      std::cerr << "Incorrect line format (missing word): "
-                << iline << std::endl;
-      goto error_exit;
-    }
-    ++space_pos;
-    word2vecid.emplace(std::move(iline.substr(0, space_pos)), std::move(icol));
-    vecid2word.emplace(std::move(icol), std::move(iline.substr(0, space_pos)));
-
-    cline = &(iline.c_str()[space_pos]);
-    for (irow = 0; irow < mrows
-           && sscanf(cline, " %f%n", &iwght, &nchars) == 1; ++irow) {
-      NWE(irow, icol) = iwght;
-      cline += nchars;
-    }
-    if (irow != mrows) {
-      std::cerr << "Incorrect line format (declared vector size " << mrows
-                << " differs from the actual size " << irow << "):\n"
-		<< iline << std::endl;
-      goto error_exit;
-    }
-    ++icol;
-  }
+  // read word vectors
+  if ((ret = store.load(a_argv[0], store_options(a_option))))
+    return ret;
 
-  if (!is.eof() && is.fail()) {
-    std::cerr << "Failed to read vector file " << a_fname << std::endl;
-    goto error_exit;
-  }
-  if (icol != ncolumns) {
-    std::cerr << "Incorrect file format: declared number of vectors "
-              << ncolumns << " differs from the actual number "
-              << icol << std::endl;
-    goto error_exit;
+  // store normalized vectors in binary format
+  if (a_option->convert_fname != nullptr) {
+    std::cerr << "Writing binary word vectors ... ";
+    if ((ret = store.save(a_option->convert_fname)) == 0)
+      std::cerr << "done" << std::endl;
+    return ret;
   }
-  is.close();
-  // normalize lengths of word vectors
-  if (coefficient != 1)
-    NWE *= coefficient;
-
-  // normalize lengths of word vectors
-  if (!no_length_normalize)
-    _length_normalize(&NWE);
-
-  // normalize means of word vectors
-  if (!no_mean_normalize)
-    _mean_normalize(&NWE);
-
-  std::cerr << "done (read " << mrows << " rows with "
-            << ncolumns << " columns)" << std::endl;
-  return 0;
-
- error_exit:
-  is.close();            // basic guarantee
-  word2vecid.clear();
-  vecid2word.clear();
-  NWE.reset();
-  return 1;
-}
-
-/**
- * Read seed set of polarity terms
- *
- * @param a_ret - exit code for the program
- *
- * @return \c 0 on success, non-\c 0 otherwise
- */
-static int read_seed_set(const char *a_fname) {
-  Polarity ipol;
-  std::string iline;
-  size_t tab_pos, tab_pos_orig;
 
-  std::cerr << "Reading seed set file ...";
+  // answer requests until the server is stopped
+  if (a_option->serve_socket != nullptr) {
+    server_options_t options;
+    options.m_socket = a_option->serve_socket;
+    if (a_option->n_workers > 0)
+      options.m_n_workers = a_option->n_workers;
+    options.m_n_threads = a_option->n_threads;
+    return serve(&store, expander_options(a_option), options);
+  }
 
-  std::ifstream is(a_fname);
-  if (!is) {
-    std::cerr << "Cannot open file " << a_fname << std::endl;
-    goto error_exit;
+  // run the jobs of a manifest
+  if (a_option->batch_fname != nullptr) {
+    batch_options_t options;
+    options.m_manifest = a_option->batch_fname;
+    if (a_option->n_workers > 0)
+      options.m_n_workers = a_option->n_workers;
+    options.m_n_threads = a_option->n_threads;
+    return run_batch(&store, expander_options(a_option), options);
   }
 
-  // read input file
-  while (std::getline(is, iline)) {
-    if (iline.empty() || iline.compare(0, 3, "###") == 0)
-      continue;
-
-    // remove leading and trailing whitespaces
-    normalize(&iline);
-    // find first tab character
-    tab_pos = iline.find_first_of('\t');
-    tab_pos_orig = tab_pos;
-    // skip leading whitespaces
-    while (iline[++tab_pos] && std::isspace(iline[tab_pos])) {}
-    if (tab_pos == std::string::npos || !iline[tab_pos]) {
-      std::cerr << "Incorrect line format (missing polarity): "
-                << iline << std::endl;
-      goto error_exit;
-    }
-    // determine polarity class
-    if (iline.compare(tab_pos, strlen(positive), positive) == 0) {
-      ipol = Polarity::POSITIVE;
-    } else if (iline.compare(tab_pos, strlen(negative), negative) == 0) {
-      ipol = Polarity::NEGATIVE;
-    } else if (iline.compare(tab_pos, strlen(neutral), neutral) == 0) {
-      ipol = Polarity::NEUTRAL;
-    } else {
-      std::cerr << "Unrecognized polarity class at line '"
-                << iline.substr(tab_pos) << "'" << std::endl;
-      goto error_exit;
-    }
+  // read seed sets
+  if ((ret = read_seed_set(a_argv[1], &word2polscore)))
+    return ret;
 
-    while (tab_pos_orig > 0
-           && std::isspace(iline[tab_pos_orig])) {--tab_pos_orig;}
-    if (tab_pos_orig == 0 && std::isspace(iline[tab_pos_orig])) {
-      std::cerr << "Incorrect line format (missing word): "
-                << iline << std::endl;
-      goto error_exit;
-    }
-    ++tab_pos_orig;
-    word2polscore.emplace(
-        std::move(iline.substr(0, tab_pos_orig)),
-        std::make_pair(ipol, 0.));
-  }
+  Expander expander(&store, expander_options(a_option));
+  // compressed vectors do not need the original matrix any more
+  if (!expander.needs_matrix())
+    store.release_matrix();
 
-  if (!is.eof() && is.fail()) {
-    std::cerr << "Failed to read seed set file " << a_fname << std::endl;
-    goto error_exit;
-  }
-  is.close();
-  std::cerr << "done (read " << word2polscore.size() << " entries)"
-            << std::endl;
-  return 0;
+  // write one lexicon per number of neighbors and terms
+  if (a_option->output_prefix != nullptr)
+    return output_grid(&expander, &word2polscore, a_option);
+
+  if ((ret = expander.expand(&word2polscore, &lexicon)))
+    return ret;
 
- error_exit:
-  is.close();        // basic guarantee
-  word2polscore.clear();
-  return 1;
+  // output new terms sorted by their scores
+  output_terms(std::cout, &lexicon);
+  return ret;
 }
 
 //////////
@@ -539,76 +532,61 @@ static int read_seed_set(const char *a_fname) {
  * @return 0 on success, non-0 otherwise
  */
 int main(int argc, char *argv[]) {
-  int nargs = 0, ret = EXIT_SUCCESS;
+  int nargs = 0;
 
   // set appropriate locale
   setlocale(LC_ALL, NULL);
 
   Option opt {};
   int argused = 1 + opt.parse(&argv[1], argc-1);  // Skip argv[0].
+  const int n_modes = (opt.convert_fname != nullptr)
+      + (opt.serve_socket != nullptr) + (opt.batch_fname != nullptr);
+  const int nexpected = n_modes == 0? 2: 1;
 
-  if ((nargs = argc - argused) != 2) {
+  if ((nargs = argc - argused) != nexpected) {
     std::cerr << "Incorrect number of arguments "
-              << nargs << " (2 arguments expected).  "  \
+              << nargs << " (" << nexpected << " arguments expected).  " \
       "Type --help to see usage." << std::endl;
     std::exit(EXIT_FAILURE);
   }
+  if ((opt.knn_list.size() > 1 || opt.n_terms_list.size() > 1)
+      && (n_modes > 0 || opt.output_prefix == nullptr)) {
+    std::cerr << "Lists of -k and -n values are only supported when"
+        " expanding a single" << std::endl << "seed set with -o."
+        "  Type --help to see usage." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if (n_modes > 1) {
+    std::cerr << "Options --convert, --serve, and --batch are mutually"
+        " exclusive.  Type --help to see usage." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if (opt.pq_subspaces > 0
+      && ((opt.etype != ExpansionType::NC_CLUSTERING
+           && opt.etype != ExpansionType::KNN_CLUSTERING) || opt.ivf)) {
+    std::cerr << "Product quantization (--pq) is only supported by the"
+        " nearest centroids" << std::endl << "and the exact KNN"
+        " algorithms.  Type --help to see usage." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if (opt.int8
+      && ((opt.etype != ExpansionType::NC_CLUSTERING
+           && opt.etype != ExpansionType::KNN_CLUSTERING) || opt.ivf
+          || opt.pq_subspaces > 0)) {
+    std::cerr << "8-bit integer vectors (--int8) are only supported by the"
+        " nearest centroids" << std::endl << "and the exact KNN"
+        " algorithms without --pq.  Type --help to see usage."
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
   // clean up options
   if (opt.coefficient != 1)
     opt.no_length_normalize = true;
 
-  // read word vectors
-  if ((ret = read_vectors(argv[argused++], &opt)))
-    return ret;
-
-  // read seed sets
-  if ((ret = read_seed_set(argv[argused++])))
-    return ret;
-
-  // generate mapping from vector ids to the polarities of respective
-  // words
-  v2ps_t vecid2polscore;
-  int seed_cnt = 0;
-  w2v_t::const_iterator vecid, vecend = word2vecid.end();
-  for (auto &w2p : word2polscore) {
-    if (w2p.second.first != Polarity::NEUTRAL)
-      ++seed_cnt;
-
-    vecid = word2vecid.find(w2p.first);
-    if (vecid == vecend)
-      continue;
-
-    vecid2polscore.emplace(vecid->second, w2p.second);
-    if (debug) {
-      std::cerr << "word: " << w2p.first
-		<< ", vecid = " << vecid->second
-		<< ", polarity = " << (int) w2p.second.first << std::endl;
-    }
-  }
+#ifdef _OPENMP
+  if (opt.n_threads > 0)
+    omp_set_num_threads(opt.n_threads);
+#endif
 
-  if (opt.n_terms > 0) {
-    opt.n_terms -= seed_cnt;
-    if (opt.n_terms < 1)
-      goto print_steps;
-  }
-
-  // apply the requested expansion algorithm
-  switch (opt.etype) {
-  case ExpansionType::NC_CLUSTERING:
-    expand_nearest_centroids(&vecid2polscore, &NWE, opt.n_terms);
-    break;
-  case ExpansionType::KNN_CLUSTERING:
-    expand_knn(&vecid2polscore, &NWE, opt.n_terms, opt.knn);
-    break;
-  case ExpansionType::PCA_CLUSTERING:
-    expand_pca(&vecid2polscore, &NWE, opt.n_terms);
-    break;
-  default:
-    throw std::invalid_argument("Invalid type of seed set"
-                                " expansion algorithm.");
-  }
-  // output new terms in sorted alphabetic order
- print_steps:
-  output_terms(std::cout, &vecid2polscore);
-  return ret;
+  return run_expansion(&argv[argused], &opt);
 }
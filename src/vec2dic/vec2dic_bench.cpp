@@ -0,0 +1,588 @@
+/** @file vec2dic_bench.cpp
+ *
+ *  @brief Benchmark phases of lexicon expansion on synthetic embeddings.
+ *
+ *  This program generates a reproducible set of word vectors (and a
+ *  seed set) from a fixed random seed, so that runs on different
+ *  machines or revisions process exactly the same data.  It then
+ *  times loading the vectors from a textual and a binary file and
+ *  expanding the seed set with every requested algorithm, storage
+ *  mode, and number of threads.  Phases of the library (see
+ *  phase_profile.h) are reported separately, and the results are
+ *  printed to standard output as tab-separated values.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/cli_util.h"
+#include "src/vec2dic/embedding_store.h"
+#include "src/vec2dic/expander.h"
+#include "src/vec2dic/lexicon_io.h"
+#include "src/vec2dic/optparse.h"
+#include "src/vec2dic/phase_profile.h"
+
+#include <clocale>        // setlocale()
+#include <cstdint>        // uint64_t
+#include <cstdio>         // snprintf(), std::remove()
+#include <cstdlib>        // std::exit(), std::getenv(), std::strtoull()
+#include <cmath>          // cos(), log(), sqrt()
+#include <unistd.h>       // getpid()
+
+#include <algorithm>      // std::min_element(), std::sort()
+#include <chrono>         // std::chrono::steady_clock
+#include <fstream>        // std::ofstream
+#include <iostream>       // std::cerr, std::cout
+#include <map>            // std::map
+#include <random>         // std::mt19937_64
+#include <sstream>        // std::ostringstream
+#include <stdexcept>      // std::invalid_argument
+#include <string>         // std::string
+#include <tuple>          // std::tuple
+#include <vector>         // std::vector
+
+#ifdef _OPENMP
+# include <omp.h>         // omp_get_max_threads(), omp_set_num_threads()
+#endif
+
+///////////////
+// Constants //
+///////////////
+
+/// names of the storage modes
+static const char *const MODE_NAMES[] = {"double", "single", "int8", "pq"};
+
+/// type column of phases which do not depend on the algorithm
+static const char *const ANY_TYPE = "-";
+
+/// distance of the class centers from the origin relative to the noise
+static const double CLASS_OFFSET = 0.35;
+
+///////////
+// Types //
+///////////
+
+/**
+ * Storage modes of the word vectors.
+ */
+enum class StorageMode: int {
+  DOUBLE = 0,                 // double-precision matrix
+    SINGLE,                   // single-precision matrix
+    INT8,                     // 8-bit integer vectors
+    PQ,                       // product-quantized vectors
+    MAX_SENTINEL              // Unused mode that serves as a sentinel
+    };
+
+/** Key of a result: storage mode, threads, algorithm, and phase */
+using result_key_t = std::tuple<int, int, std::string, std::string>;
+
+/** Timings of all repetitions of a phase */
+using result_map_t = std::map<result_key_t, std::vector<double>>;
+
+/////////////
+// Classes //
+/////////////
+
+// forward declaration of `usage()` method
+static void usage(int a_ret = EXIT_SUCCESS);
+
+/**
+ * Parse comma-separated list of storage modes
+ *
+ * @param a_modes - vector to populate
+ * @param a_arg - list to parse
+ *
+ * @return \c 0 on success, non-\c 0 if the list is malformed
+ */
+static int parse_mode_list(std::vector<int> *a_modes, const char *a_arg) {
+  std::istringstream fields(a_arg);
+  std::string mode;
+  int m, n_modes = static_cast<int>(StorageMode::MAX_SENTINEL);
+  a_modes->clear();
+  while (std::getline(fields, mode, ',')) {
+    for (m = 0; m < n_modes && mode != MODE_NAMES[m]; ++m) {}
+    if (m == n_modes)
+      return 1;
+    a_modes->push_back(m);
+  }
+  std::sort(a_modes->begin(), a_modes->end());
+  a_modes->erase(std::unique(a_modes->begin(), a_modes->end()),
+                 a_modes->end());
+  return a_modes->empty();
+}
+
+/**
+ * Custom option handler
+ */
+class Option: public optparse {
+public:
+  // Members
+  /// number of generated words
+  vid_t vocab_size = 100000;
+  /// dimension of the generated vectors
+  vid_t dim = 100;
+  /// number of seed terms
+  vid_t n_seeds = 1000;
+  /// seed of the random number generator
+  uint64_t rng_seed = 42;
+  /// numbers of threads to try (empty means 1 and all available cores)
+  std::vector<int> thread_list {};
+  /// storage modes to try
+  std::vector<int> mode_list {static_cast<int>(StorageMode::DOUBLE),
+        static_cast<int>(StorageMode::SINGLE)};
+  /// algorithms to try
+  std::vector<int> type_list {0, 1, 2, 3};
+  /// number of product quantization subspaces of the pq mode
+  int pq_subspaces = 0;
+  /// number of repetitions of each measurement
+  int n_repeats = 3;
+  /// number of nearest neighbors to consider by the KNN algorithm
+  int knn = 5;
+  /// maximum number of terms to extract
+  int n_terms = 1000;
+  /// directory for the generated files
+  std::string work_dir {};
+
+  Option() {}
+
+  BEGIN_OPTION_MAP_INLINE()
+  ON_OPTION_WITH_ARG(SHORTOPT('S') || LONGOPT("seeds"))
+  n_seeds = std::strtoull(arg, nullptr, 10);
+
+  ON_OPTION_WITH_ARG(SHORTOPT('V') || LONGOPT("vocab"))
+  vocab_size = std::strtoull(arg, nullptr, 10);
+
+  ON_OPTION_WITH_ARG(SHORTOPT('d') || LONGOPT("dim"))
+  dim = std::strtoull(arg, nullptr, 10);
+  if (dim < 1)
+    throw optparse::invalid_value("dim should be >= 1");
+
+  ON_OPTION(SHORTOPT('h') || LONGOPT("help"))
+  usage();
+
+  ON_OPTION_WITH_ARG(SHORTOPT('j') || LONGOPT("threads"))
+  if (parse_int_list(&thread_list, arg, 1, 1 << 16))
+    throw optparse::invalid_value("threads should be a comma-separated"
+                                  " list of values >= 1");
+
+  ON_OPTION_WITH_ARG(SHORTOPT('k') || LONGOPT("k-nearest-neighbors"))
+  knn = std::atoi(arg);
+  if (knn < 1)
+    throw optparse::invalid_value("k-nearest-neighbors should be >= 1");
+
+  ON_OPTION_WITH_ARG(LONGOPT("modes"))
+  if (parse_mode_list(&mode_list, arg))
+    throw optparse::invalid_value("modes should be a comma-separated list"
+                                  " of double, single, int8, and pq");
+
+  ON_OPTION_WITH_ARG(SHORTOPT('n') || LONGOPT("n-terms"))
+  n_terms = std::atoi(arg);
+  if (n_terms < -1)
+    throw optparse::invalid_value("n-terms should be >= -1");
+
+  ON_OPTION_WITH_ARG(LONGOPT("pq"))
+  pq_subspaces = std::atoi(arg);
+  if (pq_subspaces < 0)
+    throw optparse::invalid_value("pq should be >= 0");
+
+  ON_OPTION_WITH_ARG(SHORTOPT('r') || LONGOPT("repeat"))
+  n_repeats = std::atoi(arg);
+  if (n_repeats < 1)
+    throw optparse::invalid_value("repeat should be >= 1");
+
+  ON_OPTION_WITH_ARG(LONGOPT("seed"))
+  rng_seed = std::strtoull(arg, nullptr, 10);
+
+  ON_OPTION_WITH_ARG(SHORTOPT('t') || LONGOPT("type"))
+  if (parse_int_list(&type_list, arg, 0,
+                     static_cast<int>(ExpansionType::MAX_SENTINEL) - 1))
+    throw optparse::invalid_value("type should be a comma-separated list"
+                                  " of algorithms (0-3)");
+
+  ON_OPTION_WITH_ARG(LONGOPT("work-dir"))
+  work_dir = arg;
+
+  END_OPTION_MAP()
+};
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Print usage message and exit
+ *
+ * @param a_ret - exit code for the program
+ *
+ * @return \c void
+ */
+static void usage(int a_ret) {
+  std::cerr << "Benchmark lexicon expansion on synthetic word vectors."
+            << std::endl << std::endl;
+  std::cerr << "Usage:" << std::endl;
+  std::cerr << "vec2dic_bench [OPTIONS]" << std::endl << std::endl;
+  std::cerr << "Options:" << std::endl;
+  std::cerr << "-S|--seeds  number of seed terms (default 1000)"
+            << std::endl;
+  std::cerr << "-V|--vocab  number of generated words (default 100000)"
+            << std::endl;
+  std::cerr << "-d|--dim  dimension of the generated vectors"
+      " (default 100)" << std::endl;
+  std::cerr << "-h|--help  show this screen and exit" << std::endl;
+  std::cerr << "-j|--threads  comma-separated numbers of threads to try"
+      " (default: 1 and" << std::endl;
+  std::cerr << "           all available cores)" << std::endl;
+  std::cerr << "-k|--k-nearest-neighbors  number of neighbors for KNN"
+      " algorithm (default 5)" << std::endl;
+  std::cerr << "--modes  comma-separated storage modes to try (double,"
+      " single, int8, pq;" << std::endl;
+  std::cerr << "           default: double,single)" << std::endl;
+  std::cerr << "-n|--n-terms  number of terms to extract (default 1000)"
+            << std::endl;
+  std::cerr << "--pq  number of bytes per vector of the pq mode (default:"
+      " 0 (dim / 4))" << std::endl;
+  std::cerr << "-r|--repeat  number of repetitions of each measurement"
+      " (default 3)" << std::endl;
+  std::cerr << "--seed  seed of the random number generator"
+      " (default 42)" << std::endl;
+  std::cerr << "-t|--type  comma-separated algorithms to try (default"
+      " 0,1,2,3; the int8" << std::endl;
+  std::cerr << "           and pq modes only run 0 and 1)" << std::endl;
+  std::cerr << "--work-dir  directory for the generated files (default:"
+      " $TMPDIR or /tmp)" << std::endl << std::endl;
+  std::cerr << "Output:" << std::endl;
+  std::cerr << "tab-separated lines with the columns vocab, dim, seeds,"
+      " mode, threads, type," << std::endl;
+  std::cerr << "phase, seconds_min, and seconds_mean (type is `-' for"
+      " phases of loading)" << std::endl << std::endl;
+  std::cerr << "Exit status:" << std::endl;
+  std::cerr << EXIT_SUCCESS << " on sucess, non-" << EXIT_SUCCESS
+            << " otherwise" << std::endl;
+  std::exit(a_ret);
+}
+
+/**
+ * Draw a standard normal variate
+ *
+ * The Box-Muller transform is used instead of
+ * `std::normal_distribution`, whose output differs between standard
+ * libraries.
+ *
+ * @param a_gen - random number generator
+ *
+ * @return normally distributed number
+ */
+static double _normal(std::mt19937_64 *a_gen) {
+  static const double TWO_PI = 6.283185307179586;
+  // uniform numbers in (0, 1] and [0, 1) built from the upper 53 bits
+  const double u1 = ((*a_gen)() >> 11) * (1. / 9007199254740992.);
+  const double u2 = ((*a_gen)() >> 11) * (1. / 9007199254740992.);
+  return sqrt(-2. * log(1. - u1)) * cos(TWO_PI * u2);
+}
+
+/**
+ * Generate synthetic word vectors and a seed set
+ *
+ * Every word belongs to a latent positive, negative, or neutral class
+ * whose vectors are scattered around the class center.  The seed set
+ * consists of words spread evenly over the vocabulary, labeled with
+ * their latent class.
+ *
+ * @param a_vec_fname - name of the textual word2vec file to write
+ * @param a_seed_fname - name of the seed file to write
+ * @param a_option - pointer to user's options
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+static int generate_data(const std::string &a_vec_fname,
+                         const std::string &a_seed_fname,
+                         const Option *a_option) {
+  static const char *const CLASS_NAMES[] = {"positive", "negative",
+                                            "neutral"};
+  const vid_t V = a_option->vocab_size;
+  const vid_t d = a_option->dim;
+  std::mt19937_64 gen(a_option->rng_seed);
+
+  // the positive and negative centers lie in opposite directions
+  std::vector<double> centers(3 * d, 0.);
+  for (vid_t r = 0; r < d; ++r) {
+    centers[r] = CLASS_OFFSET * _normal(&gen);
+    centers[d + r] = -centers[r];
+    centers[2 * d + r] = 0.5 * CLASS_OFFSET * _normal(&gen);
+  }
+
+  std::ofstream vos(a_vec_fname);
+  if (!vos) {
+    std::cerr << "Cannot write file " << a_vec_fname << std::endl;
+    return 1;
+  }
+  std::vector<int> classes(V);
+  std::string line;
+  char buf[32];
+  vos << V << ' ' << d << '\n';
+  for (vid_t i = 0; i < V; ++i) {
+    classes[i] = gen() % 3;
+    line = "w" + std::to_string(i);
+    for (vid_t r = 0; r < d; ++r) {
+      snprintf(buf, sizeof(buf), " %.6f",
+               centers[classes[i] * d + r] + _normal(&gen));
+      line += buf;
+    }
+    vos << line << '\n';
+  }
+  vos.close();
+  if (!vos) {
+    std::cerr << "Failed to write file " << a_vec_fname << std::endl;
+    return 1;
+  }
+
+  std::ofstream sos(a_seed_fname);
+  const vid_t n_seeds = std::min(a_option->n_seeds, V);
+  for (vid_t s = 0; s < n_seeds; ++s) {
+    const vid_t i = s * V / n_seeds;
+    sos << 'w' << i << '\t' << CLASS_NAMES[classes[i]] << '\n';
+  }
+  sos.close();
+  if (!sos) {
+    std::cerr << "Failed to write file " << a_seed_fname << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Record timing of a phase
+ *
+ * @param a_results - results to update
+ * @param a_mode - storage mode
+ * @param a_threads - number of threads
+ * @param a_type - algorithm (`ANY_TYPE` for loading)
+ * @param a_phase - name of the phase
+ * @param a_seconds - measured wall-clock time
+ *
+ * @return \c void
+ */
+static void _record(result_map_t *a_results, const int a_mode,
+                    const int a_threads, const std::string &a_type,
+                    const std::string &a_phase, const double a_seconds) {
+  (*a_results)[std::make_tuple(a_mode, a_threads, a_type, a_phase)]
+      .push_back(a_seconds);
+}
+
+/**
+ * Record all phases of a profile
+ *
+ * @param a_results - results to update
+ * @param a_profile - collected timings
+ * @param a_mode - storage mode
+ * @param a_threads - number of threads
+ * @param a_type - algorithm (`ANY_TYPE` for loading)
+ *
+ * @return \c void
+ */
+static void _record_profile(result_map_t *a_results,
+                            const phase_profile_t *a_profile,
+                            const int a_mode, const int a_threads,
+                            const std::string &a_type) {
+  for (auto &p2s : a_profile->m_seconds)
+    _record(a_results, a_mode, a_threads, a_type, p2s.first, p2s.second);
+}
+
+/// seconds elapsed since the given time point
+static double _seconds_since(
+    const std::chrono::steady_clock::time_point &a_start) {
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - a_start;
+  return elapsed.count();
+}
+
+/**
+ * Measure all phases of one storage mode with one number of threads
+ *
+ * @param a_results - results to update
+ * @param a_vec_fname - name of the textual word2vec file
+ * @param a_bin_fname - name of the binary vector file to write and read
+ * @param a_seeds - seed set
+ * @param a_mode - storage mode
+ * @param a_threads - number of threads
+ * @param a_option - pointer to user's options
+ *
+ * @return \c 0 on success, non-\c 0 otherwise
+ */
+static int run_config(result_map_t *a_results,
+                      const std::string &a_vec_fname,
+                      const std::string &a_bin_fname, const w2ps_t *a_seeds,
+                      const int a_mode, const int a_threads,
+                      const Option *a_option) {
+  const StorageMode mode = static_cast<StorageMode>(a_mode);
+  store_options_t store_opts;
+  store_opts.m_single_precision = mode == StorageMode::SINGLE;
+  expander_options_t exp_opts;
+  exp_opts.m_n_terms = a_option->n_terms;
+  exp_opts.m_knn = a_option->knn;
+  exp_opts.m_int8 = mode == StorageMode::INT8;
+  if (mode == StorageMode::PQ)
+    exp_opts.m_pq_subspaces = a_option->pq_subspaces > 0?
+        a_option->pq_subspaces: std::max<int>(1, a_option->dim / 4);
+
+  phase_profile_t profile;
+  set_phase_profile(&profile);
+  std::chrono::steady_clock::time_point start;
+  EmbeddingStore store;
+  lexicon_t lexicon;
+  std::string type;
+  int ret = 0;
+  for (int rep = 0; rep < a_option->n_repeats && ret == 0; ++rep) {
+    // load vectors from the textual and the binary file
+    profile.clear();
+    start = std::chrono::steady_clock::now();
+    if ((ret = store.load(a_vec_fname.c_str(), store_opts)))
+      break;
+    _record(a_results, a_mode, a_threads, ANY_TYPE, "load_text",
+            _seconds_since(start));
+    if (rep == 0 && (ret = store.save(a_bin_fname.c_str())))
+      break;
+
+    start = std::chrono::steady_clock::now();
+    if ((ret = store.load(a_bin_fname.c_str(), store_opts)))
+      break;
+    _record(a_results, a_mode, a_threads, ANY_TYPE, "load_binary",
+            _seconds_since(start));
+    _record_profile(a_results, &profile, a_mode, a_threads, ANY_TYPE);
+
+    for (int t : a_option->type_list) {
+      exp_opts.m_type = static_cast<ExpansionType>(t);
+      type = std::to_string(t);
+      profile.clear();
+      start = std::chrono::steady_clock::now();
+      try {
+        Expander expander(&store, exp_opts);
+        _record(a_results, a_mode, a_threads, type, "prepare",
+                _seconds_since(start));
+
+        start = std::chrono::steady_clock::now();
+        if ((ret = expander.expand(a_seeds, &lexicon)))
+          break;
+        _record(a_results, a_mode, a_threads, type, "expand",
+                _seconds_since(start));
+      } catch (const std::invalid_argument &) {
+        // compressed modes do not support all algorithms
+        continue;
+      }
+
+      start = std::chrono::steady_clock::now();
+      std::ostringstream os;
+      output_terms(os, &lexicon);
+      _record(a_results, a_mode, a_threads, type, "output",
+              _seconds_since(start));
+      _record_profile(a_results, &profile, a_mode, a_threads, type);
+    }
+  }
+  set_phase_profile(nullptr);
+  return ret;
+}
+
+/**
+ * Print measured timings
+ *
+ * @param a_results - timings of all phases
+ * @param a_option - pointer to user's options
+ *
+ * @return \c void
+ */
+static void output_results(const result_map_t *a_results,
+                           const Option *a_option) {
+  std::cout << "vocab\tdim\tseeds\tmode\tthreads\ttype\tphase"
+      "\tseconds_min\tseconds_mean\n";
+  double sum;
+  for (auto &k2s : *a_results) {
+    sum = 0.;
+    for (double s : k2s.second)
+      sum += s;
+    std::cout << a_option->vocab_size << '\t' << a_option->dim << '\t'
+              << std::min(a_option->n_seeds, a_option->vocab_size) << '\t'
+              << MODE_NAMES[std::get<0>(k2s.first)] << '\t'
+              << std::get<1>(k2s.first) << '\t' << std::get<2>(k2s.first)
+              << '\t' << std::get<3>(k2s.first) << '\t'
+              << *std::min_element(k2s.second.begin(), k2s.second.end())
+              << '\t' << sum / k2s.second.size() << '\n';
+  }
+  std::cout.flush();
+}
+
+//////////
+// Main //
+//////////
+
+/**
+ * Main method of the benchmark
+ *
+ * @param argc - number of command line arguments
+ * @param argv - array of command line arguments
+ *
+ * @return 0 on success, non-0 otherwise
+ */
+int main(int argc, char *argv[]) {
+  setlocale(LC_ALL, NULL);
+
+  Option opt {};
+  int argused = 1 + opt.parse(&argv[1], argc-1);  // Skip argv[0].
+  if (argused != argc) {
+    std::cerr << "Unexpected argument " << argv[argused]
+              << ".  Type --help to see usage." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if (opt.vocab_size < 2 || opt.n_seeds < 1) {
+    std::cerr << "At least two words and one seed are required."
+        "  Type --help to see usage." << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  if (opt.thread_list.empty()) {
+    opt.thread_list.push_back(1);
+#ifdef _OPENMP
+    if (omp_get_max_threads() > 1)
+      opt.thread_list.push_back(omp_get_max_threads());
+#endif
+  }
+  if (opt.work_dir.empty()) {
+    const char *tmpdir = std::getenv("TMPDIR");
+    opt.work_dir = tmpdir != nullptr && *tmpdir? tmpdir: "/tmp";
+  }
+
+  const std::string prefix = opt.work_dir + "/vec2dic_bench."
+      + std::to_string(getpid());
+  const std::string vec_fname = prefix + ".txt";
+  const std::string bin_fname = prefix + ".nwe";
+  const std::string seed_fname = prefix + ".seeds";
+  result_map_t results;
+  w2ps_t seeds;
+  int ret = EXIT_SUCCESS;
+
+  std::cerr << "Generating " << opt.vocab_size << " vectors of dimension "
+            << opt.dim << " ... ";
+  if ((ret = generate_data(vec_fname, seed_fname, &opt)))
+    goto exit;
+  std::cerr << "done" << std::endl;
+  if ((ret = read_seed_set(seed_fname.c_str(), &seeds)))
+    goto exit;
+
+  for (int mode : opt.mode_list) {
+    for (int n_threads : opt.thread_list) {
+      std::cerr << "Benchmarking mode " << MODE_NAMES[mode] << " with "
+                << n_threads << " threads" << std::endl;
+#ifdef _OPENMP
+      omp_set_num_threads(n_threads);
+#endif
+      if ((ret = run_config(&results, vec_fname, bin_fname, &seeds, mode,
+                            n_threads, &opt)))
+        goto exit;
+    }
+  }
+  output_results(&results, &opt);
+
+ exit:
+  std::remove(vec_fname.c_str());
+  std::remove(bin_fname.c_str());
+  std::remove(seed_fname.c_str());
+  return ret;
+}
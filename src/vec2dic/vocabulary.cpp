@@ -0,0 +1,118 @@
+/** @file vocabulary.cpp
+ *
+ *  @brief compact mapping between words and vector id's.
+ */
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/vocabulary.h"
+
+#include <cstring>        // memcmp()
+
+///////////////
+// Constants //
+///////////////
+
+/** Minimum number of slots of the hash table */
+static const size_t MIN_SLOTS = 16;
+
+/////////////
+// Methods //
+/////////////
+
+/**
+ * Compute FNV-1a hash of a word
+ *
+ * @param a_word - characters of the word
+ * @param a_length - number of characters
+ *
+ * @return hash value
+ */
+static inline uint64_t _hash(const char *a_word, const size_t a_length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < a_length; ++i) {
+    hash ^= static_cast<unsigned char>(a_word[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Compute number of slots for the given number of words
+ *
+ * The table is kept at most half full.
+ *
+ * @param a_n_words - number of words
+ *
+ * @return power of two
+ */
+static size_t _n_slots(const vid_t a_n_words) {
+  size_t n_slots = MIN_SLOTS;
+  while (n_slots < 2 * a_n_words)
+    n_slots <<= 1;
+  return n_slots;
+}
+
+void Vocabulary::reserve(const vid_t a_n_words, const size_t a_n_bytes) {
+  m_bytes.reserve(a_n_bytes);
+  m_offsets.reserve(a_n_words + 1);
+  if (m_slots.size() < _n_slots(a_n_words))
+    rehash(_n_slots(a_n_words));
+}
+
+void Vocabulary::add(const char *a_word, const size_t a_length) {
+  const vid_t vecid = size();
+  if (m_slots.size() < _n_slots(vecid + 1))
+    rehash(_n_slots(vecid + 1));
+
+  m_bytes.insert(m_bytes.end(), a_word, a_word + a_length);
+  m_offsets.push_back(m_bytes.size());
+  insert(vecid, _hash(a_word, a_length));
+}
+
+void Vocabulary::clear() {
+  std::vector<char>().swap(m_bytes);
+  std::vector<uint64_t>(1, 0).swap(m_offsets);
+  std::vector<vid_t>().swap(m_slots);
+}
+
+bool Vocabulary::find(const char *a_word, const size_t a_length,
+                      vid_t *a_vecid) const {
+  if (m_slots.empty())
+    return false;
+
+  const size_t mask = m_slots.size() - 1;
+  vid_t vecid;
+  for (size_t s = _hash(a_word, a_length) & mask; m_slots[s] != 0;
+       s = (s + 1) & mask) {
+    vecid = m_slots[s] - 1;
+    if (length(vecid) == a_length
+        && memcmp(data(vecid), a_word, a_length) == 0) {
+      *a_vecid = vecid;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Vocabulary::rehash(const size_t a_n_slots) {
+  m_slots.assign(a_n_slots, 0);
+  const vid_t n_words = size();
+  for (vid_t i = 0; i < n_words; ++i)
+    insert(i, _hash(data(i), length(i)));
+}
+
+void Vocabulary::insert(const vid_t a_vecid, const uint64_t a_hash) {
+  const size_t mask = m_slots.size() - 1;
+  const size_t len = length(a_vecid);
+  const char *word = data(a_vecid);
+  size_t s = a_hash & mask;
+  for (; m_slots[s] != 0; s = (s + 1) & mask) {
+    // keep the first occurrence of duplicate words
+    if (length(m_slots[s] - 1) == len
+        && memcmp(data(m_slots[s] - 1), word, len) == 0)
+      return;
+  }
+  m_slots[s] = a_vecid + 1;
+}
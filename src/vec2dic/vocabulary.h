@@ -0,0 +1,140 @@
+/** @file vocabulary.h
+ *
+ *  @brief compact mapping between words and vector id's.
+ *
+ *  All words are stored back to back in one contiguous arena, and the
+ *  i-th word occupies the bytes `[offsets[i], offsets[i + 1])` of it
+ *  (the same layout as the string table of binary vector files).
+ *  Words are looked up by an open-addressing hash table whose slots
+ *  only hold vector id's, so that the whole vocabulary takes a few
+ *  allocations and a few dozen bytes per word on top of the
+ *  characters, instead of two hash map nodes and two strings.
+ */
+
+#ifndef VEC2DIC_VOCABULARY_H_
+# define VEC2DIC_VOCABULARY_H_ 1
+
+//////////////
+// Includes //
+//////////////
+#include "src/vec2dic/expansion.h"
+
+#include <cstdint>        // uint64_t
+#include <cstdlib>        // size_t
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+/////////////
+// Classes //
+/////////////
+
+/**
+ * Interned words of the embeddings.
+ *
+ * All const methods are safe to call from multiple threads.
+ */
+class Vocabulary {
+ public:
+  Vocabulary() {}
+
+  /**
+   * Reserve space for words
+   *
+   * @param a_n_words - expected number of words
+   * @param a_n_bytes - expected total length of the words
+   *
+   * @return \c void
+   */
+  void reserve(const vid_t a_n_words, const size_t a_n_bytes);
+
+  /**
+   * Append a word with the next vector id
+   *
+   * If the word occurs more than once, lookups return the id of its
+   * first occurrence.
+   *
+   * @param a_word - characters of the word
+   * @param a_length - number of characters
+   *
+   * @return \c void
+   */
+  void add(const char *a_word, const size_t a_length);
+
+  /**
+   * Release all words
+   *
+   * @return \c void
+   */
+  void clear();
+
+  /// number of words
+  vid_t size() const {
+    return m_offsets.size() - 1;
+  }
+
+  /**
+   * Look up vector id of a word
+   *
+   * @param a_word - characters of the word
+   * @param a_length - number of characters
+   * @param a_vecid - pointer to a variable in which the id should be
+   *                  stored
+   *
+   * @return \c true if the word is known, \c false otherwise
+   */
+  bool find(const char *a_word, const size_t a_length,
+            vid_t *a_vecid) const;
+
+  /// characters of the word of the given vector (not terminated)
+  const char *data(const vid_t a_vecid) const {
+    return m_bytes.data() + m_offsets[a_vecid];
+  }
+
+  /// number of characters of the word of the given vector
+  size_t length(const vid_t a_vecid) const {
+    return m_offsets[a_vecid + 1] - m_offsets[a_vecid];
+  }
+
+  /// word of the given vector
+  std::string word(const vid_t a_vecid) const {
+    return std::string(data(a_vecid), length(a_vecid));
+  }
+
+  /// offsets of the words in the arena (`size() + 1` elements)
+  const uint64_t *offsets() const {
+    return m_offsets.data();
+  }
+
+  /// characters of all words
+  const char *bytes() const {
+    return m_bytes.data();
+  }
+
+  /// number of bytes taken by the vocabulary
+  size_t memory_size() const {
+    return m_bytes.capacity() + m_offsets.capacity() * sizeof(uint64_t)
+        + m_slots.capacity() * sizeof(vid_t);
+  }
+
+ private:
+  /**
+   * Resize the hash table and re-insert all words
+   *
+   * @param a_n_slots - new number of slots (a power of two)
+   *
+   * @return \c void
+   */
+  void rehash(const size_t a_n_slots);
+
+  /// insert id of a word into the hash table unless the word is there
+  void insert(const vid_t a_vecid, const uint64_t a_hash);
+
+  /// characters of all words
+  std::vector<char> m_bytes {};
+  /// offsets of the words in `m_bytes`
+  std::vector<uint64_t> m_offsets {0};
+  /// hash table of vector id's incremented by one (0 marks free slots)
+  std::vector<vid_t> m_slots {};
+};
+
+#endif    // VEC2DIC_VOCABULARY_H_